@@ -6,13 +6,14 @@
  * Semantic Analysis Functions
  */
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdarg.h>
 
 #include "analyze.h"
 #include "parser.h"
 #include "parserHelper.h"
 #include "defines.h"
-#include "bittree.h"
+#include "intern.h"
 
 #define ERROR_OUT stderr
 /*
@@ -23,30 +24,16 @@
 
 #define RODATA_PREFIX "sc"
 #define RODATA_LITERAL "literal"
-#define RODATA_KEY_LEN 128
 
 #define SEMANTIC_ERR_HEADER ("\nSemantic Error [line %d]: ")
 #define SEMANTIC_WARN_HEADER ("\nSemantic Warning [line %d]:\n\t")
 
 #define IDENTIFIER_SIZE 256
 
-/*
- * Create a filter for checking node types that will have an
- * expected return value;
- */
-#define RETURN_TYPES_FILTER                                             \
-  ( NODETYPE_BIT(VARIABLE) | NODETYPE_BIT(ARRAY) |                      \
-    NODETYPE_BIT(UNARYOP) | NODETYPE_BIT(FACTOR) | NODETYPE_BIT(TERM) | \
-    NODETYPE_BIT(SIMPEXP) | NODETYPE_BIT(EXP) | NODETYPE_BIT(ASSIGN_STMT) | \
-    NODETYPE_BIT(IF_STMT) | NODETYPE_BIT(WHILE_STMT) | NODETYPE_BIT(CASE_STMT) | \
-    NODETYPE_BIT(READ_STMT) | NODETYPE_BIT(WRITE_STMT)                  \
-  )
-
-
 //before adding, check to see if it already exists in the
 //current scope
 #define REDECLARED_CHECK(node, id) do {                     \
-    Symbol_t *found = SymTable_find(currentScope, id);    \
+    Symbol_t *found = SymTable_find(state->currentScope, id);    \
     if (found) {                                            \
       semanticMsg(REDECLARED_ID, node, key);                \
       return -1;                                            \
@@ -138,22 +125,33 @@ static const char *SEMANTIC_WARN_MSGS[] = {
 };
 
 
-//keep track of the current semantic analysis status
-static SemanticErrors errors = NONE;
-
-//global pointer to the current scopes symbol table
-static SymTable_t *currentScope = NULL;
+//initial number of fresh .rodata entries to make room for
+#define STREAM_BASE_SIZE 16
 
-static SymTable_t *rodata = NULL;
+//state of the analysis running on this thread, set by Analyze_Semantics
+//or any of the streamed analysis functions
+static THREAD_LOCAL AnalyzeState_t *state = NULL;
 
 
 static char *makeLiteralKey(void) {
-  static int literalCount = 0;
-  static char literalBuf[RODATA_KEY_LEN];
 
+  snprintf(state->keyBuf, RODATA_KEY_LEN, "%s%d", RODATA_LITERAL, state->literalCount++);
+  return state->keyBuf;
+}
+
+
+/*
+ * Create a new symbol table. Tables are numbered in the
+ * order they are created in, the number is used to make
+ * the keys of string constants unique across scopes.
+ */
+static SymTable_t *newTable(void) {
+
+  SymTable_t *table = SymTable_init(SYMTAB_BASE_SIZE);
+  if (table)
+    table->id = state->tableCount++;
 
-  snprintf(literalBuf, RODATA_KEY_LEN, "%s%d", RODATA_LITERAL, literalCount++);
-  return literalBuf;
+  return table;
 }
 
 
@@ -202,18 +200,19 @@ static void vSemanticMsg(SemanticErrors errorID, TreeNode_t *node, va_list args)
   memset(identifier, 0, idLen);
 
   Symbol_t *ref = TreeNode_getSymbolRef(node);
+  LexToken_t *token = TreeNode_getToken(node);
   
-  if (node->token) {
-    lineNum = node->token->line;
+  if (token) {
+    lineNum = Lexer_tokenLine(*token);
     //check if node has a reference to a symbol first
     if (ref) 
       strncpy(identifier, ref->key, idLen);
     
     //otherwise, probe the node
-    else if (node->token->type == TOK_STR) 
-      strncpy(identifier, node->token->lexeme.string, idLen);
-    else if (node->token->type == TOK_NUM)
-      snprintf(identifier, idLen, "%d", node->token->lexeme.value);
+    else if (token->type == TOK_STR) 
+      strncpy(identifier, token->lexeme.string, idLen);
+    else if (token->type == TOK_NUM)
+      snprintf(identifier, idLen, "%d", token->lexeme.value);
   }
  
   fprintf(ERROR_OUT, SEMANTIC_ERR_HEADER, lineNum);
@@ -225,7 +224,7 @@ static void vSemanticMsg(SemanticErrors errorID, TreeNode_t *node, va_list args)
   
   vfprintf(ERROR_OUT, SEMANTIC_ERROR_MSGS[errorID], args);
   
-  errors = errorID;
+  state->errors = errorID;
 }
 
 //General semantic error message display
@@ -349,8 +348,8 @@ static void semanticErrNodeType(SemanticErrors errorID, NodeType found, TreeNode
 static void semanticWarning(SEMANTIC_WARNINGS warningID, TreeNode_t *node) {
   int lineNum = -1;
   
-  if (node->token) 
-    lineNum = node->token->line;
+  if (TreeNode_getToken(node)) 
+    lineNum = Lexer_tokenLine(*TreeNode_getToken(node));
  
   fprintf(ERROR_OUT, SEMANTIC_WARN_HEADER, lineNum); 
   fprintf(ERROR_OUT, "%s", SEMANTIC_WARN_MSGS[warningID]);
@@ -377,16 +376,16 @@ static int isBoolOrInt(SemanticErrors msg, NodeReturnType type, TreeNode_t *node
  */
 static int enterScope(TreeNode_t *node) {
 
-  SymTable_t *newScope = SymTable_init(SYMTAB_BASE_SIZE);
+  SymTable_t *newScope = newTable();
   if (!newScope)
     return -1;
 
   
   //set new scopes parent to the current scope
-  SymTable_addParent(newScope, currentScope);
+  SymTable_addParent(newScope, state->currentScope);
   //update current scope to the new scope
-  currentScope = newScope;
-  TreeNode_setSymTable(node, currentScope);
+  state->currentScope = newScope;
+  TreeNode_setSymTable(node, state->currentScope);
   return 0;
 }
 
@@ -394,31 +393,93 @@ static int enterScope(TreeNode_t *node) {
  * Exit the current scope we are in, and go to the parent scope
  */
 static void exitScope(void) {
-  currentScope = currentScope->parent;
+  SymTable_unbind(state->visible, state->currentScope);
+  state->currentScope = state->currentScope->parent;
+}
+
+
+/*
+ * Add a declared symbol to the current scope, and make it
+ * the one its name refers to until the scope is left.
+ */
+static int declareSymbol(Symbol_t *symbol) {
+
+  if (!SymTable_add(state->currentScope, symbol))
+    return -1;
+
+  return SymTable_bind(state->visible, symbol);
 }
 
 
 /*
  * Lookup a symbol in current scope. If symbol
- * isn't found, searches the parent scopes
- * until no more parent scopes exist.
+ * isn't found there, it is the one declared in the
+ * closest parent scope, which is found in the table
+ * of visible symbols without searching the parents.
  */
 static Symbol_t *lookupScope(char *key) {
 
-  return SymTable_findAll(currentScope, key, NULL);
+  return SymTable_find(state->visible, key);
 }
 
 
 char *getConstRodataKey(SymTable_t *scope, char *inKey) {
   
-  static char rodatakey[RODATA_KEY_LEN];
-  snprintf(rodatakey, RODATA_KEY_LEN, "%s%d_%s", RODATA_PREFIX, scope->id, inKey);
-  return rodatakey;
+  snprintf(state->keyBuf, RODATA_KEY_LEN, "%s%d_%s", RODATA_PREFIX, scope->id, inKey);
+  return state->keyBuf;
+}
+
+//remember a new .rodata entry of a streamed program until it is taken
+static int addFresh(Symbol_t *symbol) {
+
+  if (state->freshCount == state->freshSize) {
+    size_t size = state->freshSize ? state->freshSize << 1 : STREAM_BASE_SIZE;
+    Symbol_t **fresh = realloc(state->fresh, size * sizeof(Symbol_t *));
+    if (!fresh) {
+      fprintf(stderr, "Error growing fresh .rodata entries\n");
+      return -1;
+    }
+    state->fresh = fresh;
+    state->freshSize = size;
+  }
+
+  state->fresh[state->freshCount++] = symbol;
+  return 0;
+}
+
+/*
+ * Find the .rodata entry recorded for a string in one of the string
+ * tables. Strings are interned, so the same string is always found
+ * under the same key.
+ */
+static Symbol_t *findString(SymTable_t *strings, char *string) {
+
+  Symbol_t *found = SymTable_find(strings, string);
+  return found ? found->rodata : NULL;
+}
+
+//record the entry as the one found for its string
+static int addString(SymTable_t *strings, Symbol_t *entry) {
+
+  Symbol_t *string = Symbol_create(entry->data.string, entry->data, entry->type);
+  if (!string || !SymTable_add(strings, string))
+    return -1;
+
+  string->rodata = entry;
+  return 0;
 }
 
 //Read only data table will only hold string constants
 static Symbol_t *addRoData(SymTable_t *scope, char *key, symdata data, SymbolType type) {
 
+  //the string's contents, and the terminator
+  state->stringBytes += Intern_length(data.string) - 1;
+
+  //a literal repeating an earlier one is just that one's entry
+  Symbol_t *literal = key ? NULL : findString(state->literals, data.string);
+  if (literal)
+    return literal;
+
   char *newKey = NULL;
   if (key)
     newKey = getConstRodataKey(scope, key);
@@ -427,35 +488,34 @@ static Symbol_t *addRoData(SymTable_t *scope, char *key, symdata data, SymbolTyp
     newKey = makeLiteralKey();
 
   //since the symbol table doesn't make copies of keys,
-  //we need to allocate the generated key here.
-  char *allocdKey = calloc(1, strlen(newKey) + 1);
+  //we need to intern the generated key here.
+  char *allocdKey = Intern_string(newKey);
   if (!allocdKey) {
     fprintf(stderr, "Error allocating key for rodata entry: %s\n", newKey);
     return NULL;
     
   }
   
-  strcpy(allocdKey, newKey);
   Symbol_t  *symbol = Symbol_create(allocdKey, data, type);
-  SymTable_add(rodata, symbol);
-  return symbol;
-}
-
-static Symbol_t *findRoData(SymTable_t *scope, char *key) {
+  if (!symbol || !SymTable_add(state->rodata, symbol))
+    return NULL;
 
-  SymTable_t *thisScope = scope;
-  Symbol_t *entry = NULL;
-  while (thisScope && !entry) {
-    char *newKey = getConstRodataKey(thisScope, key);
-    entry = SymTable_find(rodata, newKey);
-    thisScope = thisScope->parent;
-  }
+  //otherwise the entry has a key of its own, but shares the
+  //bytes of the first entry holding the same string
+  Symbol_t *holder = findString(state->strings, data.string);
+  if (holder)
+    symbol->rodata = holder;
+  else if (addString(state->strings, symbol))
+    return NULL;
+  if (!key && addString(state->literals, symbol))
+    return NULL;
 
-  return entry;
+  //a streamed program writes its constants out as they are declared
+  if (state->streaming && addFresh(symbol))
+    return NULL;
+  return symbol;
 }
 
-
-
 /*
  * Add a constant to the current scopes
  * symbol table.
@@ -470,20 +530,21 @@ static int addConstant(TreeNode_t *node) {
    * the identifier it uses, and child 1 to the value
    * it contains.
    */
-  TreeNode_t *identifier = node->child[0],
-    *value = node->child[1];
+  TreeNode_t *identifier = TreeNode_getChild(node, 0),
+    *value = TreeNode_getChild(node, 1);
   
-  key = identifier->token->lexeme.string;
+  key = TreeNode_getToken(identifier)->lexeme.string;
+  Symbol_t *rentry = NULL;
   
-  if (value->token->type == TOK_NUM) {
-    data = (symdata)value->token->lexeme;
+  if (TreeNode_getToken(value)->type == TOK_NUM) {
+    data = (symdata)TreeNode_getToken(value)->lexeme;
     type |= SYMTYPE_BIT(SYMTYPE_INT);
   } else {
-    data = (symdata)value->token->lexeme;
+    data = (symdata)TreeNode_getToken(value)->lexeme;
     type |= SYMTYPE_BIT(SYMTYPE_STR);
 
     //add string constants to .rodata
-    if (!addRoData(currentScope, key, data, type))
+    if (!(rentry = addRoData(state->currentScope, key, data, type)))
       return -1;
   }
   
@@ -493,8 +554,12 @@ static int addConstant(TreeNode_t *node) {
   REDECLARED_CHECK(identifier, key);
   
   Symbol_t  *symbol = Symbol_create(key, data, type);
-  SymTable_add(currentScope, symbol);
-  return 0;
+  if (!symbol)
+    return -1;
+
+  //references to the constant are resolved to this entry
+  symbol->rodata = rentry;
+  return declareSymbol(symbol);
 }
 
 /*
@@ -513,10 +578,10 @@ static int addVariable(TreeNode_t *node) {
    * the identifier it uses, and child 1 to the
    * type it is declared as.
    */
-  TreeNode_t *identifier = node->child[0],
-    *declareType = node->child[1];
+  TreeNode_t *identifier = TreeNode_getChild(node, 0),
+    *declareType = TreeNode_getChild(node, 1);
 
-  NodeType nodeType = declareType->type;
+  NodeType nodeType = TreeNode_getTypes(declareType);
   NodeType arrayIndex = NODETYPE_BIT(CONSTANT) | NODETYPE_BIT(INTEGER);
   
   //First check if variable is an array
@@ -528,11 +593,11 @@ static int addVariable(TreeNode_t *node) {
     if (nodeType & arrayIndex && TreeNode_hasType(declareType, SIMP_NAME)) {
       //if we have an array size using a constant identifier
       //check to see if that identifier has been declared first
-      char *key = declareType->token->lexeme.string;
+      char *key = TreeNode_getToken(declareType)->lexeme.string;
       Symbol_t *constant = lookupScope(key);
       
       if (constant) {
-        data = (symdata)declareType->token->lexeme;
+        data = (symdata)TreeNode_getToken(declareType)->lexeme;
         type |= SYMTYPE_BIT(SYMTYPE_CONST_REF);
         
         //check that the constant used for the array index is an integer
@@ -561,7 +626,7 @@ static int addVariable(TreeNode_t *node) {
       //if the size has not been a referenced by a constant
       //identifier, get the numerical value
       if (size < 0)
-        size = declareType->token->lexeme.value;
+        size = TreeNode_getToken(declareType)->lexeme.value;
       
       if (size <= 0) {
         //ERROR
@@ -571,9 +636,9 @@ static int addVariable(TreeNode_t *node) {
       //if the size isn't already being referenced by a constant
       //set it to the integer value that it holds
       //if (!data)
-      //  data = (void *)&declareType->token->lexeme.value;
+      //  data = (void *)&TreeNode_getToken(declareType)->lexeme.value;
       if (!data.string)
-        data = (symdata)declareType->token->lexeme;
+        data = (symdata)TreeNode_getToken(declareType)->lexeme;
     }
       
     type |= SYMTYPE_BIT(SYMTYPE_ARRAY);
@@ -592,7 +657,7 @@ static int addVariable(TreeNode_t *node) {
   //variables can be defined in lists, so we need to make sure
   //we loop through all of them in the list and define them as the same type
   do {
-    key = identifier->token->lexeme.string;
+    key = TreeNode_getToken(identifier)->lexeme.string;
 
     //before adding, check to see if it already exists in the
     //current scope
@@ -600,11 +665,12 @@ static int addVariable(TreeNode_t *node) {
 
     //continue adding variable declarations
     Symbol_t  *symbol = Symbol_create(key, data, type);
-    SymTable_add(currentScope, symbol);
+    if (!symbol || declareSymbol(symbol))
+      return -1;
 
     //store where variable would be on the stack
-    SymTable_addStackVar(currentScope, symbol);
-    identifier = identifier->sibling;
+    SymTable_addStackVar(state->currentScope, symbol);
+    identifier = TreeNode_getSibling(identifier);
     
   } while (identifier != NULL);
 
@@ -616,7 +682,7 @@ static int addVariable(TreeNode_t *node) {
 //add symbol to current symbol table
 static int addSymbol(TreeNode_t *node) {
 
-  if (currentScope == NULL) {
+  if (state->currentScope == NULL) {
     fprintf(stderr, "CURRENT SCOPE IS NULL\n");
     return 0;
   }
@@ -640,7 +706,7 @@ static int addSymbol(TreeNode_t *node) {
 
 static int resolveLiterals(TreeNode_t *node) {
   
-  if (node->token->type == TOK_NUM) {
+  if (TreeNode_getToken(node)->type == TOK_NUM) {
     TreeNode_addType(node, INTEGER);
     TreeNode_setReturnType(node, RETURN_INT);
     EVAL_NOT(node);
@@ -651,7 +717,7 @@ static int resolveLiterals(TreeNode_t *node) {
   TreeNode_addType(node, STRING);
   
   //add string literal to rodata table
-  Symbol_t *entry = addRoData(currentScope, NULL, (symdata)node->token->lexeme,
+  Symbol_t *entry = addRoData(state->currentScope, NULL, (symdata)TreeNode_getToken(node)->lexeme,
                               SYMTYPE_STR(SYMTYPE_CONSTANT));
   
   if (!entry)
@@ -679,7 +745,7 @@ int resolveVariables(TreeNode_t *node) {
    * If we are dealing with a constant node that
    * has an identifier, do a look up in the symbol table.
    */
-  char *identifier = node->token->lexeme.string;
+  char *identifier = TreeNode_getToken(node)->lexeme.string;
   Symbol_t *symbol = lookupScope(identifier);
     
   //identifier was not declared before its use....
@@ -714,8 +780,7 @@ int resolveVariables(TreeNode_t *node) {
       TreeNode_addType(node, STRING);
 
       //make declared constants refer to their rodata entry
-      Symbol_t *rentry = findRoData(currentScope, symbol->key);
-      TreeNode_setSymbolRef(node, rentry);
+      TreeNode_setSymbolRef(node, symbol->rodata);
     }
     TreeNode_rmType(node, SIMP_NAME);
     TreeNode_addType(node, CONSTANT);
@@ -748,7 +813,7 @@ static int typecheck_Array(TreeNode_t *node) {
 
   //make sure if the array is being used, it has an index specified
   if (!first) {
-    semanticMsg(ARRAY_MISSING_INDEX, node, node->token->lexeme.string);
+    semanticMsg(ARRAY_MISSING_INDEX, node, TreeNode_getToken(node)->lexeme.string);
     return -1;
   }
 
@@ -767,7 +832,7 @@ static int typecheck_Array(TreeNode_t *node) {
   }
 
   //get the array size to use later
-  Symbol_t *arraySizeSymbol = Symbol_getArraySizeEntry(currentScope, TreeNode_getSymbolRef(node));
+  Symbol_t *arraySizeSymbol = Symbol_getArraySizeEntry(state->currentScope, TreeNode_getSymbolRef(node));
   int arraySize = arraySizeSymbol->data.value;
     
   //otherwise, check if the index value has a symbol table entry
@@ -820,9 +885,9 @@ static int typecheck_Array(TreeNode_t *node) {
     if (indexRef)
       index = indexRef->data.value;
     else 
-      index = indexNum->token->lexeme.value;
+      index = TreeNode_getToken(indexNum)->lexeme.value;
       
-    if (first->token->type == TOK_MINUS) {    
+    if (TreeNode_getToken(first)->type == TOK_MINUS) {    
       semanticMsg(ARRAY_UNDER_BOUNDS, first, -index);
       return -1;
     }
@@ -837,7 +902,7 @@ static int typecheck_Array(TreeNode_t *node) {
   //table, and its not a value with a unary operator, nor is it a variable;
   //we can just check the token literal value, if its an integer
   if (type == RETURN_INT) {
-    int index = first->token->lexeme.value;
+    int index = TreeNode_getToken(first)->lexeme.value;
     if (index >= arraySize) {
       semanticMsg(ARRAY_OVER_BOUNDS, node, index, arraySize);
       return -1;
@@ -898,7 +963,7 @@ static int typecheck_MulOp(TreeNode_t *node) {
   RVAL_EXPECTS_BOOL_INT(secondType, secondChild);
   
   //this type of operator returns an integer
-  if (node->token->type == TOK_KEY_AND)
+  if (TreeNode_getToken(node)->type == TOK_KEY_AND)
     TreeNode_setReturnType(node, RETURN_BOOL);
   else
     TreeNode_setReturnType(node, RETURN_INT);
@@ -943,7 +1008,7 @@ static int typecheck_BinOp(TreeNode_t *node) {
   RVAL_EXPECTS_BOOL_INT(secondType, secondChild);
 
   //This operator returns an integer, unless its or
-  if (node->token->type == TOK_KEY_OR)
+  if (TreeNode_getToken(node)->type == TOK_KEY_OR)
     TreeNode_setReturnType(node, RETURN_BOOL);
   else
     TreeNode_setReturnType(node, RETURN_INT);
@@ -951,15 +1016,6 @@ static int typecheck_BinOp(TreeNode_t *node) {
 }
 
 
-static int typecheck_Factor(TreeNode_t *node) {
-
-  NodeReturnType type = TreeNode_getReturnType(node);
-  
-  //make sure the first child has an integer or Boolean return
-  RVAL_EXPECTS_BOOL_INT(type, node);
-  return 0;
-}
-
 static int typecheck_Assignment(TreeNode_t *node) {
 
   TreeNode_t *firstChild = TreeNode_getChild(node, 0),
@@ -972,7 +1028,7 @@ static int typecheck_Assignment(TreeNode_t *node) {
   //first check left hand value, make sure its an integer variable
   if (!TreeNode_hasType(firstChild, VARIABLE)) {
     //first check if the assignment is some string
-    NodeType foundType = firstChild->type;
+    NodeType foundType = TreeNode_getTypes(firstChild);
     //this is actually a syntax error
     semanticErrNodeType(INVALID_L_TYPE, foundType, firstChild, 2, VARIABLE, INTEGER);
     return -1;
@@ -1051,59 +1107,79 @@ static int typecheck_CaseStmt(TreeNode_t *node) {
   //make sure the expression returns a bool or integer
   LVAL_EXPECTS_BOOL_INT(expType, exp);
 
-  //go through each case and the constants for each case
-  //and make sure that 1) the constants are integer values, and
-  //2)no duplicate constants exist for cases.
-  BitTreeNode_t *bitTree = BitTreeNode_New();
-  if (!bitTree)
-    return -1;
-
-  int maxCase = 0;
-  
-  //Go through each case
+  //count the constants of all cases, to make room for their values
   TreeNode_t *cases = TreeNode_getChild(node, 1);
-  do {
+  size_t count = 0;
+  for (TreeNode_t *curCase = cases; curCase; curCase = TreeNode_getSibling(curCase)) {
+    for (TreeNode_t *constants = TreeNode_getChild(curCase, 0); constants;
+         constants = TreeNode_getSibling(constants))
+      count++;
+  }
 
-    //for each case, go through the constants
-    TreeNode_t *constants = TreeNode_getChild(cases, 0);
-    do {
-      
-      //make sure constant is an integer first
-      if(isBoolOrInt(UNEXPECTED_L_TYPE, TreeNode_getReturnType(constants), constants)) {
-        BitTreeNode_Destroy(bitTree);
-        return -1;
+  int *values = malloc((count + 1) * sizeof(int)),
+    *arms = malloc((count + 1) * sizeof(int));
+  if (!values || !arms) {
+    fprintf(stderr, "Error allocating case values\n");
+    free(values);
+    free(arms);
+    return -1;
+  }
+
+  /*
+   * Go through each case and the constants for each case, up to
+   * the first constant that isn't an integer (or Boolean), then
+   * make sure no two of the constants before it are the same.
+   */
+  TreeNode_t *invalid = NULL;
+  size_t checked = 0;
+  int arm = 0;
+  for (TreeNode_t *curCase = cases; curCase && !invalid; curCase = TreeNode_getSibling(curCase), arm++) {
+    TreeNode_t *constants = TreeNode_getChild(curCase, 0);
+    for (; constants && !invalid; constants = TreeNode_getSibling(constants)) {
+      NodeReturnType type = TreeNode_getReturnType(constants);
+      if (type != RETURN_INT && type != RETURN_BOOL) {
+        invalid = constants;
+        continue;
       }
-      
-      //constant indexes cannot be negative
-      int hashIndex = -1;
-    
-      if (constants->token->type == TOK_ID) {
+
+      arms[checked] = arm;
+
+      if (TreeNode_getToken(constants)->type == TOK_ID) {
         //used a constant identifier, look it up and get the value
-        Symbol_t *value = lookupScope(constants->token->lexeme.string);
-        hashIndex = value->data.value; 
+        Symbol_t *value = lookupScope(TreeNode_getToken(constants)->lexeme.string);
+        values[checked++] = value->data.value;
       } else
-        hashIndex = constants->token->lexeme.value;
+        values[checked++] = TreeNode_getToken(constants)->lexeme.value;
+    }
+  }
 
-      //check if value is a duplicate
-      if (BitTreeNode_AddBitPattern(bitTree, (intptr_t)hashIndex)) {
-        semanticMsg(DUPLICATE_CASE, constants);
-        BitTreeNode_Destroy(bitTree);
-        return -1;
+  size_t duplicate;
+  CaseLabels_t *labels = CaseLabels_create(values, arms, checked, &duplicate);
+  free(values);
+  free(arms);
+
+  //the duplicate comes first if it is before the invalid constant
+  if (duplicate < checked) {
+    size_t position = 0;
+    for (TreeNode_t *curCase = cases; curCase; curCase = TreeNode_getSibling(curCase)) {
+      TreeNode_t *constants = TreeNode_getChild(curCase, 0);
+      for (; constants; constants = TreeNode_getSibling(constants)) {
+        if (position++ == duplicate) {
+          semanticMsg(DUPLICATE_CASE, constants);
+          return -1;
+        }
       }
-      //otherwise it is unique      
-      //if this is a const list, check all constants in it
-
-      //keep track of the largest case value
-      if (hashIndex > maxCase)
-	maxCase = hashIndex;
-      
-    } while ((constants = constants->sibling));
-
+    }
+  }
 
-    //move onto next case
-  } while ((cases = cases->sibling)); 
+  if (invalid)
+    return isBoolOrInt(UNEXPECTED_L_TYPE, TreeNode_getReturnType(invalid), invalid);
+  if (!labels)
+    return -1;
 
-  BitTreeNode_Destroy(bitTree);
+  //keep the sorted labels for generating the case's dispatch
+  TreeNode_setCaseLabels(node, labels);
+  int maxCase = CaseLabels_max(labels);
 
   //add number of cases to node
   TreeNode_setArgCount(node, maxCase);
@@ -1123,13 +1199,13 @@ static int typecheck_ReadStmt(TreeNode_t *node) {
   do {
     //make sure the arguments given are all variables
     if (!TreeNode_hasType(arg, VARIABLE)) {
-      semanticErrNodeType(UNEXPECTED_R_TYPE, arg->type, arg, 2, VARIABLE, INTEGER);
+      semanticErrNodeType(UNEXPECTED_R_TYPE, TreeNode_getTypes(arg), arg, 2, VARIABLE, INTEGER);
       return -1;
     }
 
     //keep track of the number of arguments
     argc++;
-  } while((arg = arg->sibling));
+  } while((arg = TreeNode_getSibling(arg)));
 
   TreeNode_setArgCount(node, argc);  
   return 0;
@@ -1146,7 +1222,7 @@ static int typecheck_WriteStmt(TreeNode_t *node) {
   do {
     //count the number of arguments
     argc++;
-  } while((arg = arg->sibling));
+  } while((arg = TreeNode_getSibling(arg)));
 
   //store argument count in node
   TreeNode_setArgCount(node, argc);
@@ -1159,66 +1235,37 @@ static int typecheck_WriteStmt(TreeNode_t *node) {
  *  -condition nodes
  *  -simple expressions/expression nodes
  *  -term nodes
- *  -factor nodes
+ *  -variable nodes
+ *  -statements that use the return types of their children
  *
  * These nodes are singled out for having return types
  * as they are typically used as/in operations that
  * depend on the type of their child nodes to complete
  * without error.
  */
-int resolveReturnTypes(TreeNode_t *node) {
-
-  //Type cast 'type' to an integer so
-  //the compile stops complaining about values
-  //not declared in the NodeType enum.
-  //Filter out the node types that don't have an expected return value
-  unsigned long long type = node->type & RETURN_TYPES_FILTER;
-
-  switch (type) {
-  case NODETYPE_BIT(ARRAY) | NODETYPE_BIT(VARIABLE):
-    return typecheck_Array(node);
-    
-  case NODETYPE_BIT(VARIABLE):
-    return typecheck_Variable(node);
-    
-  case NODETYPE_BIT(UNARYOP):
-    return typecheck_Unary(node);
-
-  case NODETYPE_BIT(FACTOR):
-    return typecheck_Factor(node);
-
-  case NODETYPE_BIT(TERM):
-    return typecheck_MulOp(node);
-
-  case NODETYPE_BIT(SIMPEXP):
-    return typecheck_BinOp(node);
-
-  case NODETYPE_BIT(EXP):
-    return typecheck_RelationalOp(node);
-    
-  case NODETYPE_BIT(ASSIGN_STMT):
-    return typecheck_Assignment(node);
-
-  case NODETYPE_BIT(IF_STMT):
-    return typecheck_IfStmt(node);
-
-  case NODETYPE_BIT(WHILE_STMT):
-    return typecheck_WhileStmt(node);
-    
-  case NODETYPE_BIT(CASE_STMT):
-    return typecheck_CaseStmt(node);
+static int (*const TYPECHECKS[NODEKIND_COUNT])(TreeNode_t *) = {
+  [NODEKIND_ARRAY] = typecheck_Array,
+  [NODEKIND_VARIABLE] = typecheck_Variable,
+  [NODEKIND_UNARYOP] = typecheck_Unary,
+  [NODEKIND_MULOP] = typecheck_MulOp,
+  [NODEKIND_BINOP] = typecheck_BinOp,
+  [NODEKIND_RELOP] = typecheck_RelationalOp,
+  [NODEKIND_ASSIGN_STMT] = typecheck_Assignment,
+  [NODEKIND_IF_STMT] = typecheck_IfStmt,
+  [NODEKIND_WHILE_STMT] = typecheck_WhileStmt,
+  [NODEKIND_CASE_STMT] = typecheck_CaseStmt,
+  [NODEKIND_READ_STMT] = typecheck_ReadStmt,
+  [NODEKIND_WRITE_STMT] = typecheck_WriteStmt,
+};
 
-  case NODETYPE_BIT(READ_STMT):
-    return typecheck_ReadStmt(node);
+int resolveReturnTypes(TreeNode_t *node) {
 
-  case NODETYPE_BIT(WRITE_STMT):
-    return typecheck_WriteStmt(node);
+  //kinds of nodes without an expected return value have no check
+  int (*typecheck)(TreeNode_t *) = TYPECHECKS[TreeNode_getKind(node)];
+  if (!typecheck)
+    return 0;
 
-  default:
-    break;
-  }
-  
-  return 0;
+  return typecheck(node);
 }
 
 
@@ -1240,7 +1287,7 @@ int resolveReturnTypes(TreeNode_t *node) {
 
 static int preNodeVisit(int depth, TreeNode_t *node, void *data) {
 
-  if (Analyze_GetStatus() != NONE)
+  if (Analyze_GetStatus(state) != NONE)
     return -1;
 
   //skip null statements
@@ -1259,7 +1306,7 @@ static int preNodeVisit(int depth, TreeNode_t *node, void *data) {
       TreeNode_t *section = TreeNode_getChild(node, 0);
       do {
         addSymbol(section);
-        section = section->sibling;
+        section = TreeNode_getSibling(section);
       } while (section != NULL);
       
     }
@@ -1281,7 +1328,6 @@ static int preNodeVisit(int depth, TreeNode_t *node, void *data) {
  * On the way back up the tree:
  *  -Exit scopes to parent scope when leaving a block node
  *  -Resolve return types for variables and constants
- *  -Resolve return types for factors
  *  -Resolve return types for terms
  *  -Resolve return types for simple expressions, expressions, and conditions
  *  -With return types being resolved, type checking will occur for
@@ -1293,7 +1339,7 @@ static int preNodeVisit(int depth, TreeNode_t *node, void *data) {
 static int postNodeVisit(int depth, TreeNode_t *node, void *data) {
 
   //we have hit an error, stop traversing the tree
-  if (Analyze_GetStatus() != NONE)
+  if (Analyze_GetStatus(state) != NONE)
     return -1;
   
   //don't stop tree traversing for null statments
@@ -1304,7 +1350,9 @@ static int postNodeVisit(int depth, TreeNode_t *node, void *data) {
   if (TreeNode_hasType(node, BLOCK))
     exitScope();
 
-  //type checking
+  //the node's types are final now, settle its kind
+  //and dispatch type checking on it
+  TreeNode_resolveKind(node);
   resolveReturnTypes(node);
   
   return 0;
@@ -1315,49 +1363,174 @@ static int postNodeVisit(int depth, TreeNode_t *node, void *data) {
  * Public API
  *
  *============================================================================*/
-SemanticErrors Analyze_GetStatus(void) {
-  return errors;
+SemanticErrors Analyze_GetStatus(AnalyzeState_t *analysis) {
+  return analysis->errors;
 }
 
 
-int Analyze_Semantics(TreeNode_t *treeHead, bool verbose) {
+//reset the state of an analysis, and set it up as this thread's
+static int initState(AnalyzeState_t *analysis) {
+
+  memset(analysis, 0, sizeof(AnalyzeState_t));
+  state = analysis;
 
   //initialize rodata table
-  rodata = SymTable_init(SYMTAB_BASE_SIZE);
-  if (!rodata) {
+  state->rodata = newTable();
+  if (!state->rodata) {
     fprintf(stderr, "Error initializing .rodata hash\n");
+    state = NULL;
     return -1;
   }
 
-  
+  //not numbered, it isn't a scope of its own
+  state->visible = SymTable_init(SYMTAB_BASE_SIZE);
+  if (!state->visible) {
+    fprintf(stderr, "Error initializing visible symbols hash\n");
+    state = NULL;
+    return -1;
+  }
+
+  state->strings = SymTable_init(SYMTAB_BASE_SIZE);
+  state->literals = SymTable_init(SYMTAB_BASE_SIZE);
+  if (!state->strings || !state->literals) {
+    fprintf(stderr, "Error initializing .rodata strings hash\n");
+    state = NULL;
+    return -1;
+  }
+
+  return 0;
+}
+
+int Analyze_Semantics(AnalyzeState_t *analysis, TreeNode_t *treeHead, bool verbose) {
+
+  if (initState(analysis))
+    return -1;
+
   TreeNode_traverse(0, treeHead, NULL, preNodeVisit, postNodeVisit);
 
   //print out the fixed ast with symbol tables
-  if (verbose && Analyze_GetStatus() == NONE) {
+  if (verbose && Analyze_GetStatus(state) == NONE) {
     fprintf(stdout, "\nSemantically Corrected AST\n");
-    TreeNode_print(stdout, Parser_getTree(), true);
+    TreeNode_print(stdout, treeHead, true);
   }
 
+  state = NULL;
   return 0;
 }
 
-SymTable_t *Analyze_GetRodata(void) {
-  return rodata;
+SymTable_t *Analyze_GetRodata(AnalyzeState_t *analysis) {
+  return analysis->rodata;
 }
 
 
-static int rodataCleanup(Symbol_t *entry, void *data) {
-  
-  if (entry->key)
-    free(entry->key);
+int Analyze_Begin(AnalyzeState_t *analysis) {
+
+  if (initState(analysis))
+    return -1;
+
+  analysis->streaming = true;
+  state = NULL;
+  return 0;
+}
+
+/*
+ * Check the condition of an if or while statement. The condition is
+ * checked as soon as it is streamed, since its code is generated
+ * before the statements depending on it.
+ */
+static int streamCondition(TreeNode_t *node) {
+
+  TreeNode_t *condition = TreeNode_getChild(node, 0);
+  //the condition's own checks may have failed on its last node
+  if (TreeNode_traverse(0, condition, NULL, preNodeVisit, postNodeVisit) ||
+      Analyze_GetStatus(state) != NONE)
+    return -1;
+
+  return typecheck_Condition(condition);
+}
+
+/*
+ * Resolve a case statement's expression, or a case's constants,
+ * and check they are integers or Booleans. The rest of the checks
+ * (see typecheck_CaseStmt) are done once all the cases are known.
+ */
+static int streamCaseValues(TreeNode_t *node) {
+
+  TreeNode_t *value = TreeNode_getChild(node, 0);
+  if (TreeNode_traverse(0, value, NULL, preNodeVisit, postNodeVisit) ||
+      Analyze_GetStatus(state) != NONE)
+    return -1;
+
+  //a case's constants are siblings of each other
+  do {
+    if (isBoolOrInt(UNEXPECTED_L_TYPE, TreeNode_getReturnType(value), value))
+      return -1;
+  } while (TreeNode_hasType(node, CASE) && (value = TreeNode_getSibling(value)));
 
-  memset(entry, 0, sizeof(Symbol_t));
-  //entry freeing handled by SymTable_destroy
   return 0;
 }
 
-void Analyze_Cleanup(void) {
-  SymTable_forEach(rodata, NULL, rodataCleanup);
-  SymTable_destroy(rodata);
+int Analyze_Stream(AnalyzeState_t *analysis, StreamEvent event, TreeNode_t *node) {
+
+  state = analysis;
+  int status = 0;
+
+  switch (event) {
+  case STREAM_BLOCK:
+    //declare the block's constants and variables in a new scope
+    status = enterScope(node);
+    for (int i = 0; i < 2 && !status; i++)
+      status = TreeNode_traverse(0, TreeNode_getChild(node, i), NULL, preNodeVisit, postNodeVisit);
+    break;
+
+  case STREAM_BLOCK_END:
+    exitScope();
+    TreeNode_resolveKind(node);
+    break;
+
+  case STREAM_STMT:
+    status = TreeNode_traverse(0, node, NULL, preNodeVisit, postNodeVisit);
+    break;
+
+  case STREAM_IF:
+  case STREAM_WHILE:
+    status = streamCondition(node);
+    break;
+
+  case STREAM_CASE:
+  case STREAM_CASE_ARM:
+    status = streamCaseValues(node);
+    break;
+
+  case STREAM_IF_END:
+  case STREAM_WHILE_END:
+  case STREAM_CASE_END:
+    //the statement's nested statements are done, check the statement
+    status = postNodeVisit(0, node, NULL);
+    break;
+
+  default:
+    break;
+  }
+
+  if (Analyze_GetStatus(state) != NONE)
+    status = -1;
+
+  state = NULL;
+  return status ? -1 : 0;
+}
+
+Symbol_t **Analyze_TakeRodata(AnalyzeState_t *analysis, size_t *count) {
+
+  *count = analysis->freshCount;
+  analysis->freshCount = 0;
+  return analysis->fresh;
 }
 
+void Analyze_End(AnalyzeState_t *analysis) {
+
+  free(analysis->fresh);
+
+  analysis->fresh = NULL;
+  analysis->freshCount = analysis->freshSize = 0;
+}
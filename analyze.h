@@ -9,6 +9,7 @@
 #define __ANALYZE_H__
 
 #include "tree.h"
+#include "parserHelper.h"
 
 //These literals match with strings defined
 //as 'SEMANTIC_ERROR_MSGS' in analyze.c
@@ -29,33 +30,131 @@ typedef enum {
   NOT_VALUE,
 } SemanticErrors;
 
+//maximum length of a generated .rodata key
+#define RODATA_KEY_LEN 128
+
+/*
+ * State of a semantic analysis. Owned by the caller, so
+ * several analyses can run at the same time.
+ */
+typedef struct AnalyzeState_s {
+  //keep track of the current semantic analysis status
+  SemanticErrors errors;
+
+  //pointer to the current scopes symbol table
+  SymTable_t *currentScope;
+  //string constants and literals
+  SymTable_t *rodata;
+  //symbols visible from the current scope by name, see SymTable_bind
+  SymTable_t *visible;
+  //the .rodata entry holding each string, and the entry of
+  //the literals of each string, keyed by the string
+  SymTable_t *strings;
+  SymTable_t *literals;
+
+  //counters used to number literals and symbol tables
+  int literalCount;
+  int tableCount;
+
+  //buffer for generating .rodata keys
+  char keyBuf[RODATA_KEY_LEN];
+
+  //set when the program is analyzed a piece at a time, see Analyze_Stream
+  bool streaming;
+  //.rodata entries added since they were last taken
+  Symbol_t **fresh;
+  size_t freshCount, freshSize;
+
+  //bytes the string literals and constants would take up in .rodata
+  //if none of them were shared, counting every literal written
+  size_t stringBytes;
+} AnalyzeState_t;
+
 
 /*
  * Analyze_semantics:
  *  Performs semantic checks on a generated abstract syntax tree.
  *
  * Arguments:
+ *  analysis: State to keep the analysis in, it is reset first.
  *  treeHead: Root node of the abstract syntax tree
  *  verbose: set true to print out symbol tables and updated ast.
  *
  * Returns:
  *  0 on success, -1 if errors occurred.
  */
-int Analyze_Semantics(TreeNode_t *treeHead, bool verbose);
+int Analyze_Semantics(AnalyzeState_t *analysis, TreeNode_t *treeHead, bool verbose);
 
 /*
  * Analyze_getStatus:
  *  Get more detailed status from the semantics analysis performed
  *  by calling 'Analyze_semantics'.
  *
+ * Arguments:
+ *  analysis: State of the analysis.
+ *
  * Returns:
  *  Semantic error number.  
  */
-SemanticErrors Analyze_GetStatus(void);
+SemanticErrors Analyze_GetStatus(AnalyzeState_t *analysis);
+
+
+SymTable_t *Analyze_GetRodata(AnalyzeState_t *analysis);
+
+/*
+ * Analyze_Begin:
+ *  Start a semantic analysis of a program that is handed over a
+ *  piece at a time as it is parsed (see Analyze_Stream), rather than
+ *  as a whole tree.
+ *
+ * Arguments:
+ *  analysis: State to keep the analysis in, it is reset first.
+ *
+ * Returns:
+ *  0 on success, -1 on error.
+ */
+int Analyze_Begin(AnalyzeState_t *analysis);
 
+/*
+ * Analyze_Stream:
+ *  Perform the semantic checks on a piece of a program, as handed
+ *  over by a streamed parse (see StreamEvent). Errors are reported
+ *  in the order of the source, so when a statement has errors both
+ *  in its condition and in its nested statements, the condition's
+ *  is the one reported.
+ *
+ * Arguments:
+ *  analysis: State of the analysis, see Analyze_Begin.
+ *  event: Which piece of the program the node is.
+ *  node: The node to check.
+ *
+ * Returns:
+ *  0 if the piece passed its checks, -1 if errors occurred.
+ */
+int Analyze_Stream(AnalyzeState_t *analysis, StreamEvent event, TreeNode_t *node);
 
-SymTable_t *Analyze_GetRodata(void);
+/*
+ * Analyze_TakeRodata:
+ *  Get the .rodata entries added since they were last taken, so they
+ *  can be written out. A literal repeating a string already in .rodata
+ *  doesn't add an entry, it refers to the one holding the string.
+ *
+ * Arguments:
+ *  analysis: State of the analysis, see Analyze_Begin.
+ *  count: Where to store the number of entries.
+ *
+ * Returns:
+ *  The entries added, valid until the next call to Analyze_Stream.
+ */
+Symbol_t **Analyze_TakeRodata(AnalyzeState_t *analysis, size_t *count);
 
-void Analyze_Cleanup(void);
+/*
+ * Analyze_End:
+ *  Free the memory used by a streamed analysis.
+ *
+ * Arguments:
+ *  analysis: State of the analysis, see Analyze_Begin.
+ */
+void Analyze_End(AnalyzeState_t *analysis);
 
 #endif //end of __ANALYZE_H__
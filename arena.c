@@ -0,0 +1,157 @@
+/*
+ * CMPT 399 (Winter 2016)
+ * Assignment 4: Code Generation
+ * Author: Derrick Gold
+ *
+ * Arena (region) allocator API
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "defines.h"
+
+//round a size up to the arena alignment
+#define ALIGN_UP(size) \
+  (((size) + (ARENA_ALIGNMENT - 1)) & ~((size_t)ARENA_ALIGNMENT - 1))
+
+#define STATS_FMT                                                 \
+  "Arena: %zu bytes used of %zu reserved in %zu block(s), %zu allocations\n"
+
+//arena the compiler modules currently allocate from,
+//each thread has its own
+static THREAD_LOCAL Arena_t *activeArena = NULL;
+
+
+/*
+ * Request a new block from the system that can hold at least
+ * 'size' bytes, and make it the current block of the arena.
+ */
+static ArenaBlock_t *newBlock(Arena_t *arena, size_t size) {
+
+  size_t blockSize = size > arena->blockSize ? size : arena->blockSize;
+
+  ArenaBlock_t *block = malloc(sizeof(ArenaBlock_t) + blockSize);
+  if (!block) {
+    fprintf(stderr, "Arena: Error allocating %zu byte block\n", blockSize);
+    return NULL;
+  }
+
+  block->size = blockSize;
+  block->used = 0;
+  block->next = arena->head;
+  arena->head = block;
+
+  arena->blockCount++;
+  arena->bytesReserved += blockSize;
+  return block;
+}
+
+
+Arena_t *Arena_create(size_t blockSize) {
+
+  Arena_t *arena = calloc(1, sizeof(Arena_t));
+  if (!arena) {
+    fprintf(stderr, "Arena_create: Error allocating arena\n");
+    return NULL;
+  }
+
+  arena->blockSize = ALIGN_UP(blockSize > 0 ? blockSize : ARENA_BLOCK_SIZE);
+  return arena;
+}
+
+
+void *Arena_alloc(Arena_t *arena, size_t size) {
+
+  if (!arena)
+    return NULL;
+
+  size = ALIGN_UP(size > 0 ? size : 1);
+
+  ArenaBlock_t *block = arena->head;
+  if (!block || block->size - block->used < size) {
+    block = newBlock(arena, size);
+    if (!block)
+      return NULL;
+  }
+
+  void *mem = (char *)block->data + block->used;
+  block->used += size;
+
+  arena->allocCount++;
+  arena->bytesUsed += size;
+
+  //blocks come straight from malloc, so clear the memory
+  //to keep the same guarantees as calloc
+  memset(mem, 0, size);
+  return mem;
+}
+
+
+char *Arena_strdup(Arena_t *arena, const char *str) {
+
+  if (!str)
+    return NULL;
+
+  size_t len = strlen(str) + 1;
+  char *copy = Arena_alloc(arena, len);
+  if (!copy)
+    return NULL;
+
+  memcpy(copy, str, len);
+  return copy;
+}
+
+
+void Arena_destroy(Arena_t *arena) {
+
+  if (!arena)
+    return;
+
+  ArenaBlock_t *block = arena->head;
+  while (block) {
+    ArenaBlock_t *next = block->next;
+    free(block);
+    block = next;
+  }
+
+  if (activeArena == arena)
+    activeArena = NULL;
+
+  memset(arena, 0, sizeof(Arena_t));
+  free(arena);
+}
+
+
+void Arena_getStats(Arena_t *arena, ArenaStats_t *stats) {
+
+  if (!stats)
+    return;
+
+  memset(stats, 0, sizeof(ArenaStats_t));
+  if (!arena)
+    return;
+
+  stats->blocks = arena->blockCount;
+  stats->allocations = arena->allocCount;
+  stats->bytesUsed = arena->bytesUsed;
+  stats->bytesReserved = arena->bytesReserved;
+}
+
+
+void Arena_printStats(FILE *output, Arena_t *arena) {
+
+  ArenaStats_t stats;
+  Arena_getStats(arena, &stats);
+  fprintf(output, STATS_FMT, stats.bytesUsed, stats.bytesReserved, stats.blocks,
+          stats.allocations);
+}
+
+
+void Arena_setActive(Arena_t *arena) {
+  activeArena = arena;
+}
+
+Arena_t *Arena_getActive(void) {
+  return activeArena;
+}
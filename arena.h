@@ -0,0 +1,149 @@
+/*
+ * CMPT 399 (Winter 2016)
+ * Assignment 4: Code Generation
+ * Author: Derrick Gold
+ *
+ * Arena (region) allocator API
+ *
+ * An arena hands out memory by bumping a pointer through large
+ * blocks that it requests from the system. Individual allocations
+ * are never freed; instead, every object allocated from an arena is
+ * released at once when the arena is destroyed. The compiler allocates
+ * all tokens, tree nodes, symbols and symbol tables of a compilation
+ * from a single arena, so tearing down a compilation no longer needs
+ * to walk the abstract syntax tree.
+ */
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stdio.h>
+#include <stddef.h>
+
+//default number of usable bytes in each arena block
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+//every allocation is aligned to this many bytes
+#define ARENA_ALIGNMENT 16
+
+typedef struct ArenaBlock_s {
+  struct ArenaBlock_s *next;
+  size_t size, used;
+  //keep the block data aligned for any type
+  union {
+    long double ld;
+    void *ptr;
+    long long ll;
+  } data[];
+} ArenaBlock_t;
+
+typedef struct Arena_s {
+  ArenaBlock_t *head;
+  size_t blockSize;
+
+  //running statistics
+  size_t blockCount;
+  size_t allocCount;
+  size_t bytesUsed;
+  size_t bytesReserved;
+} Arena_t;
+
+/*
+ * Statistics gathered by an arena over its lifetime.
+ */
+typedef struct ArenaStats_s {
+  size_t blocks;
+  size_t allocations;
+  size_t bytesUsed;
+  size_t bytesReserved;
+} ArenaStats_t;
+
+/*
+ * Arena_create:
+ *  Create a new arena.
+ *
+ * Arguments:
+ *  blockSize: Number of usable bytes to request from the system for
+ *    each block. Allocations larger than this get a block of their own.
+ *
+ * Returns:
+ *  Pointer to a new arena. NULL if the allocation fails.
+ */
+Arena_t *Arena_create(size_t blockSize);
+
+/*
+ * Arena_alloc:
+ *  Allocate zero initialized memory from an arena.
+ *
+ * Arguments:
+ *  arena: The arena to allocate from.
+ *  size: Number of bytes to allocate.
+ *
+ * Returns:
+ *  Pointer to the allocated memory, aligned to ARENA_ALIGNMENT bytes.
+ *  NULL if no arena is given or the system is out of memory.
+ */
+void *Arena_alloc(Arena_t *arena, size_t size);
+
+/*
+ * Arena_strdup:
+ *  Copy a string into an arena.
+ *
+ * Arguments:
+ *  arena: The arena to allocate the copy from.
+ *  str: The string to copy.
+ *
+ * Returns:
+ *  Pointer to the copy. NULL on failure.
+ */
+char *Arena_strdup(Arena_t *arena, const char *str);
+
+/*
+ * Arena_destroy:
+ *  Release every block owned by an arena, and the arena itself.
+ *  All memory previously returned by the arena becomes invalid.
+ *
+ * Arguments:
+ *  arena: The arena to destroy.
+ */
+void Arena_destroy(Arena_t *arena);
+
+/*
+ * Arena_getStats:
+ *  Get the allocation statistics of an arena.
+ *
+ * Arguments:
+ *  arena: The arena to report on.
+ *  stats: Structure to write the statistics into.
+ */
+void Arena_getStats(Arena_t *arena, ArenaStats_t *stats);
+
+/*
+ * Arena_printStats:
+ *  Print out the allocation statistics of an arena.
+ *
+ * Arguments:
+ *  output: File stream to write the statistics to.
+ *  arena: The arena to report on.
+ */
+void Arena_printStats(FILE *output, Arena_t *arena);
+
+/*
+ * Arena_setActive:
+ *  Set the arena that the compiler modules (lexer, tree, symbol tables)
+ *  allocate their objects from. Each thread has its own active arena.
+ *
+ * Arguments:
+ *  arena: The arena to make active. NULL to clear the active arena.
+ */
+void Arena_setActive(Arena_t *arena);
+
+/*
+ * Arena_getActive:
+ *  Get the arena currently used by the compiler modules.
+ *
+ * Returns:
+ *  Pointer to the active arena. NULL if none has been set.
+ */
+Arena_t *Arena_getActive(void);
+
+#endif //__ARENA_H__
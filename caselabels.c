@@ -0,0 +1,225 @@
+/*
+ * CMPT 399 (Winter 2016)
+ * Assignment 4: Code Generation
+ * Author: Derrick Gold
+ *
+ * Case Labels API
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "caselabels.h"
+#include "arena.h"
+
+//bits sorted on in each pass, and the number of passes a value takes
+#define RADIX_BITS 8
+#define RADIX_SIZE (1 << RADIX_BITS)
+#define RADIX_PASSES (sizeof(uint32_t) * 8 / RADIX_BITS)
+
+//a label's value is kept above its position, so both travel together,
+//with its sign bit flipped so that negative values sort first
+#define KEY_VALUE_SHIFT 32
+#define KEY_SIGN_BIT ((uint32_t)1 << 31)
+#define KEY(value, position) \
+  (((uint64_t)((uint32_t)(value) ^ KEY_SIGN_BIT) << KEY_VALUE_SHIFT) | (position))
+#define KEY_VALUE(key) ((int)((uint32_t)((key) >> KEY_VALUE_SHIFT) ^ KEY_SIGN_BIT))
+#define KEY_POSITION(key) ((size_t)((key) & UINT32_MAX))
+
+#define DIGIT(key, pass) (((key) >> (KEY_VALUE_SHIFT + (pass) * RADIX_BITS)) & (RADIX_SIZE - 1))
+
+//a jump table needs at least this many labels, filling at least
+//this percentage of its entries
+#define MIN_TABLE_LABELS 4
+#define MIN_TABLE_DENSITY 40
+
+//a bit mask covers a word of values; it takes a few labels for a
+//mask per case to beat comparing against each of them
+#define BITS_SPAN 32
+#define MIN_BITS_LABELS 3
+#define MAX_BITS_ARMS 3
+
+/*
+ * Sort keys by their values, least significant byte first. Passes on
+ * a byte every value has the same of are skipped, so small values
+ * take a single pass. Returns the buffer holding the sorted keys.
+ */
+static uint64_t *radixSort(uint64_t *keys, uint64_t *buffer, size_t count) {
+
+  size_t counts[RADIX_PASSES][RADIX_SIZE];
+  memset(counts, 0, sizeof(counts));
+  for (size_t i = 0; i < count; i++) {
+    for (size_t pass = 0; pass < RADIX_PASSES; pass++)
+      counts[pass][DIGIT(keys[i], pass)]++;
+  }
+
+  for (size_t pass = 0; pass < RADIX_PASSES; pass++) {
+    if (counts[pass][DIGIT(keys[0], pass)] == count)
+      continue;
+
+    //turn the counts into where each digit's keys start
+    size_t start = 0;
+    for (int digit = 0; digit < RADIX_SIZE; digit++) {
+      size_t digitCount = counts[pass][digit];
+      counts[pass][digit] = start;
+      start += digitCount;
+    }
+
+    for (size_t i = 0; i < count; i++)
+      buffer[counts[pass][DIGIT(keys[i], pass)]++] = keys[i];
+
+    uint64_t *sorted = buffer;
+    buffer = keys;
+    keys = sorted;
+  }
+
+  return keys;
+}
+
+
+static long long span(const int *values, size_t first, size_t last) {
+
+  return (long long)values[last] - values[first] + 1;
+}
+
+//last label a jump table from the label at 'first' can cover
+static size_t tableEnd(CaseLabels_t *labels, size_t first) {
+
+  size_t last = first;
+  while (last + 1 < labels->count &&
+         (long long)(last + 2 - first) * 100 >=
+         span(labels->values, first, last + 1) * MIN_TABLE_DENSITY)
+    last++;
+
+  return last;
+}
+
+//last label the bit masks from the label at 'first' can cover
+static size_t bitsEnd(CaseLabels_t *labels, size_t first) {
+
+  int arms[MAX_BITS_ARMS] = {labels->arms[first]};
+  int armCount = 1;
+
+  size_t last = first;
+  while (last + 1 < labels->count && span(labels->values, first, last + 1) <= BITS_SPAN) {
+    int arm = labels->arms[last + 1], i = 0;
+    while (i < armCount && arms[i] != arm)
+      i++;
+
+    if (i == armCount) {
+      if (armCount == MAX_BITS_ARMS)
+        break;
+      arms[armCount++] = arm;
+    }
+    last++;
+  }
+
+  return last;
+}
+
+/*
+ * Plan the cluster starting at the label at 'first'. Bit masks win
+ * over a jump table covering no more labels, and a label neither
+ * suits is compared against on its own.
+ */
+static CaseCluster_t nextCluster(CaseLabels_t *labels, size_t first) {
+
+  size_t tableCount = tableEnd(labels, first) - first + 1,
+    bitsCount = bitsEnd(labels, first) - first + 1;
+
+  CaseCluster_t cluster = {CASE_CLUSTER_COMPARE, first, 1};
+  if (bitsCount >= MIN_BITS_LABELS && bitsCount >= tableCount)
+    cluster = (CaseCluster_t){CASE_CLUSTER_BITS, first, bitsCount};
+  else if (tableCount >= MIN_TABLE_LABELS)
+    cluster = (CaseCluster_t){CASE_CLUSTER_TABLE, first, tableCount};
+  else if (bitsCount >= MIN_BITS_LABELS)
+    cluster = (CaseCluster_t){CASE_CLUSTER_BITS, first, bitsCount};
+
+  return cluster;
+}
+
+//split sorted labels into clusters, counting them before keeping them
+static int planClusters(Arena_t *arena, CaseLabels_t *labels) {
+
+  size_t clusterCount = 0;
+  for (size_t first = 0; first < labels->count; clusterCount++)
+    first += nextCluster(labels, first).count;
+
+  labels->clusters = Arena_alloc(arena, (clusterCount + 1) * sizeof(CaseCluster_t));
+  if (!labels->clusters) {
+    fprintf(stderr, "CaseLabels_create: Error allocating clusters\n");
+    return -1;
+  }
+
+  for (size_t first = 0; first < labels->count; labels->clusterCount++) {
+    labels->clusters[labels->clusterCount] = nextCluster(labels, first);
+    first += labels->clusters[labels->clusterCount].count;
+  }
+
+  return 0;
+}
+
+
+CaseLabels_t *CaseLabels_create(const int *values, const int *arms, size_t count, size_t *duplicate) {
+
+  *duplicate = count;
+  if (count > UINT32_MAX) {
+    fprintf(stderr, "CaseLabels_create: Too many labels\n");
+    return NULL;
+  }
+
+  Arena_t *arena = Arena_getActive();
+  CaseLabels_t *labels = Arena_alloc(arena, sizeof(CaseLabels_t));
+  int *sortedValues = Arena_alloc(arena, (count + 1) * sizeof(int)),
+    *sortedArms = Arena_alloc(arena, (count + 1) * sizeof(int));
+  uint64_t *keys = malloc((count + 1) * sizeof(uint64_t));
+  uint64_t *buffer = malloc((count + 1) * sizeof(uint64_t));
+  if (!labels || !sortedValues || !sortedArms || !keys || !buffer) {
+    fprintf(stderr, "CaseLabels_create: Error allocating labels\n");
+    free(keys);
+    free(buffer);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < count; i++)
+    keys[i] = KEY(values[i], i);
+  uint64_t *sorted = count ? radixSort(keys, buffer, count) : keys;
+
+  //labels sharing a value are next to each other, in the order given,
+  //so the first of each run is the label others repeat
+  for (size_t i = 0; i < count; i++) {
+    sortedValues[i] = KEY_VALUE(sorted[i]);
+    sortedArms[i] = arms[KEY_POSITION(sorted[i])];
+    if (i && sortedValues[i] == sortedValues[i - 1] && KEY_POSITION(sorted[i]) < *duplicate)
+      *duplicate = KEY_POSITION(sorted[i]);
+  }
+
+  free(keys);
+  free(buffer);
+  if (*duplicate < count)
+    return NULL;
+
+  labels->values = sortedValues;
+  labels->arms = sortedArms;
+  labels->count = count;
+  if (planClusters(arena, labels))
+    return NULL;
+
+  return labels;
+}
+
+
+int CaseLabels_max(CaseLabels_t *labels) {
+
+  if (!labels || !labels->count)
+    return 0;
+
+  return labels->values[labels->count - 1];
+}
+
+
+long long CaseLabels_span(CaseLabels_t *labels, CaseCluster_t *cluster) {
+
+  return span(labels->values, cluster->first, cluster->first + cluster->count - 1);
+}
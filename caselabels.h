@@ -0,0 +1,99 @@
+/*
+ * CMPT 399 (Winter 2016)
+ * Assignment 4: Code Generation
+ * Author: Derrick Gold
+ *
+ * Case Labels API
+ *
+ * The labels of a case statement, sorted by value. The values are
+ * radix sorted, a byte at a time, along with the position each value
+ * was given in: the sort is stable, so any labels sharing a value end
+ * up next to each other in the order they were given in, and finding
+ * duplicates is a single pass over the sorted labels.
+ *
+ * Values are signed (a hexadecimal label can be negative), their sign
+ * bit is flipped while sorting so negative values come first.
+ *
+ * The sorted labels are split into clusters, each dispatched to in
+ * the way that suits it best: a run of labels dense enough gets a
+ * jump table, labels close together that share only a few cases get
+ * a bit mask for each case, and every other label is compared
+ * against. The clusters are searched between with a balanced binary
+ * search on their smallest values.
+ */
+#ifndef __CASE_LABELS_H__
+#define __CASE_LABELS_H__
+
+#include <stddef.h>
+
+typedef enum {
+  CASE_CLUSTER_COMPARE, //a single label, compared against
+  CASE_CLUSTER_TABLE,   //a jump table, indexed from the smallest label
+  CASE_CLUSTER_BITS,    //a bit mask per case, of labels within a word
+} CaseClusterKind;
+
+typedef struct CaseCluster_s {
+  CaseClusterKind kind;
+  //the labels of the cluster, as a range of the sorted labels
+  size_t first;
+  size_t count;
+} CaseCluster_t;
+
+typedef struct CaseLabels_s {
+  //values of the labels in ascending order
+  int *values;
+  //case (numbered from 0, in order) each of the values belongs to
+  int *arms;
+  size_t count;
+
+  //clusters of the labels, in ascending order
+  CaseCluster_t *clusters;
+  size_t clusterCount;
+} CaseLabels_t;
+
+/*
+ * CaseLabels_create:
+ *  Sort the values of a case statement's labels, checking that no
+ *  value is used by more than one label, and plan the clusters they
+ *  are dispatched to with.
+ *
+ * Arguments:
+ *  values: Values of the labels, in the order they appear in.
+ *  arms: Case each of the labels belongs to.
+ *  count: Number of labels.
+ *  duplicate: Set to the position of the first label using the value
+ *    of a label before it, or to 'count' if every value is distinct.
+ *
+ * Returns:
+ *  The sorted labels, allocated from the active arena. NULL if a
+ *  value is used more than once, or on error.
+ */
+CaseLabels_t *CaseLabels_create(const int *values, const int *arms, size_t count, size_t *duplicate);
+
+/*
+ * CaseLabels_max:
+ *  Get the largest value of some labels.
+ *
+ * Arguments:
+ *  labels: The labels, made by CaseLabels_create.
+ *
+ * Returns:
+ *  The largest value, 0 if there are no labels.
+ */
+int CaseLabels_max(CaseLabels_t *labels);
+
+/*
+ * CaseLabels_span:
+ *  Get the number of values from the smallest to the largest label
+ *  of a cluster, including both.
+ *
+ * Arguments:
+ *  labels: The labels, made by CaseLabels_create.
+ *  cluster: One of the labels' clusters.
+ *
+ * Returns:
+ *  The number of values the cluster covers.
+ */
+long long CaseLabels_span(CaseLabels_t *labels, CaseCluster_t *cluster);
+
+#endif //__CASE_LABELS_H__
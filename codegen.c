@@ -7,21 +7,22 @@
  * assembly code.
  */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <limits.h>
+#include "codegen.h"
 #include "tree.h"
 #include "symtab.h"
+#include "intern.h"
 #include "parser.h"
 #include "defines.h"
-#include "bittree.h"
 
-#define COMMENT_BUF_LEN 256
 
-//Maximum number of elements to use a lookup
-//table for with case statements. Cases with
-//numbers greater than this value will use
-//an alternative method
-#define MAX_LOOKUP_SIZE 256
+//Maximum number of case labels, none of them in a
+//jump table or bit masks, to compare against one
+//after another rather than searching between
+#define MAX_COMPARE_CHAIN 3
 
 #define WRITE_LABEL_WIDTH 20
 //longest instruction is 7 characters long plus 1 space after it
@@ -30,18 +31,6 @@
 #define WRITE_ARGS_WIDTH ((WRITE_LABEL_WIDTH * 2) + 2)
 
 
-//filter for statements
-#define STMT_FILTER ( \
-  NODETYPE_BIT(IF_STMT) | NODETYPE_BIT(READ_STMT) | NODETYPE_BIT(WRITE_STMT) | \
-  NODETYPE_BIT(CASE_STMT) | NODETYPE_BIT(ASSIGN_STMT) | NODETYPE_BIT(BLOCK_STMT) | \
-  NODETYPE_BIT(WHILE_STMT) | NODETYPE_BIT(STMT_LIST)                    \
-)
-
-#define EXP_FILTER ( \
-  NODETYPE_BIT(RELOP) | NODETYPE_BIT(BINOP) | NODETYPE_BIT(UNARYOP) | \
-  NODETYPE_BIT(MULOP) | NODETYPE_BIT(VARIABLE) | NODETYPE_BIT(CONSTANT) \
-)
-
 #define FILE_HEADER (                                           \
 ";=======================================================\n"    \
 "; Code generated from the MacEwan Teeny Pascal Language\n"     \
@@ -63,9 +52,24 @@
 #define TABLE_TAG_FMT ("_%d")
 #define TABLE_TAG_DEF ("_default")
 #define TABLE_TAG_END ("_end")
+//later default cases of a streamed case, and its dispatch code
+#define TABLE_TAG_DEF_FMT ("_default%d")
+#define TABLE_TAG_DISPATCH ("_dispatch")
+//labels can't have a '-', so negative values are tagged with an 'n'
+#define TABLE_TAG_NEG_FMT ("_n%u")
+//branches of a case's binary search, and its jump tables
+#define TABLE_TAG_NODE_FMT ("_node%d")
+#define TABLE_TAG_TABLE_FMT ("_table%d")
 
 #define MAIN_LABEL "main"
 
+//initial number of frames in the expression and condition stacks
+#define EXP_STACK_BASE_SIZE 64
+#define COND_STACK_BASE_SIZE 64
+
+//initial number of statements a stream can be nested in
+#define STREAM_STACK_BASE_SIZE 16
+
 
 //current stack frame
 #define REG_STACKFRAME "ebp"
@@ -87,6 +91,8 @@
 
 //referencing local variable in a scope
 #define STACK_VAR_FMT "["REG_STACKFRAME"%+d]"
+//referencing an array's element by the register its index is in
+#define ELEMENT_FMT "["REG_STACKFRAME"+%s*"WORD_SIZE_BYTES_STR"%+d]"
 
 //push value on the stack
 #define STORE_RESULT(reg) do {                     \
@@ -165,47 +171,15 @@
 } while (0)
 
 
-#define SHORT_RECURSION(label, node, tokenType, fn) do {    \
-    if (node->token->type == (tokenType)) {       \
-      if (fn(output, node, shortLabel)) {       \
-  if (label) free(label);           \
-  return -1;              \
-      }                 \
-    } else {                \
-      if (generateExp(output, node)) {          \
-  if (label) free(label);           \
-  return -1;              \
-      }                 \
-    }                 \
-  } while (0)
-
-#define SHORTCIRCUIT_CONDITION(label, tokenType, fn) do {   \
-    if (!shortLabel) {              \
-      label = calloc(1, COMMENT_BUF_LEN);       \
-      if (!label) {             \
-  fprintf(stderr, "Error allocating short circuit label\n");  \
-  return -1;              \
-      }                 \
-      MAKE_LABEL(label, COMMENT_BUF_LEN);       \
-      shortLabel = label;           \
-    }                 \
-                      \
-    TreeNode_t *left = TreeNode_getChild(node, 0),      \
-      *right = TreeNode_getChild(node, 1);        \
-                      \
-    SHORT_RECURSION(label, left, tokenType, fn);        \
-                      \
-    STORE_RESULT(REG_RETURN);           \
-                  \
-    SHORT_RECURSION(label, right, tokenType, fn);     \
-  } while (0)
-
-
 #define EXIT_PRGM do { \
     writeLine(output, true, "exit", "mov", NULL, 2, REG_RETURN, "0"); \
     writeLine(output, true, NULL, "ret", NULL, 0);                     \
 } while (0) 
 
+//optimized expressions use the registers main has to give back as they were
+static const char *const SAVED_REGISTERS[] = {"ebx", "esi", "edi"};
+#define SAVED_REGISTER_COUNT ((int)(sizeof(SAVED_REGISTERS) / sizeof(SAVED_REGISTERS[0])))
+
 
 typedef enum {
   NEW_SCOPE,
@@ -222,6 +196,10 @@ typedef enum {
   SHORTED_AND,
   NO_OPERATOR,
   CASE_LABEL,
+  SPILL_OPERAND,
+  KEEP_VAR,
+  STORE_VAR,
+  KEEP_INDEX,
 } GENERATE_COMMENT;
 
 const char *COMMENT_STRINGS[] = {
@@ -239,15 +217,83 @@ const char *COMMENT_STRINGS[] = {
   "Shorted And",
   "Invalid operator was found: token type: %d",
   "Case State: %d",
+  "Out of registers, spill operand",
+  "Keep '%s' in a register through the loop",
+  "Store back '%s' kept through the loop",
+  "Keep index '%s' in a register through the assignment",
 };
 
 int generateStatement(FILE *output, TreeNode_t *node);
 int generateExp(FILE *output, TreeNode_t *node);
+static int generateCondition(FILE *output, TreeNode_t *node, bool sense, int label);
+static int generateRegAssign(FILE *output, TreeNode_t *node);
+static int generateRegAddress(FILE *output, TreeNode_t *node);
+static int allocateLoop(FILE *output, TreeNode_t *node);
+static void releaseLoop(FILE *output, int kept);
+static bool loopCandidate(Symbol_t *entry);
+static void reloadLoopVar(FILE *output, TreeNode_t *node);
 
 
-static SymTable_t *currentScope = NULL;
+//state of the code generation running on this thread, set by CodeGen_process
+static THREAD_LOCAL CodeGenState_t *state = NULL;
 
-static void writeLine(FILE *output, bool newline, char *label, char *instruction, char *comment, int argc, ...) {
+/*
+ * Expressions are generated with an explicit stack of frames rather
+ * than by recursion, so deeply nested expressions are not limited by
+ * the size of the C stack. Each frame tracks how far along its node is:
+ *  stage 0: before its left (or only) operand is evaluated
+ *  stage 1: after the left operand, before the right operand
+ *  stage 2: after the right operand
+ */
+typedef struct ExpFrame_s {
+  TreeNode_t *node;
+  int stage;
+  //when optimizing: the register the node is evaluated into, the
+  //order of its operands (OperandOrder), and whether a comparison
+  //only sets the flags to be jumped on
+  int reg;
+  unsigned char order;
+  bool flagsOnly;
+} ExpFrame_t;
+
+/*
+ * Conditions are lowered to jumps with an explicit stack as well. Each
+ * frame jumps to label number 'label' if its condition is 'sense' and
+ * falls through otherwise, or places the label if it has no condition
+ * (its 'sense' then tells an 'or' short circuited to it from an 'and').
+ */
+typedef struct CondFrame_s {
+  TreeNode_t *node;
+  bool sense;
+  int label;
+} CondFrame_t;
+
+/*
+ * The dispatch of a case statement, searching between the clusters
+ * of its labels (see caselabels.h) to the one that holds the value.
+ */
+typedef struct CaseDispatch_s {
+  CaseLabels_t *labels;
+  int tableStart;
+  char *defaultLabel;
+  //search branches and jump tables labelled so far
+  int tags;
+} CaseDispatch_t;
+
+/*
+ * A statement being streamed that holds other statements, see
+ * CodeGen_stream. Its labels are numbered from 'label', like
+ * its generate<Kind>Start function returns.
+ */
+typedef struct StreamFrame_s {
+  int label;
+  //if statements: whether the else case was started,
+  //case statements: number of default cases started
+  int elses;
+} StreamFrame_t;
+
+static void printLine(FILE *output, bool newline, const char *label, const char *instruction,
+                      const char *comment, int argc, const char *const *args) {
   
   char commentLine = (!label && !instruction); 
   
@@ -267,14 +313,10 @@ static void writeLine(FILE *output, bool newline, char *label, char *instruction
       char *pos = argsBuf;
       memset(argsBuf, 0, sizeof(argsBuf));
       
-      va_list args;
-      va_start(args, argc);
-      
       for (int i = 0; i < argc - 1; i++)
-        pos += sprintf(pos, "%s, ", va_arg(args, char *));
-      sprintf(pos, "%s", va_arg(args, char *));
+        pos += sprintf(pos, "%s, ", args[i]);
+      sprintf(pos, "%s", args[argc - 1]);
       
-      va_end(args);
       fprintf(output, "%-*s", WRITE_ARGS_WIDTH, argsBuf);
     }
   }
@@ -293,18 +335,51 @@ static void writeLine(FILE *output, bool newline, char *label, char *instruction
     fprintf(output, "\n");
 }
 
+//print a line the peephole optimizer held back
+static void printPeepholeLine(FILE *output, const PeepholeLine_t *line) {
+
+  const char *args[PEEPHOLE_ARGS_MAX];
+  for (int i = 0; i < line->argc; i++)
+    args[i] = line->args[i];
+
+  printLine(output, true, line->label[0] ? line->label : NULL, line->op[0] ? line->op : NULL,
+            line->comment[0] ? line->comment : NULL, line->argc, args);
+}
+
+/*
+ * Write a line of assembly. When optimizing, whole lines are held back
+ * by the peephole optimizer, anything else is written after them.
+ */
+static void writeLine(FILE *output, bool newline, char *label, char *instruction, char *comment, int argc, ...) {
+
+  const char *args[argc > 0 ? argc : 1];
+  va_list values;
+  va_start(values, argc);
+  for (int i = 0; i < argc; i++)
+    args[i] = va_arg(values, char *);
+  va_end(values);
+
+  if (state->optimize) {
+    if (newline && !Peephole_add(&state->peephole, output, printPeepholeLine, label,
+                                 instruction, comment, argc, args))
+      return;
+    Peephole_flush(&state->peephole, output, printPeepholeLine);
+  }
+
+  printLine(output, newline, label, instruction, comment, argc, args);
+}
+
 
 
 static char *makeComment(GENERATE_COMMENT msg, ...) {
-  static char commentbuf[COMMENT_BUF_LEN];
 
   va_list values;
   va_start(values, msg);
   
-  vsnprintf(commentbuf, COMMENT_BUF_LEN, COMMENT_STRINGS[msg], values);
+  vsnprintf(state->commentBuf, COMMENT_BUF_LEN, COMMENT_STRINGS[msg], values);
   va_end(values);
   
-  return commentbuf;
+  return state->commentBuf;
 }
 
 
@@ -321,9 +396,8 @@ static void makeLabelEx(const char *prefix, char *output, size_t outputLen, int
 
 static int makeLabel(const char *prefix, char *output, size_t outputLen) {
   
-  static int labelCount = 0;   
-  makeLabelEx(prefix, output, outputLen, labelCount);
-  return labelCount++;
+  makeLabelEx(prefix, output, outputLen, state->labelCount);
+  return state->labelCount++;
 }
 
 static void tagLabel(char *output, size_t outputLen, const char *tagFmt, int value) {
@@ -336,10 +410,11 @@ static void tagLabel(char *output, size_t outputLen, const char *tagFmt, int val
 
 static int getConstInteger(TreeNode_t *node) {
   int value = -1;
-  if (node->entry)
-    value = node->entry->data.value;
+  Symbol_t *entry = TreeNode_getSymbolRef(node);
+  if (entry)
+    value = entry->data.value;
   else
-    value = node->token->lexeme.value;
+    value = TreeNode_getToken(node)->lexeme.value;
 
   return value;
 }
@@ -350,108 +425,175 @@ static int getConstInteger(TreeNode_t *node) {
  * local variables on the stack
  * Note: check enter and leave asm instructions
  */
-static int generateBlockStmt(FILE *output, TreeNode_t *node) {
+static void generateBlockStart(FILE *output, SymTable_t *scope) {
 
   char stackOffsetbuf[NUM_TO_STR_BUF];
-  snprintf(stackOffsetbuf, NUM_TO_STR_BUF, "%d", node->symbols->curStackPtr);
+  snprintf(stackOffsetbuf, NUM_TO_STR_BUF, "%d", scope->curStackPtr);
   
-  COMMENT_LINE(makeComment(NEW_SCOPE, node->symbols->stackFrameDepth));
+  COMMENT_LINE(makeComment(NEW_SCOPE, scope->stackFrameDepth));
 
   STORE_RESULT(REG_STACKFRAME);
   ASM_LINE("mov", 2, REG_STACKFRAME, REG_STACKPTR);
   ASM_LINE("sub", 2, REG_STACKPTR, stackOffsetbuf);
   
   //keep track of what scope we're at
-  currentScope = node->symbols;
-  //explore further statements
-  int status = generateStatement(output, TreeNode_getChild(node, 2));
-  
+  state->currentScope = scope;
+}
+
+static void generateBlockEnd(FILE *output, SymTable_t *scope) {
+
   //restore stack
-  char *endScopeComment = makeComment(LEAVE_SCOPE, node->symbols->stackFrameDepth);
+  char *endScopeComment = makeComment(LEAVE_SCOPE, scope->stackFrameDepth);
   writeLine(output, true, NULL, "mov", endScopeComment, 2, REG_STACKPTR, REG_STACKFRAME);
   RESTORE_RESULT(REG_STACKFRAME);
   
   //exit current scope
-  currentScope = node->symbols->parent;
-  
+  state->currentScope = scope->parent;
+}
+
+static int generateBlockStmt(FILE *output, TreeNode_t *node) {
+
+  SymTable_t *scope = TreeNode_getSymTable(node);
+  generateBlockStart(output, scope);
+
+  //explore further statements
+  int status = generateStatement(output, TreeNode_getChild(node, 2));
+
+  generateBlockEnd(output, scope);
   return status;
 }
 
-static int generateIfStmt(FILE *output, TreeNode_t *node) {
+/*
+ * Evaluate an if statement's condition, and jump to its false case
+ * if it is false. Returns the number of its false case label, which
+ * is followed by the number of its end label. -1 on error.
+ */
+static int generateIfStart(FILE *output, TreeNode_t *node) {
 
   COMMENT_LINE("If Statement...");
-  TreeNode_t *condition = TreeNode_getChild(node, 0),
-    *trueCase = TreeNode_getChild(node, 1),
-    *elseCase = TreeNode_getChild(node, 2);
-
-  //evaluate the condition first
-  if (generateExp(output, condition))
-    return -1;
+  TreeNode_t *condition = TreeNode_getChild(node, 0);
 
-  COMMENT_LINE("Condition evaluated");
   char falseLabel[COMMENT_BUF_LEN],
     endLabel[COMMENT_BUF_LEN];
   
-  MAKE_LABEL(falseLabel, COMMENT_BUF_LEN);
+  int label = MAKE_LABEL(falseLabel, COMMENT_BUF_LEN);
   MAKE_LABEL(endLabel, COMMENT_BUF_LEN);
 
-  //test for false case
-  TEST_REGISTER(REG_RETURN);
-  ASM_LINE("je", 1, falseLabel);
-
-  if (generateStatement(output, trueCase))
+  //jump right to the false case if the condition is false
+  if (generateCondition(output, condition, false, label))
     return -1;
 
+  COMMENT_LINE("Condition evaluated");
+  return label;
+}
+
+//end the true case, and start the false case
+static void generateIfElse(FILE *output, int label) {
+
+  char falseLabel[COMMENT_BUF_LEN],
+    endLabel[COMMENT_BUF_LEN];
+  makeLabelEx(LABEL_FMT, falseLabel, COMMENT_BUF_LEN, label);
+  makeLabelEx(LABEL_FMT, endLabel, COMMENT_BUF_LEN, label + 1);
+
   //skip else case in true case
   ASM_LINE("jmp", 1, endLabel);
   
   //write out false case now
   writeLine(output, true, falseLabel, NULL, NULL, 0);
+}
+
+static void generateIfEnd(FILE *output, int label) {
+
+  char endLabel[COMMENT_BUF_LEN];
+  makeLabelEx(LABEL_FMT, endLabel, COMMENT_BUF_LEN, label + 1);
+  writeLine(output, true, endLabel, NULL, NULL, 0);
+}
+
+static int generateIfStmt(FILE *output, TreeNode_t *node) {
+
+  TreeNode_t *trueCase = TreeNode_getChild(node, 1),
+    *elseCase = TreeNode_getChild(node, 2);
+
+  int label = generateIfStart(output, node);
+  if (label < 0)
+    return -1;
+
+  if (generateStatement(output, trueCase))
+    return -1;
+
+  generateIfElse(output, label);
 
   if (elseCase && generateStatement(output, elseCase))
     return -1;
   
-  writeLine(output, true, endLabel, NULL, NULL, 0);
+  generateIfEnd(output, label);
   return 0;
 }
 
-static int generateWhileStmt(FILE *output, TreeNode_t *node) {
+/*
+ * Start a while loop, evaluating its condition and leaving the loop
+ * if it is false. Returns the number of its repeat label, which is
+ * followed by the number of its exit label. -1 on error.
+ */
+static int generateWhileStart(FILE *output, TreeNode_t *node) {
 
-  TreeNode_t *condition = TreeNode_getChild(node, 0),
-    *loopCase = TreeNode_getChild(node, 1);
+  TreeNode_t *condition = TreeNode_getChild(node, 0);
 
   char repeatLabel[COMMENT_BUF_LEN],
     exitLabel[COMMENT_BUF_LEN];
 
-  MAKE_LABEL(repeatLabel, COMMENT_BUF_LEN);
+  int label = MAKE_LABEL(repeatLabel, COMMENT_BUF_LEN);
   MAKE_LABEL(exitLabel, COMMENT_BUF_LEN);
 
   writeLine(output, true, repeatLabel, NULL, "While loop", 0);
-  //evaluate the condition first
-  if (generateExp(output, condition))
+  //leave the loop as soon as the condition is false
+  if (generateCondition(output, condition, false, label + 1))
     return -1;
 
   COMMENT_LINE("Condition evaluated");
-  
-  //test for false case
-  TEST_REGISTER(REG_RETURN);
-  ASM_LINE("je", 1, exitLabel);
+  return label;
+}
 
-  //evaluate loop contents
-  if (generateStatement(output, loopCase))
-    return -1;
+static void generateWhileEnd(FILE *output, int label) {
+
+  char repeatLabel[COMMENT_BUF_LEN],
+    exitLabel[COMMENT_BUF_LEN];
+  makeLabelEx(LABEL_FMT, repeatLabel, COMMENT_BUF_LEN, label);
+  makeLabelEx(LABEL_FMT, exitLabel, COMMENT_BUF_LEN, label + 1);
 
   //jump back to process loop condition again
   ASM_LINE("jmp", 1, repeatLabel);
   
   //write out the exit label
   writeLine(output, true, exitLabel, NULL, "Exit While", 0);
+}
+
+static int generateWhileStmt(FILE *output, TreeNode_t *node) {
+
+  //keep the loop's most used variables in registers while in it
+  int kept = state->optimize ? allocateLoop(output, node) : 0;
+  if (kept < 0)
+    return -1;
+
+  int label = generateWhileStart(output, node);
+  if (label < 0)
+    return -1;
+
+  //evaluate loop contents
+  if (generateStatement(output, TreeNode_getChild(node, 1)))
+    return -1;
+
+  generateWhileEnd(output, label);
+  releaseLoop(output, kept);
   return 0;
 }
 
 //assign to variables
 static int generateAssignStmt(FILE *output, TreeNode_t *node) {
 
+  if (state->optimize)
+    return generateRegAssign(output, node);
+
   TreeNode_t *left = TreeNode_getChild(node, 0),
     *right = TreeNode_getChild(node, 1);
 
@@ -471,25 +613,26 @@ static int generateAssignStmt(FILE *output, TreeNode_t *node) {
   RESTORE_RESULT(REG_FREE);
 
   //move values from src to dest
-  writeLine(output, true, NULL, "mov", makeComment(ASSIGN_TO, left->entry->key), 2, DEREF_REG(REG_FREE), REG_RETURN);
+  writeLine(output, true, NULL, "mov", makeComment(ASSIGN_TO, TreeNode_getSymbolRef(left)->key), 2, DEREF_REG(REG_FREE), REG_RETURN);
   return 0;
 }
 
 int generateWriteStmt(FILE *output, TreeNode_t *node) {
 
   COMMENT_LINE("Write Call...");
-  TreeNode_t *args[node->argc];
+  int argc = TreeNode_getArgCount(node);
+  TreeNode_t *args[argc];
   
   TreeNode_t *firstArg = TreeNode_getChild(node, 0);
   
   //flip argument order
-  for (int i = node->argc - 1; i >= 0; i--) {
+  for (int i = argc - 1; i >= 0; i--) {
     args[i] = firstArg;
-    firstArg = firstArg->sibling;
+    firstArg = TreeNode_getSibling(firstArg);
   }
 
   //now go through arguments in proper order
-  for (int i = 0; i < node->argc; i++) {
+  for (int i = 0; i < argc; i++) {
     TreeNode_t *curArg = args[i];
     if (generateExp(output, curArg))
       return -1;
@@ -520,7 +663,7 @@ int generateWriteStmt(FILE *output, TreeNode_t *node) {
   //write number of arguments now
   size_t countBufLen = NUM_TO_STR_BUF + strlen("DWORD ") + 1;
   char countBuf[countBufLen];
-  snprintf(countBuf, countBufLen, "DWORD %d", node->argc);
+  snprintf(countBuf, countBufLen, "DWORD %d", argc);
   //push argc value for write function
   ASM_LINE("push", 1, countBuf);
   
@@ -529,27 +672,28 @@ int generateWriteStmt(FILE *output, TreeNode_t *node) {
   
   //fix stack on function exit, multiply by 2 since we are pushing
   //2 values per arg, + 1 for the number of arguments
-  CLEANUP_CALLSTACK((node->argc * 2) + 1);
+  CLEANUP_CALLSTACK((argc * 2) + 1);
   return 0;
 }
 
 static int generateReadStmt(FILE *output, TreeNode_t *node) {
   
   COMMENT_LINE("Write Call");
-  TreeNode_t *args[node->argc];
+  int argc = TreeNode_getArgCount(node);
+  TreeNode_t *args[argc];
   
   TreeNode_t *firstArg = TreeNode_getChild(node, 0);
   
   //flip argument order
-  for (int i = node->argc - 1; i >= 0; i--) {
+  for (int i = argc - 1; i >= 0; i--) {
     args[i] = firstArg;
-    firstArg = firstArg->sibling;
+    firstArg = TreeNode_getSibling(firstArg);
   }
   
   //now go through arguments in proper order
-  for (int i = 0; i < node->argc; i++) {
+  for (int i = 0; i < argc; i++) {
     TreeNode_t *curArg = args[i];
-    if (generateExp(output, curArg))
+    if (state->optimize ? generateRegAddress(output, curArg) : generateExp(output, curArg))
       return -1;
 
     //should have generated a variable in ecx
@@ -560,159 +704,285 @@ static int generateReadStmt(FILE *output, TreeNode_t *node) {
   //write number of arguments now
   size_t countBufLen = NUM_TO_STR_BUF + strlen("DWORD ") + 1;
   char countBuf[countBufLen];
-  snprintf(countBuf, countBufLen, "DWORD %d", node->argc);
+  snprintf(countBuf, countBufLen, "DWORD %d", argc);
   //push argc value for write function
   ASM_LINE("push", 1, countBuf);
   ASM_LINE("call", 1, "read");
-  CLEANUP_CALLSTACK(node->argc + 1);
+  CLEANUP_CALLSTACK(argc + 1);
+
+  //variables kept in registers were read into memory
+  for (int i = 0; state->optimize && i < argc; i++)
+    reloadLoopVar(output, args[i]);
   return 0;
 }
 
 
-static int generateCaseStmt(FILE *output, TreeNode_t *node) {
-
-  TreeNode_t *condition = TreeNode_getChild(node, 0),
-    *cases = TreeNode_getChild(node, 1),
-    *defaultCase = TreeNode_getChild(node, 2);
+/*
+ * Evaluate a case statement's expression. Returns the number of
+ * its label, which its other labels are tagged from.
+ * -1 on error.
+ */
+static int generateCaseStart(FILE *output, TreeNode_t *node) {
 
-  //make some important labels (lookup table start, default label, and end of switch)
-  char tableLabel[COMMENT_BUF_LEN],
-    tempLabel[COMMENT_BUF_LEN],
-    defaultLabel[COMMENT_BUF_LEN],
-    endCase[COMMENT_BUF_LEN];
-  
+  char tableLabel[COMMENT_BUF_LEN];
   int tableStart = makeLabel(TABLE_FMT, tableLabel, COMMENT_BUF_LEN);
-  
-  CASE_TAGGED_LABEL(defaultLabel, COMMENT_BUF_LEN, TABLE_TAG_DEF, 0);
-  CASE_TAGGED_LABEL(endCase, COMMENT_BUF_LEN, TABLE_TAG_END, 0);
 
-  char maxCaseStr[NUM_TO_STR_BUF];
-  int maxCaseVal = node->argc;
-  snprintf(maxCaseStr, NUM_TO_STR_BUF, "%d", maxCaseVal);
-  
   COMMENT_LINE("Switch Start");
   //evaluate condition
-  if (generateExp(output, condition))
+  if (generateExp(output, TreeNode_getChild(node, 0)))
     return -1;
 
+  return tableStart;
+}
 
-  TreeNode_t *curCase = cases;
+/*
+ * Label of the case a value of a case statement is jumped to, which
+ * is tagged with the value.
+ */
+static void caseValueLabel(char *output, size_t outputLen, int tableStart, int value) {
 
-  //if the number of potential cases is small enough
-  //implement a lookup table
-  if (maxCaseVal <= MAX_LOOKUP_SIZE) {
-    COMMENT_LINE("Switch Lookup");
-    //store the result for later
-    
-    //check if the expression evaluated to a value greater than the max case state
-    //if so, jump right to default case
-    ASM_LINE("cmp", 2, REG_RETURN, maxCaseStr);
-    ASM_LINE("ja", 1, defaultLabel);
-    
-    //otherwise, perform lookup
-    ASM_LINE("mov", 2, REG_FREE, tableLabel);
-    ASM_LINE("imul", 2, REG_RETURN, WORD_SIZE_BYTES_STR);
-    ASM_LINE("add", 2, REG_RETURN, REG_FREE);
-    ASM_LINE("jmp", 1, DEREF_REG(REG_RETURN));
-
-    /*
-     * Generating the lookup table:
-     *  go through all cases first and keep track of what
-     *  case numbers already exist
-     *
-     *  go through 0 to <MAX_CASE_VALUE> and for every case that
-     *  that exists gets mapped to its own label, every other case
-     *  will map to the default case label
-     */
-    
-    //lookup already existing cases
-    BitTreeNode_t *casesAdded = BitTreeNode_New();
-    if (!casesAdded) {
-      fprintf(stderr, "Error allocating bit tree for case statements\n");
-      return -1;
-    }
-    
-    
-    while (curCase) {
-      TreeNode_t *caseValue = TreeNode_getChild(curCase, 0);
-      do {
-        int caseNumber = getConstInteger(caseValue);
-        BitTreeNode_AddBitPattern(casesAdded, caseNumber);
-        caseValue = caseValue->sibling;
-      
-      } while (caseValue);
-      curCase = curCase->sibling;
-    }
-    
-    //now go through each case statement and generate the look up table
-    writeLine(output, true, tableLabel, NULL, "Case Lookup Table", 0);
-    for (int i = 0; i <= maxCaseVal; i++) {
-      bool exists = BitTreeNode_AddBitPattern(casesAdded, i);
-      if (exists) {
-        CASE_TAGGED_LABEL(tempLabel, COMMENT_BUF_LEN, TABLE_TAG_FMT, i);
-        MULTILINE_DECL(tempLabel, i, DECLS_PER_LINE);
-      } else
-        MULTILINE_DECL(defaultLabel, i, DECLS_PER_LINE);
-    }
-    fprintf(output, "\n");
-    BitTreeNode_Destroy(casesAdded);
+  if (value >= 0) {
+    CASE_TAGGED_LABEL(output, outputLen, TABLE_TAG_FMT, value);
+    return;
+  }
+
+  char tagBuffer[COMMENT_BUF_LEN];
+  makeLabelEx(TABLE_FMT, output, outputLen, tableStart);
+  snprintf(tagBuffer, COMMENT_BUF_LEN, TABLE_TAG_NEG_FMT, 0u - (unsigned)value);
+  SAFECAT(output, tagBuffer, outputLen);
+}
+
+//register the case dispatch can use besides REG_RETURN, REG_FREE
+//unless a loop's variable is kept in it (the first loop register)
+static const char *caseScratch(void) {
+
+  return state->loopVars[0] ? REG_VARADDR : REG_FREE;
+}
+
+/*
+ * Jump through a table of a cluster's cases, indexed by the value
+ * less the cluster's smallest label. Values outside of the table
+ * go to the default case.
+ */
+static void generateCaseTable(FILE *output, CaseDispatch_t *dispatch, CaseCluster_t *cluster) {
+
+  CaseLabels_t *labels = dispatch->labels;
+  int tableStart = dispatch->tableStart;
+  char tableLabel[COMMENT_BUF_LEN],
+    tempLabel[COMMENT_BUF_LEN],
+    numbuf[NUM_TO_STR_BUF];
 
+  int low = labels->values[cluster->first];
+  long long span = CaseLabels_span(labels, cluster);
+  CASE_TAGGED_LABEL(tableLabel, COMMENT_BUF_LEN, TABLE_TAG_TABLE_FMT, dispatch->tags++);
+
+  COMMENT_LINE("Switch Lookup");
+  if (low) {
+    snprintf(numbuf, NUM_TO_STR_BUF, "%d", low);
+    ASM_LINE("sub", 2, REG_RETURN, numbuf);
   }
-  //end of lookup table generation
-  //otherwise, just go through each case, and do a comparison
-  else {
-    char numbuf[NUM_TO_STR_BUF];
-    
-    while (curCase) {
-      TreeNode_t *caseValue = TreeNode_getChild(curCase, 0);
-      
-      do {
-  int caseNumber = getConstInteger(caseValue);
-  snprintf(numbuf, NUM_TO_STR_BUF, "%d", caseNumber);
+
+  //anything below the smallest label wrapped around, so a single
+  //unsigned comparison catches values on either side of the table
+  snprintf(numbuf, NUM_TO_STR_BUF, "%lld", span - 1);
   ASM_LINE("cmp", 2, REG_RETURN, numbuf);
-  CASE_TAGGED_LABEL(tempLabel, COMMENT_BUF_LEN, TABLE_TAG_FMT, caseNumber);
-  ASM_LINE("je", 1, tempLabel);
-  caseValue = caseValue->sibling;
-      } while (caseValue);
+  ASM_LINE("ja", 1, dispatch->defaultLabel);
+
+  //otherwise, perform lookup
+  ASM_LINE("mov", 2, caseScratch(), tableLabel);
+  ASM_LINE("imul", 2, REG_RETURN, WORD_SIZE_BYTES_STR);
+  ASM_LINE("add", 2, REG_RETURN, caseScratch());
+  ASM_LINE("jmp", 1, DEREF_REG(REG_RETURN));
+
+  /*
+   * Generating the lookup table:
+   *  go through the smallest label to the largest, every value that
+   *  has a label (the sorted labels are walked alongside) gets mapped
+   *  to its own label, every other value to the default case label
+   */
+  size_t next = cluster->first;
+  writeLine(output, true, tableLabel, NULL, "Case Lookup Table", 0);
+  for (long long i = 0; i < span; i++) {
+    if ((long long)labels->values[next] - low == i) {
+      caseValueLabel(tempLabel, COMMENT_BUF_LEN, tableStart, labels->values[next++]);
+      MULTILINE_DECL(tempLabel, i, DECLS_PER_LINE);
+    } else
+      MULTILINE_DECL(dispatch->defaultLabel, i, DECLS_PER_LINE);
+  }
+  fprintf(output, "\n");
+}
+
+/*
+ * Test the value's bit, less the cluster's smallest label, against
+ * a mask of each case's labels in the cluster. Any label of a case
+ * is at the start of that case, so its first is jumped to.
+ */
+static void generateCaseBits(FILE *output, CaseDispatch_t *dispatch, CaseCluster_t *cluster) {
+
+  CaseLabels_t *labels = dispatch->labels;
+  int tableStart = dispatch->tableStart;
+  char tempLabel[COMMENT_BUF_LEN],
+    numbuf[NUM_TO_STR_BUF];
+
+  int low = labels->values[cluster->first];
+  size_t last = cluster->first + cluster->count;
 
-      curCase = curCase->sibling;
+  COMMENT_LINE("Switch Bit Test");
+  if (low) {
+    snprintf(numbuf, NUM_TO_STR_BUF, "%d", low);
+    ASM_LINE("sub", 2, REG_RETURN, numbuf);
+  }
+  snprintf(numbuf, NUM_TO_STR_BUF, "%lld", CaseLabels_span(labels, cluster) - 1);
+  ASM_LINE("cmp", 2, REG_RETURN, numbuf);
+  ASM_LINE("ja", 1, dispatch->defaultLabel);
+
+  for (size_t i = cluster->first; i < last; i++) {
+    //only the first label of each case makes its mask
+    size_t seen = cluster->first;
+    while (labels->arms[seen] != labels->arms[i])
+      seen++;
+    if (seen < i)
+      continue;
+
+    unsigned int mask = 0;
+    for (size_t j = i; j < last; j++) {
+      if (labels->arms[j] == labels->arms[i])
+        mask |= 1u << (labels->values[j] - low);
+    }
+
+    snprintf(numbuf, NUM_TO_STR_BUF, "0x%x", mask);
+    ASM_LINE("mov", 2, caseScratch(), numbuf);
+    ASM_LINE("bt", 2, caseScratch(), REG_RETURN);
+    caseValueLabel(tempLabel, COMMENT_BUF_LEN, tableStart, labels->values[i]);
+    ASM_LINE("jc", 1, tempLabel);
+  }
+
+  ASM_LINE("jmp", 1, dispatch->defaultLabel);
+}
+
+/*
+ * Binary search between the clusters from 'first' up to 'last' on
+ * their smallest labels, until there is one left to dispatch with,
+ * or a few labels that are simply compared against.
+ */
+static void generateCaseSearch(FILE *output, CaseDispatch_t *dispatch, size_t first, size_t last) {
+
+  CaseLabels_t *labels = dispatch->labels;
+  CaseCluster_t *clusters = labels->clusters;
+  int tableStart = dispatch->tableStart;
+  char tempLabel[COMMENT_BUF_LEN],
+    numbuf[NUM_TO_STR_BUF];
+
+  bool chain = last - first <= MAX_COMPARE_CHAIN;
+  for (size_t i = first; chain && i < last; i++)
+    chain = clusters[i].kind == CASE_CLUSTER_COMPARE;
+
+  if (chain) {
+    for (size_t i = first; i < last; i++) {
+      int caseNumber = labels->values[clusters[i].first];
+      snprintf(numbuf, NUM_TO_STR_BUF, "%d", caseNumber);
+      ASM_LINE("cmp", 2, REG_RETURN, numbuf);
+      caseValueLabel(tempLabel, COMMENT_BUF_LEN, tableStart, caseNumber);
+      ASM_LINE("je", 1, tempLabel);
     }
-    
 
-    
-    //COMMENT_LINE("Not yet implemented case method!");
     //no comparisons matched, go to default case
-    ASM_LINE("jmp", 1, defaultLabel);
+    ASM_LINE("jmp", 1, dispatch->defaultLabel);
+    return;
+  }
+
+  if (last - first == 1) {
+    if (clusters[first].kind == CASE_CLUSTER_TABLE)
+      generateCaseTable(output, dispatch, &clusters[first]);
+    else
+      generateCaseBits(output, dispatch, &clusters[first]);
+    return;
+  }
+
+  //values below the middle cluster search the lower half
+  size_t middle = first + (last - first) / 2;
+  CASE_TAGGED_LABEL(tempLabel, COMMENT_BUF_LEN, TABLE_TAG_NODE_FMT, dispatch->tags++);
+  snprintf(numbuf, NUM_TO_STR_BUF, "%d", labels->values[clusters[middle].first]);
+  ASM_LINE("cmp", 2, REG_RETURN, numbuf);
+  ASM_LINE("jl", 1, tempLabel);
+
+  generateCaseSearch(output, dispatch, middle, last);
+  writeLine(output, true, tempLabel, NULL, "Switch Search", 0);
+  generateCaseSearch(output, dispatch, first, middle);
+}
+
+/*
+ * Jump from the value of a case statement's expression to its
+ * case, or to the default case if there is none for the value.
+ */
+static int generateCaseDispatch(FILE *output, TreeNode_t *node, int tableStart, char *defaultLabel) {
+
+  CaseDispatch_t dispatch = {
+    .labels = TreeNode_getCaseLabels(node),
+    .tableStart = tableStart,
+    .defaultLabel = defaultLabel,
+  };
+
+  if (!dispatch.labels) {
+    fprintf(stderr, "Case statement has no labels to dispatch with\n");
+    return -1;
   }
 
+  COMMENT_LINE("Switch Dispatch");
+  generateCaseSearch(output, &dispatch, 0, dispatch.labels->clusterCount);
+  return 0;
+}
+
+/*
+ * Cases can have multiple values associated with them,
+ * write out the labels of all of them.
+ */
+static void generateCaseLabels(FILE *output, TreeNode_t *curCase, int tableStart) {
+
+  char tempLabel[COMMENT_BUF_LEN];
+  TreeNode_t *caseValue = TreeNode_getChild(curCase, 0);
+
+  do {
+    int caseNumber = getConstInteger(caseValue);
+    caseValueLabel(tempLabel, COMMENT_BUF_LEN, tableStart, caseNumber);
+    writeLine(output, true, tempLabel, NULL, "case lookup", 0);
+    caseValue = TreeNode_getSibling(caseValue);      
+  } while (caseValue);
+}
+
+static int generateCaseStmt(FILE *output, TreeNode_t *node) {
+
+  TreeNode_t *cases = TreeNode_getChild(node, 1),
+    *defaultCase = TreeNode_getChild(node, 2);
 
+  int tableStart = generateCaseStart(output, node);
+  if (tableStart < 0)
+    return -1;
 
+  //make some important labels (default label, and end of switch)
+  char defaultLabel[COMMENT_BUF_LEN],
+    endCase[COMMENT_BUF_LEN];
+  
+  CASE_TAGGED_LABEL(defaultLabel, COMMENT_BUF_LEN, TABLE_TAG_DEF, 0);
+  CASE_TAGGED_LABEL(endCase, COMMENT_BUF_LEN, TABLE_TAG_END, 0);
 
+  if (generateCaseDispatch(output, node, tableStart, defaultLabel))
+    return -1;
   
   /*
    * Write out each case code now
    */
-  curCase = cases;
+  TreeNode_t *curCase = cases;
   while (curCase) {
-    TreeNode_t *caseValue = TreeNode_getChild(curCase, 0),
-      *caseCode = TreeNode_getChild(curCase, 1);
-
-    //cases can have multiple values associated with it
-    //so write out all those labels first
-    do {
-      int caseNumber = getConstInteger(caseValue);
-      CASE_TAGGED_LABEL(tempLabel, COMMENT_BUF_LEN, TABLE_TAG_FMT, caseNumber);
-      writeLine(output, true, tempLabel, NULL, "case lookup", 0);
-      caseValue = caseValue->sibling;      
-    } while (caseValue);
+    generateCaseLabels(output, curCase, tableStart);
 
     //then write out the code for this case
-    if (generateStatement(output, caseCode))
+    if (generateStatement(output, TreeNode_getChild(curCase, 1)))
       return -1;
 
     //exit code
     ASM_LINE("jmp", 1, endCase);
-    curCase = curCase->sibling;
+    curCase = TreeNode_getSibling(curCase);
   }
 
   //default case (else)
@@ -726,113 +996,86 @@ static int generateCaseStmt(FILE *output, TreeNode_t *node) {
 }
 
 
-static int generateRelop(FILE *output, TreeNode_t *node) {
-
-  TreeNode_t *left = TreeNode_getChild(node, 0),
-    *right = TreeNode_getChild(node, 1);
-
-  if (generateExp(output, left))
-    return -1;
-
-  //store left on stack for new return value
-  STORE_RESULT(REG_RETURN);
-
-  if (generateExp(output, right))
-    return -1;
-
-  STORE_RESULT(REG_RETURN);
-  RESTORE_RESULT(REG_FREE);
-  RESTORE_RESULT(REG_RETURN);
-
-  //peform the comparison here
-  ASM_LINE("cmp", 2, REG_RETURN, REG_FREE);
-  CLEAR_REGISTER(REG_RETURN);
+/*
+ * Condition code a relational operator holds on, or when it doesn't
+ * hold if 'negate' is set. NULL if the node isn't one of them.
+ */
+static const char *relopCondition(TreeNode_t *node, bool negate) {
 
-  char *instruction = NULL;
-  switch (node->token->type) {
+  switch (TreeNode_getToken(node)->type) {
   case TOK_EQ:
-    instruction = "setz";  
-    break;
-
+    return negate ? "ne" : "e";
   case TOK_NOTEQ:
-    instruction = "setnz";
-    break;
-    
+    return negate ? "e" : "ne";
   case TOK_LESS:
-    instruction = "setl";
-    break;
-    
+    return negate ? "ge" : "l";
   case TOK_GREATER:
-    instruction = "setg";
-    break;
-    
+    return negate ? "le" : "g";
   case TOK_LTEQ:
-    instruction = "setle";
-    break;
-
+    return negate ? "g" : "le";
   case TOK_GTEQ:
-    instruction = "setge";
-    break;
-
+    return negate ? "l" : "ge";
   default:
-    break;
+    return NULL;
   }
-  if (instruction)
-    ASM_LINE(instruction, 1, REG_RETURN_BYTE);
-  else
-    COMMENT_LINE(makeComment(NO_OPERATOR, node->token->type));
-  
-  return 0;
 }
 
+//the right operand is in REG_RETURN, the left operand on the stack
+static void compareOperands(FILE *output) {
 
-static int generateOR(FILE *output, TreeNode_t *node, char *shortLabel) {
+  ASM_LINE("mov", 2, REG_FREE, REG_RETURN);
+  RESTORE_RESULT(REG_RETURN);
+  //peform the comparison here
+  ASM_LINE("cmp", 2, REG_RETURN, REG_FREE);
+}
 
-  char *shortCircuit = NULL;
-  SHORTCIRCUIT_CONDITION(shortCircuit, TOK_KEY_OR, generateOR);
+/*
+ * A comparison whose value is kept, rather than jumped on, is set
+ * from the flags into REG_RETURN.
+ */
+static int generateRelop(FILE *output, TreeNode_t *node) {
 
-  RESTORE_RESULT(REG_FREE);
-  //store r-value
-  STORE_RESULT(REG_RETURN);
+  const char *condition = relopCondition(node, TreeNode_hasType(node, NOT));
+  if (!condition) {
+    COMMENT_LINE(makeComment(NO_OPERATOR, TreeNode_getToken(node)->type));
+    return 0;
+  }
 
-  //clear REG_RETURN
+  char instruction[WRITE_INST_WIDTH];
+  snprintf(instruction, WRITE_INST_WIDTH, "set%s", condition);
+
+  compareOperands(output);
   CLEAR_REGISTER(REG_RETURN);
-  //compare l-value first
-  TEST_REGISTER(REG_FREE);
-  //store result to REG_RETURN
-  ASM_LINE("setne", 1, REG_RETURN_BYTE);
-  RESTORE_RESULT(REG_FREE);
-  //short circuit the or evaluation if true
-  ASM_LINE("jne", 1, shortLabel);
-    //now do the same for the next value
-  TEST_REGISTER(REG_FREE);
-  ASM_LINE("setne", 1, REG_RETURN_BYTE);
-  //add label for short circuiting
-  if (shortCircuit) {
-    writeLine(output, true, shortCircuit, NULL, makeComment(SHORTED_OR), 0);
-    free(shortCircuit);
-  }
-    
+  ASM_LINE(instruction, 1, REG_RETURN_BYTE);
   return 0;
 }
 
-static int generateSimpExp(FILE *output, TreeNode_t *node) {
+/*
+ * An 'or' or 'and' whose value is kept is lowered to jumps like any
+ * other condition, and only its result is put in REG_RETURN.
+ */
+static int generateBoolean(FILE *output, TreeNode_t *node) {
 
-  if (node->token->type == TOK_KEY_OR)
-    return generateOR(output, node, NULL);
-  
-  TreeNode_t *left = TreeNode_getChild(node, 0),
-    *right = TreeNode_getChild(node, 1);
+  char falseLabel[COMMENT_BUF_LEN],
+    endLabel[COMMENT_BUF_LEN];
+  int label = MAKE_LABEL(falseLabel, COMMENT_BUF_LEN);
+  MAKE_LABEL(endLabel, COMMENT_BUF_LEN);
 
-  if (generateExp(output, left))
+  if (generateCondition(output, node, false, label))
     return -1;
 
-  STORE_RESULT(REG_RETURN);
+  ASM_LINE("mov", 2, REG_RETURN, "1");
+  ASM_LINE("jmp", 1, endLabel);
+  writeLine(output, true, falseLabel, NULL, NULL, 0);
+  CLEAR_REGISTER(REG_RETURN);
+  writeLine(output, true, endLabel, NULL, NULL, 0);
+  return 0;
+}
 
-  if (generateExp(output, right))
-    return -1;
+static int generateSimpExp(FILE *output, ExpFrame_t *frame) {
 
-  switch (node->token->type) {
+  TreeNode_t *node = frame->node;
+  switch (TreeNode_getToken(node)->type) {
   case TOK_PLUS:
     //adding is commutative
     RESTORE_RESULT(REG_FREE);
@@ -845,69 +1088,18 @@ static int generateSimpExp(FILE *output, TreeNode_t *node) {
     RESTORE_RESULT(REG_RETURN);
     ASM_LINE("sub", 2, REG_RETURN, REG_FREE);
     break;
-  case TOK_KEY_OR:
-    break;
   }
   return 0;
 }
 
-static int generateAND(FILE *output, TreeNode_t *node, char *shortLabel) {
+static int generateTerm(FILE *output, ExpFrame_t *frame) {
 
-
-  char *shortCircuit = NULL;
-  SHORTCIRCUIT_CONDITION(shortCircuit, TOK_KEY_AND, generateAND);
-  
-  //get l-value
-  RESTORE_RESULT(REG_FREE);
-  //store r-value
-  STORE_RESULT(REG_RETURN);
-  
-  //clear REG_RETURN
-  CLEAR_REGISTER(REG_RETURN);
-  //compare l-value first
-  TEST_REGISTER(REG_FREE);
-  //store result to REG_RETURN, if equal to 0, short circuit
-  ASM_LINE("setne", 1, REG_RETURN_BYTE);
-  RESTORE_RESULT(REG_FREE);
-  //short circuit if equal to 0
-  ASM_LINE("jz", 1, shortLabel);
-  //now do the same for the next value
-  TEST_REGISTER(REG_FREE);
-  writeLine(output, true, NULL, "setne", NULL, 1, REG_FREE_BYTE);
-  //peform and
-  ASM_LINE("and", 2, REG_RETURN, REG_FREE);
-  
-  //add label for short circuiting
-  if (shortCircuit) {
-    writeLine(output, true, shortCircuit, NULL,  makeComment(SHORTED_AND),  0);
-    free(shortCircuit);
-  }
-
-  return 0;
-}
-
-static int generateTerm(FILE *output, TreeNode_t *node) {
-
-  if (node->token->type == TOK_KEY_AND)
-    return generateAND(output, node, NULL);
-
-  TreeNode_t *left = TreeNode_getChild(node, 0),
-    *right = TreeNode_getChild(node, 1);
-
-  
-  if (generateExp(output, left))
-    return -1;
-
-  //store left on stack for new return value
-  STORE_RESULT(REG_RETURN);
-
-  if (generateExp(output, right))
-    return -1;
+  TreeNode_t *node = frame->node;
 
   //right expression now stored in REG_RETURN
  
   //perform operation
-  switch (node->token->type) {
+  switch (TreeNode_getToken(node)->type) {
   case TOK_STAR:
     //get left result into free reg, order doesn't matter for multiply
     RESTORE_RESULT(REG_FREE);
@@ -926,18 +1118,13 @@ static int generateTerm(FILE *output, TreeNode_t *node) {
     //divide REG_RETURN by REG_FREE
     ASM_LINE("idiv", 1, "DWORD "REG_FREE);
     //exit now for division
-    if (node->token->type == TOK_KEY_DIV)
+    if (TreeNode_getToken(node)->type == TOK_KEY_DIV)
       break;
 
     //otherwise, move remainder to REG_RETURN
     ASM_LINE("mov", 2, REG_RETURN, "edx");
     break;
 
-  
-  case TOK_KEY_AND: {
-
-  } break;
-
   case TOK_KEY_SHR:
     //swap eax and ebx for shifting so that eax = eax >> ebx
     ASM_LINE("mov", 2, REG_SHIFT, REG_RETURN_BYTE);
@@ -977,49 +1164,36 @@ static int generateNot(FILE *output, char *value) {
 }
 
 
-//loads value of variable to eax and address of variable to ecx
+//loads value of variable to eax and address of variable to ecx,
+//an array's index has already been evaluated into eax
 static int generateVariable(FILE *output, TreeNode_t *node) {
   
   //load variable to return register
   char buffer[NUM_TO_STR_BUF];
+  Symbol_t *entry = TreeNode_getSymbolRef(node);
   
-  //calculate how many bytes we need to look behind to add to
-  //the relative offset stored in the symbol
-  int stackOffset = 0;
-  SymTable_findAll(currentScope, node->entry->key, &stackOffset);
-
-  //offsets started at 0, so add 1 word to get the proper position
-  int varOffset = node->entry->stackOffset + WORD_SIZE_BYTES;  
-  stackOffset += -varOffset;
+  //the bytes to look behind the scope's frame were worked
+  //out from the scopes' frame bases as they were analyzed
+  int stackOffset = SymTable_frameOffset(state->currentScope, entry);
   
   //look up the stack offset for the variable
   snprintf(buffer, NUM_TO_STR_BUF, STACK_VAR_FMT, stackOffset);
 
   if (TreeNode_hasType(node, ARRAY)) {
-    COMMENT_LINE(makeComment(ARRAY_INDEX, node->entry->key));
-    //evaluate array indexing size
-    if (generateExp(output, TreeNode_getChild(node, 0)))
-      return -1;
-
-    //convert offset size into bytes
-    ASM_LINE("imul", 2, REG_RETURN, WORD_SIZE_BYTES_STR);
-    //offset stored in eax...
-    STORE_RESULT(REG_RETURN);
-
-    //load array base address to add onto
-    ASM_LINE("lea", 2, REG_VARADDR, buffer);
-    RESTORE_RESULT(REG_FREE);
-    //add index offset to array address
-    ASM_LINE("sub", 2, REG_VARADDR, REG_FREE);
+    //the index in eax is scaled onto the address of the first element
+    char element[COMMENT_BUF_LEN];
+    snprintf(element, COMMENT_BUF_LEN, ELEMENT_FMT, REG_RETURN,
+             SymTable_elementOffset(state->currentScope, entry, 0));
+    ASM_LINE("lea", 2, REG_VARADDR, element);
   } else {
-    COMMENT_LINE(makeComment(LOAD_VAR, node->entry->key));
+    COMMENT_LINE(makeComment(LOAD_VAR, entry->key));
     ASM_LINE("lea", 2, REG_VARADDR, buffer);
   }
 
   ASM_LINE("mov", 2, REG_RETURN, DEREF_REG(REG_VARADDR));
   //check if we need to negate the value
   if (TreeNode_hasType(node, NOT))
-    generateNot(output, node->entry->key);
+    generateNot(output, entry->key);
 
   return 0;
 }
@@ -1027,21 +1201,22 @@ static int generateVariable(FILE *output, TreeNode_t *node) {
 static int generateConstant(FILE *output, TreeNode_t *node) {
 
   char numbuffer[NUM_TO_STR_BUF];
-  if (node->entry) {
+  Symbol_t *entry = TreeNode_getSymbolRef(node);
+  if (entry) {
     //dealing with a constant/literal string in the rodata table
     //copy string address to REG_RETURN
-    if (Symbol_hasType(node->entry, SYMTYPE_INT)) {
-      snprintf(numbuffer, NUM_TO_STR_BUF, "%d", node->entry->data.value);
+    if (Symbol_hasType(entry, SYMTYPE_INT)) {
+      snprintf(numbuffer, NUM_TO_STR_BUF, "%d", entry->data.value);
       ASM_LINE("mov", 2, REG_RETURN, numbuffer);
     }
     else
-      ASM_LINE("mov", 2, REG_RETURN, node->entry->key);
+      ASM_LINE("mov", 2, REG_RETURN, entry->key);
     
     return 0;
   }
   
   //otherwise, we are dealing with a literal integer 
-  snprintf(numbuffer, NUM_TO_STR_BUF, "%d", node->token->lexeme.value);
+  snprintf(numbuffer, NUM_TO_STR_BUF, "%d", TreeNode_getToken(node)->lexeme.value);
   ASM_LINE("mov", 2, REG_RETURN, numbuffer);
 
   if (TreeNode_hasType(node, NOT))
@@ -1052,150 +1227,1862 @@ static int generateConstant(FILE *output, TreeNode_t *node) {
 
 
 
-int generateExp(FILE *output, TreeNode_t *node) {
+/*
+ * Push an expression node onto the expression stack.
+ */
+static int pushExp(TreeNode_t *node, int reg) {
 
-  unsigned long long type = node->type & EXP_FILTER;
-  
-  switch (type) {
-  case NODETYPE_BIT(RELOP):
-    TreeNode_rmType(node, RELOP);
-    return generateRelop(output, node);
+  if (state->expStackTop == state->expStackSize) {
+    size_t size = state->expStackSize ? state->expStackSize << 1 : EXP_STACK_BASE_SIZE;
+    ExpFrame_t *stack = realloc(state->expStack, size * sizeof(ExpFrame_t));
+    if (!stack) {
+      fprintf(stderr, "Error growing expression stack\n");
+      return -1;
+    }
+    state->expStack = stack;
+    state->expStackSize = size;
+  }
+
+  state->expStack[state->expStackTop++] = (ExpFrame_t) {
+    .node = node,
+    .reg = reg,
+  };
+  return 0;
+}
+
+/*
+ * Stages of an operator with two operands: evaluate the left operand,
+ * keep it on the stack while the right operand is evaluated.
+ * Returns true once both operands have been evaluated.
+ */
+static bool binaryOperands(FILE *output, ExpFrame_t *frame, TreeNode_t **operand) {
+
+  int stage = frame->stage++;
+  if (stage > 1)
+    return true;
 
-  case NODETYPE_BIT(BINOP):
-    return generateSimpExp(output, node);
+  //store left on stack for new return value
+  if (stage == 1)
+    STORE_RESULT(REG_RETURN);
 
-  case NODETYPE_BIT(MULOP):
-    return generateTerm(output, node);
+  *operand = TreeNode_getChild(frame->node, stage);
+  return false;
+}
 
-  case NODETYPE_BIT(VARIABLE):
-    return generateVariable(output, node);
+//'or' and 'and' are evaluated by jumping past their right operand
+static bool isShortCircuit(TreeNode_t *node) {
 
-  case NODETYPE_BIT(CONSTANT):
-    return generateConstant(output, node);
+  int type = TreeNode_getToken(node)->type;
+  return (node->kind == NODEKIND_BINOP && type == TOK_KEY_OR) ||
+    (node->kind == NODEKIND_MULOP && type == TOK_KEY_AND);
+}
 
-  case NODETYPE_BIT(UNARYOP):
-    if (generateExp(output, TreeNode_getChild(node, 0)))
-      return -1;
+//an operator's result that was 'not'ed, variables and constants do their own
+static void generateNotResult(FILE *output, TreeNode_t *node) {
 
-    //unary - sign, make value negative
-    if (node->token->type == TOK_MINUS)
-      ASM_LINE("neg", 1, REG_RETURN);
+  if (TreeNode_hasType(node, NOT))
+    generateNot(output, TreeNode_getToken(node)->lexeme.string);
+}
+
+/*
+ * Each kind of expression node is generated in stages by one of the
+ * functions below. If an operand needs to be evaluated before the
+ * node can continue, it is returned in 'operand', otherwise the node
+ * is done.
+ */
+typedef int (*ExpStage_t)(FILE *output, ExpFrame_t *frame, TreeNode_t **operand);
+
+static int stageRelop(FILE *output, ExpFrame_t *frame, TreeNode_t **operand) {
+
+  if (!binaryOperands(output, frame, operand))
     return 0;
 
-  }
+  return generateRelop(output, frame->node);
+}
+
+static int stageSimpExp(FILE *output, ExpFrame_t *frame, TreeNode_t **operand) {
+
+  if (isShortCircuit(frame->node))
+    return generateBoolean(output, frame->node);
+
+  if (!binaryOperands(output, frame, operand))
+    return 0;
+
+  if (generateSimpExp(output, frame))
+    return -1;
 
+  generateNotResult(output, frame->node);
   return 0;
 }
 
+static int stageTerm(FILE *output, ExpFrame_t *frame, TreeNode_t **operand) {
 
-int generateStatement(FILE *output, TreeNode_t *node) {
+  if (isShortCircuit(frame->node))
+    return generateBoolean(output, frame->node);
 
-  //  TreeNode_printNode(stdout, node, false); 
-  if (!node) {
-    fprintf(stderr, "Null statement\n");
+  if (!binaryOperands(output, frame, operand))
+    return 0;
+
+  if (generateTerm(output, frame))
+    return -1;
+
+  generateNotResult(output, frame->node);
+  return 0;
+}
+
+static int stageUnary(FILE *output, ExpFrame_t *frame, TreeNode_t **operand) {
+
+  if (frame->stage++ == 0) {
+    *operand = TreeNode_getChild(frame->node, 0);
     return 0;
   }
-  unsigned long long type = node->type & STMT_FILTER;
-  
-  switch (type) {
-  case NODETYPE_BIT(STMT_LIST):{
-    //while in statement list, go through all statement siblings
-    TreeNode_t *stmts = TreeNode_getChild(node, 0);
 
-    do {
-      if (generateStatement(output, stmts))
-        return -1;
+  //unary - sign, make value negative
+  if (TreeNode_getToken(frame->node)->type == TOK_MINUS)
+    ASM_LINE("neg", 1, REG_RETURN);
 
-      stmts = stmts->sibling;
-    } while (stmts);
-    
-  } break;
-  case NODETYPE_BIT(READ_STMT):
-    return generateReadStmt(output, node);
-    
-  case NODETYPE_BIT(WRITE_STMT):
-    return generateWriteStmt(output, node);
+  generateNotResult(output, frame->node);
+  return 0;
+}
 
-  case NODETYPE_BIT(CASE_STMT):
-    return generateCaseStmt(output, node);
+static int stageArray(FILE *output, ExpFrame_t *frame, TreeNode_t **operand) {
 
-  case NODETYPE_BIT(WHILE_STMT):
-    return generateWhileStmt(output, node);
-  
-  case NODETYPE_BIT(IF_STMT):
-    return generateIfStmt(output, node);
-    
-  case NODETYPE_BIT(ASSIGN_STMT):
-    return generateAssignStmt(output, node);
+  if (frame->stage++ == 0) {
+    COMMENT_LINE(makeComment(ARRAY_INDEX, TreeNode_getSymbolRef(frame->node)->key));
+    //evaluate array indexing size
+    *operand = TreeNode_getChild(frame->node, 0);
+    return 0;
+  }
 
-  case NODETYPE_BIT(BLOCK_STMT):
-    return generateBlockStmt(output, node);
+  return generateVariable(output, frame->node);
+}
 
-  default:
+static int stageVariable(FILE *output, ExpFrame_t *frame, TreeNode_t **operand) {
+
+  return generateVariable(output, frame->node);
+}
+
+static int stageConstant(FILE *output, ExpFrame_t *frame, TreeNode_t **operand) {
+
+  return generateConstant(output, frame->node);
+}
+
+static const ExpStage_t EXP_STAGES[NODEKIND_COUNT] = {
+  [NODEKIND_RELOP] = stageRelop,
+  [NODEKIND_BINOP] = stageSimpExp,
+  [NODEKIND_MULOP] = stageTerm,
+  [NODEKIND_UNARYOP] = stageUnary,
+  [NODEKIND_ARRAY] = stageArray,
+  [NODEKIND_VARIABLE] = stageVariable,
+  [NODEKIND_CONSTANT] = stageConstant,
+};
+
+/*
+ * When optimizing, expressions are evaluated in registers instead.
+ * Each node is first numbered with the registers it needs (Sethi-Ullman
+ * numbering), then the operand needing more of them is evaluated first,
+ * into the register its operator's result goes in, so that the other
+ * operand only needs the registers after it. Only when both operands
+ * need more registers than are left is one spilled onto the stack.
+ *
+ * Registers are numbered by their place in REGISTERS. The ones not
+ * keeping a loop's variables (see allocateLoop) make up the register
+ * pool, eax always first. A node evaluated into slot 'reg' of the pool
+ * may use that register and the ones after it, the ones before it
+ * hold operands waiting to be used.
+ */
+static const char *const REGISTERS[REGISTER_COUNT] = {"eax", "ebx", "ecx", "edx", "esi", "edi"};
+//low bytes of the registers, esi and edi have none
+static const char *const REGISTER_BYTES[REGISTER_COUNT] = {"al", "bl", "cl", "dl", NULL, NULL};
+
+//registers division and shifting are tied to
+#define REG_INDEX_EAX 0
+#define REG_INDEX_ECX 2
+#define REG_INDEX_EDX 3
+
+//registers loop variables are kept in, which calls leave alone (ebx, esi, edi)
+static const int LOOP_REGISTERS[LOOP_REGISTER_COUNT] = {1, 4, 5};
+
+#define SLOT_NAME(slot) (REGISTERS[state->registerPool[(slot)]])
+
+//fill the register pool with the registers not keeping loop variables
+static void fillRegisterPool(void) {
+
+  state->poolSize = 0;
+  for (int reg = 0; reg < REGISTER_COUNT; reg++) {
+    bool kept = false;
+    for (int i = 0; i < LOOP_REGISTER_COUNT; i++)
+      kept |= state->loopVars[i] && LOOP_REGISTERS[i] == reg;
+
+    if (!kept)
+      state->registerPool[state->poolSize++] = reg;
+  }
+}
+
+//slot of a register in the pool, the pool's size if it isn't in it
+static int registerSlot(int reg) {
+
+  for (int slot = 0; slot < state->poolSize; slot++) {
+    if (state->registerPool[slot] == reg)
+      return slot;
+  }
+  return state->poolSize;
+}
+
+//register a variable is kept in through the loops being generated, -1 if none
+static int loopRegister(Symbol_t *entry) {
+
+  for (int i = 0; i < LOOP_REGISTER_COUNT; i++) {
+    if (entry && state->loopVars[i] == entry)
+      return LOOP_REGISTERS[i];
+  }
+  return -1;
+}
+
+//order a binary operator's operands are evaluated in
+typedef enum {
+  //the right operand is a constant or variable used as it is
+  OPERANDS_DIRECT,
+  //the same for the left operand, the operator commutes
+  OPERANDS_SWAPPED,
+  //the left operand first, the right one into the next register
+  OPERANDS_LEFT,
+  //the right operand first, the left one into the next register
+  OPERANDS_RIGHT,
+  //the right operand first, kept on the stack while the left is evaluated
+  OPERANDS_SPILL,
+} OperandOrder;
+
+typedef enum {
+  OPERAND_REG,
+  OPERAND_IMM,
+  OPERAND_MEM,
+  OPERAND_ELEMENT,
+  OPERAND_STACK,
+} OperandKind;
+
+//where the right operand of a binary operator is
+typedef struct RegOperand_s {
+  OperandKind kind;
+  //index of the register, the constant, or the variable's (element's) frame offset
+  int value;
+  //OPERAND_ELEMENT: register the index is in, scaled onto 'value'
+  int index;
+  //OPERAND_STACK: number of words pushed on top of it
+  int depth;
+} RegOperand_t;
+
+//the address of a variable or an element, without its size
+static void addressText(RegOperand_t *operand, char *output, size_t outputLen) {
+
+  if (operand->kind == OPERAND_ELEMENT)
+    snprintf(output, outputLen, ELEMENT_FMT, REGISTERS[operand->index], operand->value);
+  else
+    snprintf(output, outputLen, STACK_VAR_FMT, operand->value);
+}
+
+static void operandText(RegOperand_t *operand, char *output, size_t outputLen) {
+
+  switch (operand->kind) {
+  case OPERAND_REG:
+    snprintf(output, outputLen, "%s", REGISTERS[operand->value]);
+    break;
+  case OPERAND_IMM:
+    snprintf(output, outputLen, "%d", operand->value);
+    break;
+  case OPERAND_MEM:
+  case OPERAND_ELEMENT: {
+    char address[COMMENT_BUF_LEN];
+    addressText(operand, address, COMMENT_BUF_LEN);
+    snprintf(output, outputLen, "DWORD %s", address);
+    break;
+  }
+  case OPERAND_STACK:
+    if (operand->depth)
+      snprintf(output, outputLen, "DWORD ["REG_STACKPTR"+%d]", operand->depth * WORD_SIZE_BYTES);
+    else
+      snprintf(output, outputLen, "DWORD ["REG_STACKPTR"]");
     break;
   }
+}
 
+//largest constant added onto an index that is folded into the displacement
+#define INDEX_FOLD_MAX (1 << 20)
 
-  return 0;
+//value of a constant integer, false if the node isn't one
+static bool constantValue(TreeNode_t *node, int *value) {
+
+  Symbol_t *entry = TreeNode_getSymbolRef(node);
+  if (node->kind != NODEKIND_CONSTANT || TreeNode_hasType(node, NOT) ||
+      (entry && !Symbol_hasType(entry, SYMTYPE_INT)))
+    return false;
+
+  *value = entry ? entry->data.value : TreeNode_getToken(node)->lexeme.value;
+  return true;
+}
+
+/*
+ * Split an array's index into the part evaluated at run time, NULL if
+ * there is none, and a constant added onto it, which is folded into
+ * the displacement of the element instead.
+ */
+static TreeNode_t *splitIndex(TreeNode_t *index, int *bias) {
+
+  int value;
+  *bias = 0;
+  if (constantValue(index, bias))
+    return NULL;
+
+  if (index->kind != NODEKIND_BINOP || TreeNode_hasType(index, NOT))
+    return index;
+
+  int type = TreeNode_getToken(index)->type;
+  TreeNode_t *left = TreeNode_getChild(index, 0),
+    *right = TreeNode_getChild(index, 1);
+  if (type != TOK_PLUS && type != TOK_MINUS)
+    return index;
+
+  //the scaled constant has to fit in the displacement
+  if (constantValue(right, &value) && value >= -INDEX_FOLD_MAX && value <= INDEX_FOLD_MAX) {
+    *bias = type == TOK_PLUS ? value : -value;
+    return left;
+  }
+  if (type == TOK_PLUS && constantValue(left, &value) && value >= -INDEX_FOLD_MAX && value <= INDEX_FOLD_MAX) {
+    *bias = value;
+    return right;
+  }
+  return index;
 }
 
+/*
+ * Whether an array's element can be addressed without evaluating its
+ * index into a register: it is a constant, or a variable kept in a
+ * register, with a constant added on. If so, and 'operand' isn't
+ * NULL, it is set to where the element is.
+ */
+static bool elementOperand(TreeNode_t *node, RegOperand_t *operand) {
+
+  int bias;
+  Symbol_t *entry = TreeNode_getSymbolRef(node);
+  TreeNode_t *index = splitIndex(TreeNode_getChild(node, 0), &bias);
+  RegOperand_t element = {
+    .kind = OPERAND_MEM,
+    .value = SymTable_elementOffset(state->currentScope, entry, bias),
+  };
+
+  if (index) {
+    if (index->kind != NODEKIND_VARIABLE || TreeNode_hasType(index, NOT) ||
+        loopRegister(TreeNode_getSymbolRef(index)) < 0)
+      return false;
+
+    element.kind = OPERAND_ELEMENT;
+    element.index = loopRegister(TreeNode_getSymbolRef(index));
+  }
 
-//action to perform when going through the rodata hash table
-static int writeStrConst(Symbol_t *symbol, void *data) {
-  
-  FILE *output = (FILE *)data;
-  writeLine(output, false, symbol->key, "dd", NULL, 0);
-  //some strings can be much longer than what writeLine intends
-  //to handle on a general basis
-  fprintf(output, "%s,0\n", symbol->data.string);
-  return 0;
+  if (operand)
+    *operand = element;
+  return true;
 }
 
-static int writeASMHeader(FILE *output) {
-  fprintf(output, FILE_HEADER);
-  COMMENT_LINE("io library definitions");
-  writeLine(output, true, NULL, "extern", NULL, 2, "read", "write");
-  COMMENT_LINE("define main function");
-  writeLine(output, true, NULL, "global", NULL, 1, MAIN_LABEL);
-  
-  return 0;
+/*
+ * Whether 'node' can be the right operand of the operator 'type' as
+ * it is, without being loaded into a register first. If so, and
+ * 'operand' isn't NULL, it is set to where the node is.
+ */
+static bool directOperand(TreeNode_t *node, int type, RegOperand_t *operand) {
+
+  if (TreeNode_hasType(node, NOT))
+    return false;
+
+  bool division = type == TOK_KEY_DIV || type == TOK_KEY_MOD;
+  bool shift = type == TOK_KEY_SHL || type == TOK_KEY_SHR;
+  Symbol_t *entry = TreeNode_getSymbolRef(node);
+  RegOperand_t direct;
+
+  if (node->kind == NODEKIND_CONSTANT && !division) {
+    //string constants are only ever moved around
+    if (entry && !Symbol_hasType(entry, SYMTYPE_INT))
+      return false;
+
+    direct = (RegOperand_t) {
+      .kind = OPERAND_IMM,
+      .value = entry ? entry->data.value : TreeNode_getToken(node)->lexeme.value,
+    };
+    //the count is masked by the shift itself, so keep it in a byte
+    if (shift)
+      direct.value &= 31;
+  } else if (node->kind == NODEKIND_VARIABLE && !shift) {
+    //a variable kept through a loop is used from its register
+    int reg = loopRegister(entry);
+    direct = (RegOperand_t) {
+      .kind = reg >= 0 ? OPERAND_REG : OPERAND_MEM,
+      .value = reg >= 0 ? reg : SymTable_frameOffset(state->currentScope, entry),
+    };
+  } else if (node->kind == NODEKIND_ARRAY && !shift) {
+    if (!elementOperand(node, &direct))
+      return false;
+  } else
+    return false;
+
+  if (operand)
+    *operand = direct;
+  return true;
 }
 
+//operators whose operands can be swapped around
+static bool commutes(int type) {
 
-static int writeReadOnlyData(FILE *output, SymTable_t *rodata) {
+  return type == TOK_PLUS || type == TOK_STAR || type == TOK_EQ || type == TOK_NOTEQ;
+}
 
-  BLANK_LINE;
-  SECTION_LINE(".rodata");
-  return SymTable_forEach(rodata, (void *)output, writeStrConst);
+//registers needed by a node whose operands have been numbered
+static int registersNeeded(TreeNode_t *node) {
+
+  TreeNode_t *left = TreeNode_getChild(node, 0),
+    *right = TreeNode_getChild(node, 1);
+
+  switch (node->kind) {
+  case NODEKIND_RELOP:
+  case NODEKIND_BINOP:
+  case NODEKIND_MULOP: {
+    //'or' and 'and' save the registers in use themselves
+    if (isShortCircuit(node))
+      return 1;
+
+    int type = TreeNode_getToken(node)->type;
+    int leftNeed = left->registers,
+      rightNeed = directOperand(right, type, NULL) ? 0 : right->registers;
+    if (rightNeed && commutes(type) && directOperand(left, type, NULL))
+      return rightNeed;
+
+    int need = leftNeed == rightNeed ? leftNeed + 1 : (leftNeed > rightNeed ? leftNeed : rightNeed);
+    return need > UCHAR_MAX ? UCHAR_MAX : need;
+  }
+  case NODEKIND_UNARYOP:
+    return left->registers;
+  case NODEKIND_ARRAY: {
+    //a constant added onto the index is folded into the element's displacement
+    int bias;
+    TreeNode_t *index = splitIndex(left, &bias);
+    return index ? index->registers : 1;
+  }
+  default:
+    return 1;
+  }
 }
 
-static int writeTextSection(FILE *output, TreeNode_t *ast) {
-  BLANK_LINE;
-  SECTION_LINE(".text");
-  writeLine(output, true, MAIN_LABEL, NULL, NULL, 0);
-  generateStatement(output, ast);
+/*
+ * Number the nodes of an expression with the registers they need,
+ * operands before the operators using them. The operands of 'or' and
+ * 'and' are numbered when they are lowered to jumps.
+ */
+static int numberRegisters(TreeNode_t *root) {
+
+  size_t base = state->expStackTop;
+  if (pushExp(root, 0))
+    return -1;
+
+  while (state->expStackTop > base) {
+    ExpFrame_t *frame = &state->expStack[state->expStackTop - 1];
+    TreeNode_t *node = frame->node;
+
+    if (frame->stage++ == 0 && !isShortCircuit(node)) {
+      for (int i = 0; i < 2; i++) {
+        TreeNode_t *operand = TreeNode_getChild(node, i);
+        if (operand && pushExp(operand, 0)) {
+          state->expStackTop = base;
+          return -1;
+        }
+      }
+      continue;
+    }
+
+    state->expStackTop--;
+    node->registers = registersNeeded(node);
+  }
 
-  EXIT_PRGM;
   return 0;
 }
 
-int CodeGen_process(FILE *output, TreeNode_t *ast, SymTable_t *rodata) {
-  
-  //print the header for the assembly file
-  if (writeASMHeader(output)) {
-    fprintf(stderr, "Error writing ASM File header\n");
-    return -1;
+//a 'not' on a value in a register: 1 if it is 0, 0 otherwise
+static void notRegister(FILE *output, TreeNode_t *node, int reg) {
+
+  if (!TreeNode_hasType(node, NOT))
+    return;
+
+  //negating sets the carry for anything but 0
+  writeLine(output, true, NULL, "neg", makeComment(LOG_NEG, SLOT_NAME(reg)), 1, SLOT_NAME(reg));
+  ASM_LINE("sbb", 2, SLOT_NAME(reg), SLOT_NAME(reg));
+  ASM_LINE("inc", 1, SLOT_NAME(reg));
+}
+
+//set a register from the flags of a comparison
+static void setRegister(FILE *output, TreeNode_t *node, int reg) {
+
+  bool negate = TreeNode_hasType(node, NOT);
+  char instruction[WRITE_INST_WIDTH];
+  CLEAR_REGISTER(SLOT_NAME(reg));
+
+  if (REGISTER_BYTES[state->registerPool[reg]]) {
+    snprintf(instruction, WRITE_INST_WIDTH, "set%s", relopCondition(node, negate));
+    ASM_LINE(instruction, 1, REGISTER_BYTES[state->registerPool[reg]]);
+    return;
   }
-  
-  if (writeReadOnlyData(output, rodata)) {
-    fprintf(stderr, "Error writing read only data section\n");
-    return -1;
+
+  //no byte to set, jump past setting the whole register instead
+  char skipLabel[COMMENT_BUF_LEN];
+  MAKE_LABEL(skipLabel, COMMENT_BUF_LEN);
+  snprintf(instruction, WRITE_INST_WIDTH, "j%s", relopCondition(node, !negate));
+  ASM_LINE(instruction, 1, skipLabel);
+  ASM_LINE("inc", 1, SLOT_NAME(reg));
+  writeLine(output, true, skipLabel, NULL, NULL, 0);
+}
+
+/*
+ * Divide the register by 'divisor'. idiv only divides eax (sign
+ * extended into edx), so unless that is already the register, eax
+ * and edx are saved around the division when they are in use.
+ */
+static void divideRegister(FILE *output, TreeNode_t *node, int reg, RegOperand_t *divisor) {
+
+  int result = TreeNode_getToken(node)->type == TOK_KEY_MOD ? REG_INDEX_EDX : REG_INDEX_EAX;
+  RegOperand_t operand = *divisor;
+  char text[COMMENT_BUF_LEN];
+
+  if (state->registerPool[reg] == REG_INDEX_EAX) {
+    operandText(&operand, text, COMMENT_BUF_LEN);
+    ASM_LINE("cdq", 0);
+    ASM_LINE("idiv", 1, text);
+    if (result != state->registerPool[reg])
+      ASM_LINE("mov", 2, SLOT_NAME(reg), REGISTERS[result]);
+    return;
   }
-  
-  if (writeTextSection(output, ast)) {
-    fprintf(stderr, "Error generating ASM Text section\n");
-    return -1;
+
+  //move a divisor out of the way of the dividend
+  bool moved = operand.kind == OPERAND_REG &&
+    (operand.value == REG_INDEX_EAX || operand.value == REG_INDEX_EDX);
+  if (moved) {
+    STORE_RESULT(REGISTERS[operand.value]);
+    operand = (RegOperand_t) { .kind = OPERAND_STACK };
+  }
+
+  bool saveEdx = registerSlot(REG_INDEX_EDX) < reg;
+  STORE_RESULT(REGISTERS[REG_INDEX_EAX]);
+  operand.depth++;
+  if (saveEdx) {
+    STORE_RESULT(REGISTERS[REG_INDEX_EDX]);
+    operand.depth++;
+  }
+
+  operandText(&operand, text, COMMENT_BUF_LEN);
+  ASM_LINE("mov", 2, REGISTERS[REG_INDEX_EAX], SLOT_NAME(reg));
+  ASM_LINE("cdq", 0);
+  ASM_LINE("idiv", 1, text);
+  if (result != state->registerPool[reg])
+    ASM_LINE("mov", 2, SLOT_NAME(reg), REGISTERS[result]);
+
+  if (saveEdx)
+    RESTORE_RESULT(REGISTERS[REG_INDEX_EDX]);
+  RESTORE_RESULT(REGISTERS[REG_INDEX_EAX]);
+  if (moved)
+    ASM_LINE("lea", 2, REG_STACKPTR, "["REG_STACKPTR"+"WORD_SIZE_BYTES_STR"]");
+}
+
+/*
+ * Shift the register by 'count', which has to be in cl unless it is
+ * a constant. ecx is saved around the shift if it is in use.
+ */
+static void shiftRegister(FILE *output, TreeNode_t *node, int reg, RegOperand_t *count) {
+
+  char *instruction = TreeNode_getToken(node)->type == TOK_KEY_SHL ? "sal" : "sar";
+  RegOperand_t operand = *count;
+  char text[COMMENT_BUF_LEN];
+
+  if (operand.kind == OPERAND_IMM || (operand.kind == OPERAND_REG && operand.value == REG_INDEX_ECX)) {
+    operandText(&operand, text, COMMENT_BUF_LEN);
+    ASM_LINE(instruction, 2, SLOT_NAME(reg), operand.kind == OPERAND_IMM ? text : REG_SHIFT);
+    return;
+  }
+
+  if (state->registerPool[reg] == REG_INDEX_ECX) {
+    //shift the value in the next register, which is free, instead
+    const char *value = SLOT_NAME(reg + 1);
+    if (operand.kind == OPERAND_REG && operand.value == state->registerPool[reg + 1])
+      ASM_LINE("xchg", 2, SLOT_NAME(reg), value);
+    else {
+      operandText(&operand, text, COMMENT_BUF_LEN);
+      ASM_LINE("mov", 2, value, SLOT_NAME(reg));
+      ASM_LINE("mov", 2, SLOT_NAME(reg), text);
+    }
+    ASM_LINE(instruction, 2, value, REG_SHIFT);
+    ASM_LINE("mov", 2, SLOT_NAME(reg), value);
+    return;
+  }
+
+  bool saveEcx = registerSlot(REG_INDEX_ECX) < reg;
+  if (saveEcx) {
+    STORE_RESULT(REGISTERS[REG_INDEX_ECX]);
+    operand.depth++;
+  }
+
+  operandText(&operand, text, COMMENT_BUF_LEN);
+  ASM_LINE("mov", 2, REGISTERS[REG_INDEX_ECX], text);
+  ASM_LINE(instruction, 2, SLOT_NAME(reg), REG_SHIFT);
+  if (saveEcx)
+    RESTORE_RESULT(REGISTERS[REG_INDEX_ECX]);
+}
+
+/*
+ * Apply a binary operator to its left operand, in the frame's register,
+ * and its right one. A comparison only sets the flags if the frame
+ * is jumped on.
+ */
+static int operateRegister(FILE *output, ExpFrame_t *frame, RegOperand_t *right) {
+
+  TreeNode_t *node = frame->node;
+  const char *reg = SLOT_NAME(frame->reg);
+  char text[COMMENT_BUF_LEN];
+  operandText(right, text, COMMENT_BUF_LEN);
+
+  switch (TreeNode_getToken(node)->type) {
+  case TOK_PLUS:
+    ASM_LINE("add", 2, reg, text);
+    break;
+  case TOK_MINUS:
+    ASM_LINE("sub", 2, reg, text);
+    break;
+  case TOK_STAR:
+    ASM_LINE("imul", 2, reg, text);
+    break;
+  case TOK_KEY_DIV:
+  case TOK_KEY_MOD:
+    divideRegister(output, node, frame->reg, right);
+    break;
+  case TOK_KEY_SHL:
+  case TOK_KEY_SHR:
+    shiftRegister(output, node, frame->reg, right);
+    break;
+  default:
+    if (!relopCondition(node, false)) {
+      fprintf(stderr, "Missing operator?\n");
+      return -1;
+    }
+    ASM_LINE("cmp", 2, reg, text);
+    break;
+  }
+
+  //lea leaves the flags of a comparison alone
+  if (right->kind == OPERAND_STACK)
+    ASM_LINE("lea", 2, REG_STACKPTR, "["REG_STACKPTR"+"WORD_SIZE_BYTES_STR"]");
+
+  if (node->kind != NODEKIND_RELOP)
+    notRegister(output, node, frame->reg);
+  else if (!frame->flagsOnly)
+    setRegister(output, node, frame->reg);
+  return 0;
+}
+
+//an 'or' or 'and' is lowered to jumps, which use every register
+static int booleanRegister(FILE *output, TreeNode_t *node, int reg) {
+
+  for (int i = 0; i < reg; i++)
+    STORE_RESULT(SLOT_NAME(i));
+
+  if (generateBoolean(output, node))
+    return -1;
+
+  if (state->registerPool[reg] != REG_INDEX_EAX)
+    ASM_LINE("mov", 2, SLOT_NAME(reg), REG_RETURN);
+  for (int i = reg - 1; i >= 0; i--)
+    RESTORE_RESULT(SLOT_NAME(i));
+  return 0;
+}
+
+/*
+ * Like the stages above, with the operand's register returned in 'reg'.
+ */
+typedef int (*RegStage_t)(FILE *output, ExpFrame_t *frame, TreeNode_t **operand, int *reg);
+
+static int regBinary(FILE *output, ExpFrame_t *frame, TreeNode_t **operand, int *reg) {
+
+  TreeNode_t *node = frame->node,
+    *left = TreeNode_getChild(node, 0),
+    *right = TreeNode_getChild(node, 1);
+  int type = TreeNode_getToken(node)->type;
+  int stage = frame->stage++;
+
+  if (isShortCircuit(node))
+    return booleanRegister(output, node, frame->reg);
+
+  if (stage == 0) {
+    int available = state->poolSize - frame->reg;
+    if (directOperand(right, type, NULL))
+      frame->order = OPERANDS_DIRECT;
+    else if (commutes(type) && directOperand(left, type, NULL))
+      frame->order = OPERANDS_SWAPPED;
+    else if (left->registers >= right->registers && right->registers < available)
+      frame->order = OPERANDS_LEFT;
+    else if (left->registers < right->registers && left->registers < available)
+      frame->order = OPERANDS_RIGHT;
+    else
+      frame->order = OPERANDS_SPILL;
+
+    *operand = frame->order == OPERANDS_DIRECT || frame->order == OPERANDS_LEFT ? left : right;
+    *reg = frame->reg;
+    return 0;
+  }
+
+  bool direct = frame->order == OPERANDS_DIRECT || frame->order == OPERANDS_SWAPPED;
+  if (stage == 1 && !direct) {
+    if (frame->order == OPERANDS_SPILL) {
+      writeLine(output, true, NULL, "push", makeComment(SPILL_OPERAND), 1, SLOT_NAME(frame->reg));
+      *operand = left;
+      *reg = frame->reg;
+    } else {
+      *operand = frame->order == OPERANDS_LEFT ? right : left;
+      *reg = frame->reg + 1;
+    }
+    return 0;
+  }
+
+  RegOperand_t rightOperand = {
+    .kind = OPERAND_REG,
+    .value = state->registerPool[frame->reg + 1],
+  };
+
+  switch (frame->order) {
+  case OPERANDS_DIRECT:
+    directOperand(right, type, &rightOperand);
+    break;
+  case OPERANDS_SWAPPED:
+    directOperand(left, type, &rightOperand);
+    break;
+  case OPERANDS_RIGHT:
+    //put the operands back in order, unless it makes no difference
+    if (!commutes(type))
+      ASM_LINE("xchg", 2, SLOT_NAME(frame->reg), SLOT_NAME(frame->reg + 1));
+    break;
+  case OPERANDS_SPILL:
+    rightOperand = (RegOperand_t) { .kind = OPERAND_STACK };
+    break;
+  default:
+    break;
+  }
+
+  return operateRegister(output, frame, &rightOperand);
+}
+
+static int regUnary(FILE *output, ExpFrame_t *frame, TreeNode_t **operand, int *reg) {
+
+  if (frame->stage++ == 0) {
+    *operand = TreeNode_getChild(frame->node, 0);
+    *reg = frame->reg;
+    return 0;
+  }
+
+  if (TreeNode_getToken(frame->node)->type == TOK_MINUS)
+    writeLine(output, true, NULL, "neg", makeComment(UNARY_MINUS), 1, SLOT_NAME(frame->reg));
+
+  notRegister(output, frame->node, frame->reg);
+  return 0;
+}
+
+static int regArray(FILE *output, ExpFrame_t *frame, TreeNode_t **operand, int *reg) {
+
+  Symbol_t *entry = TreeNode_getSymbolRef(frame->node);
+  int bias;
+  TreeNode_t *index = splitIndex(TreeNode_getChild(frame->node, 0), &bias);
+  RegOperand_t element;
+
+  //an index that has to be evaluated is scaled from the register it is in
+  if (!elementOperand(frame->node, &element)) {
+    if (frame->stage++ == 0) {
+      *operand = index;
+      *reg = frame->reg;
+      return 0;
+    }
+
+    element = (RegOperand_t) {
+      .kind = OPERAND_ELEMENT,
+      .value = SymTable_elementOffset(state->currentScope, entry, bias),
+      .index = state->registerPool[frame->reg],
+    };
+  }
+
+  char text[COMMENT_BUF_LEN];
+  operandText(&element, text, COMMENT_BUF_LEN);
+  writeLine(output, true, NULL, "mov", makeComment(ARRAY_INDEX, entry->key), 2, SLOT_NAME(frame->reg), text);
+  notRegister(output, frame->node, frame->reg);
+  return 0;
+}
+
+static int regLeaf(FILE *output, ExpFrame_t *frame, TreeNode_t **operand, int *reg) {
+
+  TreeNode_t *node = frame->node;
+  Symbol_t *entry = TreeNode_getSymbolRef(node);
+  char value[COMMENT_BUF_LEN];
+
+  if (node->kind == NODEKIND_VARIABLE) {
+    if (loopRegister(entry) >= 0)
+      snprintf(value, COMMENT_BUF_LEN, "%s", REGISTERS[loopRegister(entry)]);
+    else
+      snprintf(value, COMMENT_BUF_LEN, "DWORD "STACK_VAR_FMT, SymTable_frameOffset(state->currentScope, entry));
+    writeLine(output, true, NULL, "mov", makeComment(LOAD_VAR, entry->key), 2, SLOT_NAME(frame->reg), value);
+  } else {
+    if (!entry)
+      snprintf(value, COMMENT_BUF_LEN, "%d", TreeNode_getToken(node)->lexeme.value);
+    else if (Symbol_hasType(entry, SYMTYPE_INT))
+      snprintf(value, COMMENT_BUF_LEN, "%d", entry->data.value);
+    else
+      snprintf(value, COMMENT_BUF_LEN, "%s", entry->key);
+    ASM_LINE("mov", 2, SLOT_NAME(frame->reg), value);
+  }
+
+  notRegister(output, node, frame->reg);
+  return 0;
+}
+
+static const RegStage_t REG_STAGES[NODEKIND_COUNT] = {
+  [NODEKIND_RELOP] = regBinary,
+  [NODEKIND_BINOP] = regBinary,
+  [NODEKIND_MULOP] = regBinary,
+  [NODEKIND_UNARYOP] = regUnary,
+  [NODEKIND_ARRAY] = regArray,
+  [NODEKIND_VARIABLE] = regLeaf,
+  [NODEKIND_CONSTANT] = regLeaf,
+};
+
+/*
+ * Evaluate a numbered expression into SLOT_NAME(reg). A comparison
+ * at its root only sets the flags if 'flagsOnly' is set.
+ */
+static int evaluateRegisters(FILE *output, TreeNode_t *node, int reg, bool flagsOnly) {
+
+  size_t base = state->expStackTop;
+  if (pushExp(node, reg))
+    return -1;
+  state->expStack[base].flagsOnly = flagsOnly;
+
+  while (state->expStackTop > base) {
+    TreeNode_t *operand = NULL;
+    int operandReg = 0;
+
+    ExpFrame_t *frame = &state->expStack[state->expStackTop - 1];
+    RegStage_t stage = REG_STAGES[frame->node->kind];
+    if (stage && stage(output, frame, &operand, &operandReg)) {
+      state->expStackTop = base;
+      return -1;
+    }
+
+    if (!operand)
+      state->expStackTop--;
+    else if (pushExp(operand, operandReg)) {
+      state->expStackTop = base;
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+static int generateRegExp(FILE *output, TreeNode_t *node, int reg, bool flagsOnly) {
+
+  if (numberRegisters(node))
+    return -1;
+
+  return evaluateRegisters(output, node, reg, flagsOnly);
+}
+
+//the address of a variable being read into REG_VARADDR
+static int generateRegAddress(FILE *output, TreeNode_t *node) {
+
+  char address[COMMENT_BUF_LEN];
+  RegOperand_t element = {
+    .kind = OPERAND_MEM,
+    .value = SymTable_frameOffset(state->currentScope, TreeNode_getSymbolRef(node)),
+  };
+
+  if (node->kind == NODEKIND_ARRAY && !elementOperand(node, &element)) {
+    int bias;
+    TreeNode_t *index = splitIndex(TreeNode_getChild(node, 0), &bias);
+    if (generateRegExp(output, index, REG_INDEX_EAX, false))
+      return -1;
+
+    element = (RegOperand_t) {
+      .kind = OPERAND_ELEMENT,
+      .value = SymTable_elementOffset(state->currentScope, TreeNode_getSymbolRef(node), bias),
+      .index = REG_INDEX_EAX,
+    };
+  }
+
+  addressText(&element, address, COMMENT_BUF_LEN);
+  ASM_LINE("lea", 2, REG_VARADDR, address);
+  return 0;
+}
+
+//whether an expression uses a variable, -1 on error
+static int usesVariable(TreeNode_t *node, Symbol_t *entry) {
+
+  size_t base = state->expStackTop;
+  if (pushExp(node, 0))
+    return -1;
+
+  while (state->expStackTop > base) {
+    TreeNode_t *cur = state->expStack[--state->expStackTop].node;
+    if (cur->kind == NODEKIND_VARIABLE && TreeNode_getSymbolRef(cur) == entry) {
+      state->expStackTop = base;
+      return 1;
+    }
+
+    for (int i = 0; i < 2; i++) {
+      TreeNode_t *operand = TreeNode_getChild(cur, i);
+      if (operand && pushExp(operand, 0)) {
+        state->expStackTop = base;
+        return -1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * Keep the variable indexing the array element assigned to in a free
+ * loop register while the value is evaluated, if the value uses it
+ * too, as in a(i) := a(i) + 1. Returns the mask of the loop register
+ * taken, to be freed with releaseLoop, or -1 on error.
+ */
+static int keepIndex(FILE *output, TreeNode_t *left, TreeNode_t *right) {
+
+  int bias;
+  TreeNode_t *index = left->kind == NODEKIND_ARRAY ? splitIndex(TreeNode_getChild(left, 0), &bias) : NULL;
+  if (!index || index->kind != NODEKIND_VARIABLE || TreeNode_hasType(index, NOT))
+    return 0;
+
+  Symbol_t *entry = TreeNode_getSymbolRef(index);
+  int slot = 0;
+  while (slot < LOOP_REGISTER_COUNT && state->loopVars[slot])
+    slot++;
+  if (slot == LOOP_REGISTER_COUNT || !loopCandidate(entry))
+    return 0;
+
+  int used = usesVariable(right, entry);
+  if (used <= 0)
+    return used;
+
+  char address[COMMENT_BUF_LEN];
+  snprintf(address, COMMENT_BUF_LEN, "DWORD "STACK_VAR_FMT, SymTable_frameOffset(state->currentScope, entry));
+  writeLine(output, true, NULL, "mov", makeComment(KEEP_INDEX, entry->key), 2, REGISTERS[LOOP_REGISTERS[slot]], address);
+
+  state->loopVars[slot] = entry;
+  state->loopWrites[slot] = false;
+  fillRegisterPool();
+  return 1 << slot;
+}
+
+/*
+ * Store the value of an assignment straight into its variable, an
+ * array's index is evaluated after the value, into the next register.
+ */
+static int generateRegAssign(FILE *output, TreeNode_t *node) {
+
+  TreeNode_t *left = TreeNode_getChild(node, 0),
+    *right = TreeNode_getChild(node, 1);
+  Symbol_t *entry = TreeNode_getSymbolRef(left);
+  char address[COMMENT_BUF_LEN];
+  RegOperand_t element = {
+    .kind = OPERAND_MEM,
+    .value = SymTable_frameOffset(state->currentScope, entry),
+  };
+
+  int kept = keepIndex(output, left, right);
+  if (kept < 0 || generateRegExp(output, right, REG_INDEX_EAX, false))
+    return -1;
+
+  if (loopRegister(entry) >= 0)
+    snprintf(address, COMMENT_BUF_LEN, "%s", REGISTERS[loopRegister(entry)]);
+  else if (left->kind != NODEKIND_ARRAY || elementOperand(left, &element))
+    addressText(&element, address, COMMENT_BUF_LEN);
+  else {
+    int bias;
+    TreeNode_t *index = splitIndex(TreeNode_getChild(left, 0), &bias);
+    if (numberRegisters(index))
+      return -1;
+
+    //the index is evaluated into the register after the value's
+    bool spill = index->registers >= state->poolSize;
+    if (spill)
+      writeLine(output, true, NULL, "push", makeComment(SPILL_OPERAND), 1, REG_RETURN);
+    if (evaluateRegisters(output, index, spill ? REG_INDEX_EAX : REG_INDEX_EAX + 1, false))
+      return -1;
+    if (spill) {
+      ASM_LINE("mov", 2, SLOT_NAME(1), REG_RETURN);
+      RESTORE_RESULT(REG_RETURN);
+    }
+
+    element = (RegOperand_t) {
+      .kind = OPERAND_ELEMENT,
+      .value = SymTable_elementOffset(state->currentScope, entry, bias),
+      .index = state->registerPool[1],
+    };
+    addressText(&element, address, COMMENT_BUF_LEN);
+  }
+
+  writeLine(output, true, NULL, "mov", makeComment(ASSIGN_TO, entry->key), 2, address, REG_RETURN);
+  releaseLoop(output, kept);
+  return 0;
+}
+
+/*
+ * Variables are kept in the loop registers over whole loops, their
+ * live ranges, which nest like the loops do. A loop's variables are
+ * weighed by how often they are used in it, uses in nested loops
+ * counting LOOP_WEIGHT times as much, and the heaviest take whichever
+ * loop registers the loops around it left free. Calls to read and
+ * write leave them alone, they are saved by the callee.
+ */
+#define LOOP_WEIGHT 8
+#define LOOP_WEIGHT_MAX (1 << 20)
+//uses a variable needs in a loop to be worth a register
+#define LOOP_USES_MIN 2
+//initial number of variables a loop's uses are counted for
+#define LOOP_USES_BASE_SIZE 16
+
+typedef struct LoopUse_s {
+  Symbol_t *symbol;
+  long uses;
+  bool written;
+} LoopUse_t;
+
+//a scalar variable of the loop's scope, or a scope around it
+static bool loopCandidate(Symbol_t *entry) {
+
+  return entry && Symbol_hasType(entry, SYMTYPE_VARIABLE) && Symbol_hasType(entry, SYMTYPE_INT) &&
+    !Symbol_hasType(entry, SYMTYPE_ARRAY) && entry->frameBase <= state->currentScope->frameBase &&
+    loopRegister(entry) < 0;
+}
+
+//count a use of a variable, NULL if the counts couldn't grow
+static LoopUse_t *countLoopUse(LoopUse_t **uses, size_t *count, size_t *size, Symbol_t *entry, long weight) {
+
+  size_t i = 0;
+  while (i < *count && (*uses)[i].symbol != entry)
+    i++;
+
+  if (i == *count) {
+    if (*count == *size) {
+      size_t grown = *size ? *size << 1 : LOOP_USES_BASE_SIZE;
+      LoopUse_t *counts = realloc(*uses, grown * sizeof(LoopUse_t));
+      if (!counts) {
+        fprintf(stderr, "Error growing loop variable counts\n");
+        return NULL;
+      }
+      *uses = counts;
+      *size = grown;
+    }
+    (*uses)[(*count)++] = (LoopUse_t) { .symbol = entry };
+  }
+
+  (*uses)[i].uses += weight;
+  return &(*uses)[i];
+}
+
+/*
+ * Count the uses of the variables in a loop, walking it with the
+ * expression stack, each frame's 'reg' holding the weight of its uses.
+ */
+static int countLoopUses(TreeNode_t *node, LoopUse_t **uses, size_t *count, size_t *size) {
+
+  size_t base = state->expStackTop;
+  if (pushExp(node, 1))
+    return -1;
+
+  while (state->expStackTop > base) {
+    ExpFrame_t frame = state->expStack[--state->expStackTop];
+    TreeNode_t *cur = frame.node;
+    int weight = frame.reg;
+
+    Symbol_t *entry = TreeNode_getSymbolRef(cur);
+    if (cur->kind == NODEKIND_VARIABLE && loopCandidate(entry) &&
+        !countLoopUse(uses, count, size, entry, weight)) {
+      state->expStackTop = base;
+      return -1;
+    }
+
+    //variables assigned or read into have to be stored back,
+    //their uses are counted when the targets themselves are reached
+    TreeNode_t *target = NULL;
+    if (cur->kind == NODEKIND_ASSIGN_STMT || cur->kind == NODEKIND_READ_STMT)
+      target = TreeNode_getChild(cur, 0);
+    for (; target; target = cur->kind == NODEKIND_READ_STMT ? TreeNode_getSibling(target) : NULL) {
+      Symbol_t *written = TreeNode_getSymbolRef(target);
+      if (target->kind != NODEKIND_VARIABLE || !loopCandidate(written))
+        continue;
+
+      LoopUse_t *use = countLoopUse(uses, count, size, written, 0);
+      if (!use) {
+        state->expStackTop = base;
+        return -1;
+      }
+      use->written = true;
+    }
+
+    if (cur->kind == NODEKIND_WHILE_STMT && cur != node && weight < LOOP_WEIGHT_MAX)
+      weight *= LOOP_WEIGHT;
+
+    //a block's declarations hold no uses
+    int first = cur->kind == NODEKIND_BLOCK_STMT ? 2 : 0;
+    for (int i = first; i < TREENODE_CHILD_MAX; i++) {
+      for (TreeNode_t *child = TreeNode_getChild(cur, i); child; child = TreeNode_getSibling(child)) {
+        if (pushExp(child, weight)) {
+          state->expStackTop = base;
+          return -1;
+        }
+      }
+    }
+  }
+
+  return 0;
+}
+
+//order loop variables by most uses first
+static int compareLoopUses(const void *a, const void *b) {
+
+  long left = ((const LoopUse_t *)a)->uses,
+    right = ((const LoopUse_t *)b)->uses;
+  return (left < right) - (left > right);
+}
+
+/*
+ * Load the most used variables of a while loop into the loop
+ * registers left free, before the loop is entered. Returns a mask
+ * of the loop registers taken, for releaseLoop. -1 on error.
+ */
+static int allocateLoop(FILE *output, TreeNode_t *node) {
+
+  int available = 0;
+  for (int i = 0; i < LOOP_REGISTER_COUNT; i++)
+    available += !state->loopVars[i];
+  if (!available)
+    return 0;
+
+  LoopUse_t *uses = NULL;
+  size_t count = 0, size = 0;
+  if (countLoopUses(node, &uses, &count, &size)) {
+    free(uses);
+    return -1;
+  }
+  qsort(uses, count, sizeof(LoopUse_t), compareLoopUses);
+
+  int kept = 0;
+  size_t next = 0;
+  for (int i = 0; i < LOOP_REGISTER_COUNT && next < count; i++) {
+    if (state->loopVars[i] || uses[next].uses < LOOP_USES_MIN)
+      continue;
+
+    Symbol_t *entry = uses[next].symbol;
+    char address[COMMENT_BUF_LEN];
+    snprintf(address, COMMENT_BUF_LEN, "DWORD "STACK_VAR_FMT, SymTable_frameOffset(state->currentScope, entry));
+    writeLine(output, true, NULL, "mov", makeComment(KEEP_VAR, entry->key), 2, REGISTERS[LOOP_REGISTERS[i]], address);
+
+    state->loopVars[i] = entry;
+    state->loopWrites[i] = uses[next++].written;
+    kept |= 1 << i;
+  }
+
+  free(uses);
+  fillRegisterPool();
+  return kept;
+}
+
+//store back the variables a loop kept that it changed, freeing their registers
+static void releaseLoop(FILE *output, int kept) {
+
+  if (!kept)
+    return;
+
+  for (int i = 0; i < LOOP_REGISTER_COUNT; i++) {
+    if (!(kept & (1 << i)))
+      continue;
+
+    Symbol_t *entry = state->loopVars[i];
+    if (state->loopWrites[i]) {
+      char address[COMMENT_BUF_LEN];
+      snprintf(address, COMMENT_BUF_LEN, "DWORD "STACK_VAR_FMT, SymTable_frameOffset(state->currentScope, entry));
+      writeLine(output, true, NULL, "mov", makeComment(STORE_VAR, entry->key), 2, address, REGISTERS[LOOP_REGISTERS[i]]);
+    }
+
+    state->loopVars[i] = NULL;
+    state->loopWrites[i] = false;
+  }
+
+  fillRegisterPool();
+}
+
+//reload a variable kept through a loop after it has been read into memory
+static void reloadLoopVar(FILE *output, TreeNode_t *node) {
+
+  Symbol_t *entry = TreeNode_getSymbolRef(node);
+  if (node->kind != NODEKIND_VARIABLE || loopRegister(entry) < 0)
+    return;
+
+  char address[COMMENT_BUF_LEN];
+  snprintf(address, COMMENT_BUF_LEN, "DWORD "STACK_VAR_FMT, SymTable_frameOffset(state->currentScope, entry));
+  writeLine(output, true, NULL, "mov", makeComment(LOAD_VAR, entry->key), 2, REGISTERS[loopRegister(entry)], address);
+}
+
+int generateExp(FILE *output, TreeNode_t *node) {
+
+  if (state->optimize)
+    return generateRegExp(output, node, REG_INDEX_EAX, false);
+
+  size_t base = state->expStackTop;
+  if (pushExp(node, 0))
+    return -1;
+
+  while (state->expStackTop > base) {
+    TreeNode_t *operand = NULL;
+
+    ExpFrame_t *frame = &state->expStack[state->expStackTop - 1];
+    ExpStage_t stage = EXP_STAGES[frame->node->kind];
+    if (stage && stage(output, frame, &operand)) {
+      state->expStackTop = base;
+      return -1;
+    }
+
+    //no more operands to evaluate, the node is done
+    if (!operand)
+      state->expStackTop--;
+    else if (pushExp(operand, 0)) {
+      state->expStackTop = base;
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * Push a condition to jump on onto the condition stack, or a label
+ * to place if 'node' is NULL.
+ */
+static int pushCond(TreeNode_t *node, bool sense, int label) {
+
+  if (state->condStackTop == state->condStackSize) {
+    size_t size = state->condStackSize ? state->condStackSize << 1 : COND_STACK_BASE_SIZE;
+    CondFrame_t *stack = realloc(state->condStack, size * sizeof(CondFrame_t));
+    if (!stack) {
+      fprintf(stderr, "Error growing condition stack\n");
+      return -1;
+    }
+    state->condStack = stack;
+    state->condStackSize = size;
+  }
+
+  state->condStack[state->condStackTop++] = (CondFrame_t) {
+    .node = node,
+    .sense = sense,
+    .label = label,
+  };
+  return 0;
+}
+
+/*
+ * Jump on a comparison straight from the flags it sets, rather than
+ * setting a Boolean to test.
+ */
+static int jumpRelop(FILE *output, TreeNode_t *node, bool sense, char *target) {
+
+  const char *condition = relopCondition(node, !sense);
+  if (!condition) {
+    COMMENT_LINE(makeComment(NO_OPERATOR, TreeNode_getToken(node)->type));
+    return 0;
+  }
+
+  if (state->optimize) {
+    if (generateRegExp(output, node, REG_INDEX_EAX, true))
+      return -1;
+  } else {
+    if (generateExp(output, TreeNode_getChild(node, 0)))
+      return -1;
+    STORE_RESULT(REG_RETURN);
+    if (generateExp(output, TreeNode_getChild(node, 1)))
+      return -1;
+    compareOperands(output);
+  }
+
+  char instruction[WRITE_INST_WIDTH];
+  snprintf(instruction, WRITE_INST_WIDTH, "j%s", condition);
+  ASM_LINE(instruction, 1, target);
+  return 0;
+}
+
+/*
+ * Lower a condition to jumps: jump to label number 'label' if the
+ * condition is 'sense', fall through to the code after it otherwise.
+ *
+ * Comparisons jump on their flags. The left operand of an 'or' that is
+ * true (or of an 'and' that is false) decides the whole condition, so
+ * it jumps past the right operand when that isn't the outcome being
+ * jumped on. A 'not' on any of them swaps the outcome. Every other
+ * expression is evaluated, and its value tested.
+ */
+static int generateCondition(FILE *output, TreeNode_t *node, bool sense, int label) {
+
+  size_t base = state->condStackTop;
+  if (pushCond(node, sense, label))
+    return -1;
+
+  while (state->condStackTop > base) {
+    //generating a frame can push others, so it is copied off first
+    CondFrame_t frame = state->condStack[--state->condStackTop];
+    char target[COMMENT_BUF_LEN];
+    makeLabelEx(LABEL_FMT, target, COMMENT_BUF_LEN, frame.label);
+
+    int status = 0;
+    if (!frame.node)
+      writeLine(output, true, target, NULL, makeComment(frame.sense ? SHORTED_OR : SHORTED_AND), 0);
+    else if (isShortCircuit(frame.node)) {
+      bool isOr = TreeNode_getToken(frame.node)->type == TOK_KEY_OR;
+      bool outcome = frame.sense != TreeNode_hasType(frame.node, NOT);
+      TreeNode_t *left = TreeNode_getChild(frame.node, 0),
+        *right = TreeNode_getChild(frame.node, 1);
+
+      //pushed in reverse, the left operand goes first
+      if (outcome == isOr)
+        status = pushCond(right, outcome, frame.label) || pushCond(left, outcome, frame.label);
+      else {
+        char shortLabel[COMMENT_BUF_LEN];
+        int shorted = MAKE_LABEL(shortLabel, COMMENT_BUF_LEN);
+        status = pushCond(NULL, isOr, shorted) || pushCond(right, outcome, frame.label) ||
+          pushCond(left, isOr, shorted);
+      }
+    } else if (frame.node->kind == NODEKIND_RELOP)
+      status = jumpRelop(output, frame.node, frame.sense != TreeNode_hasType(frame.node, NOT), target);
+    else {
+      //only jump on a value that was evaluated
+      status = generateExp(output, frame.node);
+      if (!status) {
+        TEST_REGISTER(REG_RETURN);
+        ASM_LINE(frame.sense ? "jne" : "je", 1, target);
+      }
+    }
+
+    if (status) {
+      state->condStackTop = base;
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+
+//while in statement list, go through all statement siblings
+static int generateStmtList(FILE *output, TreeNode_t *node) {
+
+  TreeNode_t *stmts = TreeNode_getChild(node, 0);
+
+  do {
+    if (generateStatement(output, stmts))
+      return -1;
+
+    stmts = TreeNode_getSibling(stmts);
+  } while (stmts);
+
+  return 0;
+}
+
+static int (*const STMT_GENERATORS[NODEKIND_COUNT])(FILE *, TreeNode_t *) = {
+  [NODEKIND_STMT_LIST] = generateStmtList,
+  [NODEKIND_READ_STMT] = generateReadStmt,
+  [NODEKIND_WRITE_STMT] = generateWriteStmt,
+  [NODEKIND_CASE_STMT] = generateCaseStmt,
+  [NODEKIND_WHILE_STMT] = generateWhileStmt,
+  [NODEKIND_IF_STMT] = generateIfStmt,
+  [NODEKIND_ASSIGN_STMT] = generateAssignStmt,
+  [NODEKIND_BLOCK_STMT] = generateBlockStmt,
+};
+
+int generateStatement(FILE *output, TreeNode_t *node) {
+
+  //  TreeNode_printNode(stdout, node, false); 
+  if (!node) {
+    fprintf(stderr, "Null statement\n");
+    return 0;
+  }
+
+  //kinds of nodes that aren't statements generate nothing
+  int (*generate)(FILE *, TreeNode_t *) = STMT_GENERATORS[node->kind];
+  if (!generate)
+    return 0;
+
+  if (generate(output, node))
+    return -1;
+
+  //nothing an optimized statement leaves in registers is used after
+  //it, other than the variables kept through loops
+  if (state->optimize) {
+    const char *live[LOOP_REGISTER_COUNT];
+    int count = 0;
+    for (int i = 0; i < LOOP_REGISTER_COUNT; i++) {
+      if (state->loopVars[i])
+        live[count++] = REGISTERS[LOOP_REGISTERS[i]];
+    }
+    Peephole_boundary(&state->peephole, output, printPeepholeLine, live, count);
+  }
+  return 0;
+}
+
+
+/*
+ * A string of .rodata, and the string holding its bytes: its own, or
+ * one it is the tail of.
+ */
+typedef struct RodataString_s {
+  Symbol_t *symbol;
+  //contents of the string, without its quotes
+  const char *text;
+  size_t length;
+  //string holding the bytes, and where they start in it
+  struct RodataString_s *host;
+  size_t offset;
+} RodataString_t;
+
+//write a string's bytes, or where another string holds them
+static int writeStrConst(Symbol_t *symbol, void *data) {
+  
+  FILE *output = (FILE *)data;
+  if (symbol->rodata) {
+    writeLine(output, false, symbol->key, "equ", NULL, 0);
+    fprintf(output, "%s\n", symbol->rodata->key);
+    return 0;
+  }
+
+  writeLine(output, false, symbol->key, "db", NULL, 0);
+  //some strings can be much longer than what writeLine intends
+  //to handle on a general basis
+  fprintf(output, "%s,0\n", symbol->data.string);
+  //the quotes aren't written, the terminator is
+  state->rodataBytes += Intern_length(symbol->data.string) - 1;
+  return 0;
+}
+
+//order strings by their contents read backwards, so a string is
+//followed by the strings ending with it
+static int compareTails(const void *a, const void *b) {
+
+  const RodataString_t *left = *(RodataString_t * const *)a;
+  const RodataString_t *right = *(RodataString_t * const *)b;
+
+  const char *l = left->text + left->length, *r = right->text + right->length;
+  while (l > left->text && r > right->text) {
+    if (*--l != *--r)
+      return (unsigned char)*l - (unsigned char)*r;
+  }
+
+  return (l > left->text) - (r > right->text);
+}
+
+/*
+ * Find the strings of .rodata that are the tail of another string,
+ * so they can point into that string instead of being written out.
+ * A string that ends another ends the string sorted right after it,
+ * as all strings ending with it are sorted together.
+ */
+static void shareTails(RodataString_t *strings, RodataString_t **sorted, size_t count) {
+
+  for (size_t i = 0; i < count; i++) {
+    sorted[i] = &strings[i];
+    strings[i].host = &strings[i];
+  }
+  qsort(sorted, count, sizeof(RodataString_t *), compareTails);
+
+  //strings sorted later have found their hosts first
+  for (size_t i = count - 1; i > 0; i--) {
+    RodataString_t *tail = sorted[i - 1], *next = sorted[i];
+    if (tail->length <= next->length &&
+        !memcmp(tail->text, next->text + next->length - tail->length, tail->length)) {
+      tail->host = next->host;
+      tail->offset = next->offset + next->length - tail->length;
+    }
+  }
+}
+
+static int writeReadOnlyData(FILE *output, SymTable_t *rodata) {
+
+  BLANK_LINE;
+  SECTION_LINE(".rodata");
+
+  //entries sharing the string of an earlier one were given it when analyzed
+  size_t count = 0;
+  RodataString_t *strings = malloc((rodata->count + 1) * sizeof(RodataString_t));
+  RodataString_t **sorted = malloc((rodata->count + 1) * sizeof(RodataString_t *));
+  if (!strings || !sorted) {
+    fprintf(stderr, "Error allocating .rodata strings\n");
+    free(strings);
+    free(sorted);
+    return -1;
+  }
+
+  for (size_t i = 0; i < rodata->count; i++) {
+    Symbol_t *symbol = rodata->entries[i];
+    if (!symbol->rodata)
+      strings[count++] = (RodataString_t) {
+        .symbol = symbol,
+        .text = symbol->data.string + 1,
+        .length = Intern_length(symbol->data.string) - 2
+      };
+  }
+  if (count)
+    shareTails(strings, sorted, count);
+
+  //strings holding their own bytes, then the tails of those
+  for (size_t i = 0; i < count; i++) {
+    if (strings[i].host == &strings[i])
+      writeStrConst(strings[i].symbol, output);
+  }
+  for (size_t i = 0; i < count; i++) {
+    if (strings[i].host != &strings[i]) {
+      writeLine(output, false, strings[i].symbol->key, "equ", NULL, 0);
+      fprintf(output, "%s+%zu\n", strings[i].host->symbol->key, strings[i].offset);
+    }
+  }
+  for (size_t i = 0; i < rodata->count; i++) {
+    if (rodata->entries[i]->rodata)
+      writeStrConst(rodata->entries[i], output);
+  }
+
+  free(strings);
+  free(sorted);
+  return 0;
+}
+
+static int writeASMHeader(FILE *output) {
+  fprintf(output, FILE_HEADER);
+  COMMENT_LINE("io library definitions");
+  writeLine(output, true, NULL, "extern", NULL, 2, "read", "write");
+  COMMENT_LINE("define main function");
+  writeLine(output, true, NULL, "global", NULL, 1, MAIN_LABEL);
+  
+  return 0;
+}
+
+
+static void writeMainStart(FILE *output) {
+
+  writeLine(output, true, MAIN_LABEL, NULL, NULL, 0);
+  if (!state->optimize)
+    return;
+
+  for (int i = 0; i < SAVED_REGISTER_COUNT; i++)
+    STORE_RESULT(SAVED_REGISTERS[i]);
+}
+
+static void writeMainEnd(FILE *output) {
+
+  if (!state->optimize) {
+    EXIT_PRGM;
+    return;
+  }
+
+  writeLine(output, true, "exit", NULL, NULL, 0);
+  for (int i = SAVED_REGISTER_COUNT - 1; i >= 0; i--)
+    RESTORE_RESULT(SAVED_REGISTERS[i]);
+  CLEAR_REGISTER(REG_RETURN);
+  ASM_LINE("ret", 0);
+}
+
+static int writeTextSection(FILE *output, TreeNode_t *ast) {
+  BLANK_LINE;
+  SECTION_LINE(".text");
+  writeMainStart(output);
+  generateStatement(output, ast);
+
+  writeMainEnd(output);
+  Peephole_flush(&state->peephole, output, printPeepholeLine);
+  return 0;
+}
+
+//free what a code generation pass grew as it went
+static void freeState(CodeGenState_t *gen) {
+
+  free(gen->expStack);
+  gen->expStack = NULL;
+  gen->expStackSize = gen->expStackTop = 0;
+
+  free(gen->condStack);
+  gen->condStack = NULL;
+  gen->condStackSize = gen->condStackTop = 0;
+
+  free(gen->frames);
+  gen->frames = NULL;
+  gen->frameSize = gen->frameTop = 0;
+}
+
+int CodeGen_process(CodeGenState_t *gen, FILE *output, TreeNode_t *ast, SymTable_t *rodata) {
+
+  int optimize = gen->optimize;
+  memset(gen, 0, sizeof(CodeGenState_t));
+  gen->optimize = optimize;
+  state = gen;
+  fillRegisterPool();
+  int status = 0;
+  
+  //print the header for the assembly file
+  if (writeASMHeader(output)) {
+    fprintf(stderr, "Error writing ASM File header\n");
+    status = -1;
+  }
+  
+  else if (writeReadOnlyData(output, rodata)) {
+    fprintf(stderr, "Error writing read only data section\n");
+    status = -1;
+  }
+  
+  else if (writeTextSection(output, ast)) {
+    fprintf(stderr, "Error generating ASM Text section\n");
+    status = -1;
+  }
+
+  freeState(gen);
+  state = NULL;
+  return status;
+}
+
+
+/*
+ * Streaming: a statement holding other statements is generated one
+ * part at a time, with a frame on the stream stack from its start to
+ * its end to remember its labels.
+ */
+
+static StreamFrame_t *pushFrame(int label) {
+
+  if (state->frameTop == state->frameSize) {
+    size_t size = state->frameSize ? state->frameSize << 1 : STREAM_STACK_BASE_SIZE;
+    StreamFrame_t *frames = realloc(state->frames, size * sizeof(StreamFrame_t));
+    if (!frames) {
+      fprintf(stderr, "Error growing stream stack\n");
+      return NULL;
+    }
+    state->frames = frames;
+    state->frameSize = size;
+  }
+
+  state->frames[state->frameTop] = (StreamFrame_t) {.label = label};
+  return &state->frames[state->frameTop++];
+}
+
+static StreamFrame_t *topFrame(void) {
+
+  if (!state->frameTop) {
+    fprintf(stderr, "Error: streamed statement was never started\n");
+    return NULL;
+  }
+
+  return &state->frames[state->frameTop - 1];
+}
+
+//write out the rodata first used by a streamed part of the program
+static int writeStreamedData(FILE *output, Symbol_t **rodata, size_t count) {
+
+  if (!count)
+    return 0;
+
+  SECTION_LINE(".rodata");
+  for (size_t i = 0; i < count; i++)
+    writeStrConst(rodata[i], output);
+  SECTION_LINE(".text");
+  return 0;
+}
+
+/*
+ * Start the next default case of a streamed case statement. A case
+ * can have several, only the last one is jumped to by its dispatch.
+ */
+static void streamCaseElse(FILE *output, StreamFrame_t *frame) {
+
+  int tableStart = frame->label;
+  char label[COMMENT_BUF_LEN];
+
+  //the default case before this one is skipped
+  if (frame->elses) {
+    CASE_TAGGED_LABEL(label, COMMENT_BUF_LEN, TABLE_TAG_END, 0);
+    ASM_LINE("jmp", 1, label);
+    CASE_TAGGED_LABEL(label, COMMENT_BUF_LEN, TABLE_TAG_DEF_FMT, frame->elses);
+  } else
+    CASE_TAGGED_LABEL(label, COMMENT_BUF_LEN, TABLE_TAG_DEF, 0);
+
+  writeLine(output, true, label, NULL, "Default Case", 0);
+  frame->elses++;
+}
+
+/*
+ * The cases of a streamed case statement are written before its
+ * values are all known, so its dispatch is written after them, and
+ * jumped to from the case's expression.
+ */
+static int streamCaseEnd(FILE *output, TreeNode_t *node, StreamFrame_t *frame) {
+
+  int tableStart = frame->label;
+  char defaultLabel[COMMENT_BUF_LEN],
+    endCase[COMMENT_BUF_LEN],
+    dispatch[COMMENT_BUF_LEN];
+
+  if (!frame->elses)
+    streamCaseElse(output, frame);
+
+  if (frame->elses > 1)
+    CASE_TAGGED_LABEL(defaultLabel, COMMENT_BUF_LEN, TABLE_TAG_DEF_FMT, frame->elses - 1);
+  else
+    CASE_TAGGED_LABEL(defaultLabel, COMMENT_BUF_LEN, TABLE_TAG_DEF, 0);
+  CASE_TAGGED_LABEL(endCase, COMMENT_BUF_LEN, TABLE_TAG_END, 0);
+  CASE_TAGGED_LABEL(dispatch, COMMENT_BUF_LEN, TABLE_TAG_DISPATCH, 0);
+
+  ASM_LINE("jmp", 1, endCase);
+  writeLine(output, true, dispatch, NULL, "Switch Dispatch", 0);
+  if (generateCaseDispatch(output, node, tableStart, defaultLabel))
+    return -1;
+
+  //close up the switch statement
+  writeLine(output, true, endCase, NULL, "End of switch", 0);
+  return 0;
+}
+
+static int streamEvent(FILE *output, StreamEvent event, TreeNode_t *node) {
+
+  StreamFrame_t *frame = NULL;
+  int label, tableStart;
+  char tempLabel[COMMENT_BUF_LEN];
+
+  switch (event) {
+  case STREAM_BLOCK:
+    generateBlockStart(output, TreeNode_getSymTable(node));
+    return 0;
+
+  case STREAM_BLOCK_END:
+    generateBlockEnd(output, TreeNode_getSymTable(node));
+    return 0;
+
+  case STREAM_STMT:
+    return generateStatement(output, node);
+
+  case STREAM_IF:
+    label = generateIfStart(output, node);
+    return label < 0 || !pushFrame(label) ? -1 : 0;
+
+  case STREAM_IF_ELSE:
+    if (!(frame = topFrame()))
+      return -1;
+    generateIfElse(output, frame->label);
+    frame->elses = 1;
+    return 0;
+
+  case STREAM_IF_END:
+    if (!(frame = topFrame()))
+      return -1;
+    if (!frame->elses)
+      generateIfElse(output, frame->label);
+    generateIfEnd(output, frame->label);
+    state->frameTop--;
+    return 0;
+
+  case STREAM_WHILE:
+    label = generateWhileStart(output, node);
+    return label < 0 || !pushFrame(label) ? -1 : 0;
+
+  case STREAM_WHILE_END:
+    if (!(frame = topFrame()))
+      return -1;
+    generateWhileEnd(output, frame->label);
+    state->frameTop--;
+    return 0;
+
+  case STREAM_CASE:
+    tableStart = generateCaseStart(output, node);
+    if (tableStart < 0 || !pushFrame(tableStart))
+      return -1;
+    CASE_TAGGED_LABEL(tempLabel, COMMENT_BUF_LEN, TABLE_TAG_DISPATCH, 0);
+    ASM_LINE("jmp", 1, tempLabel);
+    return 0;
+
+  case STREAM_CASE_ARM:
+    if (!(frame = topFrame()))
+      return -1;
+    generateCaseLabels(output, node, frame->label);
+    return 0;
+
+  case STREAM_CASE_ARM_END:
+    if (!(frame = topFrame()))
+      return -1;
+    tableStart = frame->label;
+    CASE_TAGGED_LABEL(tempLabel, COMMENT_BUF_LEN, TABLE_TAG_END, 0);
+    ASM_LINE("jmp", 1, tempLabel);
+    return 0;
+
+  case STREAM_CASE_ELSE:
+    if (!(frame = topFrame()))
+      return -1;
+    streamCaseElse(output, frame);
+    return 0;
+
+  case STREAM_CASE_END:
+    if (!(frame = topFrame()) || streamCaseEnd(output, node, frame))
+      return -1;
+    state->frameTop--;
+    return 0;
+  }
+
+  return 0;
+}
+
+
+int CodeGen_begin(CodeGenState_t *gen, FILE *output) {
+
+  int optimize = gen->optimize;
+  memset(gen, 0, sizeof(CodeGenState_t));
+  gen->optimize = optimize;
+  state = gen;
+  fillRegisterPool();
+
+  int status = writeASMHeader(output);
+  if (status)
+    fprintf(stderr, "Error writing ASM File header\n");
+  else {
+    //read only data is written as it is first used
+    BLANK_LINE;
+    SECTION_LINE(".text");
+    writeMainStart(output);
+  }
+
+  state = NULL;
+  return status;
+}
+
+int CodeGen_stream(CodeGenState_t *gen, FILE *output, StreamEvent event,
+                   TreeNode_t *node, Symbol_t **rodata, size_t count) {
+
+  state = gen;
+  int status = writeStreamedData(output, rodata, count);
+  if (status)
+    fprintf(stderr, "Error writing read only data section\n");
+  else
+    status = streamEvent(output, event, node);
+
+  state = NULL;
+  return status;
+}
+
+int CodeGen_end(CodeGenState_t *gen, FILE *output) {
+
+  state = gen;
+  if (output) {
+    writeMainEnd(output);
+    Peephole_flush(&state->peephole, output, printPeepholeLine);
   }
 
+  freeState(gen);
+  state = NULL;
   return 0;
 }
@@ -12,8 +12,127 @@
 
 #include "symtab.h"
 #include "tree.h"
+#include "parserHelper.h"
+#include "peephole.h"
 
-int CodeGen_process(FILE *file, TreeNode_t *ast, SymTable_t *rodata);
+//size of buffers used for comments and labels
+#define COMMENT_BUF_LEN 256
+
+//registers expressions are evaluated in when optimizing, and
+//how many of them can keep scalar variables through loops
+#define REGISTER_COUNT 6
+#define LOOP_REGISTER_COUNT 3
+
+/*
+ * State of a code generation pass. Owned by the caller, so
+ * several programs can be generated at the same time.
+ */
+typedef struct CodeGenState_s {
+  //optimization level, 0 evaluates expressions on the stack and 1
+  //in registers. Set by the caller, it is kept when the state is reset
+  int optimize;
+
+  //symbol table of the block being generated
+  SymTable_t *currentScope;
+  //number of labels generated so far
+  int labelCount;
+
+  //buffer for generating comments
+  char commentBuf[COMMENT_BUF_LEN];
+
+  //expression nodes waiting on their operands, see generateExp
+  struct ExpFrame_s *expStack;
+  size_t expStackSize, expStackTop;
+
+  //conditions waiting to be jumped on, see generateCondition
+  struct CondFrame_s *condStack;
+  size_t condStackSize, condStackTop;
+
+  //statements holding the one being streamed, see CodeGen_stream
+  struct StreamFrame_s *frames;
+  size_t frameSize, frameTop;
+
+  //bytes of strings written to .rodata
+  size_t rodataBytes;
+
+  //scalar variables kept in registers through the loops being
+  //generated, and whether the loop keeping them assigns them
+  Symbol_t *loopVars[LOOP_REGISTER_COUNT];
+  bool loopWrites[LOOP_REGISTER_COUNT];
+  //registers left for evaluating expressions in, see codegen.c
+  int registerPool[REGISTER_COUNT];
+  int poolSize;
+
+  //instructions held back to be rewritten when optimizing, see peephole.h
+  Peephole_t peephole;
+} CodeGenState_t;
+
+/*
+ * CodeGen_process:
+ *  Generate x86 assembly for a semantically checked abstract syntax tree.
+ *
+ * Arguments:
+ *  gen: State to keep the code generation in, it is reset first
+ *    other than its optimization level.
+ *  file: File stream to write the assembly to.
+ *  ast: Root node of the abstract syntax tree.
+ *  rodata: Symbol table of the string constants and literals.
+ *
+ * Returns:
+ *  0 on success, -1 on error.
+ */
+int CodeGen_process(CodeGenState_t *gen, FILE *file, TreeNode_t *ast, SymTable_t *rodata);
+
+/*
+ * CodeGen_begin:
+ *  Start generating a program streamed from the parser one part at a
+ *  time, rather than from its whole tree. Writes the program's header.
+ *
+ * Arguments:
+ *  gen: State to keep the code generation in, it is reset first
+ *    other than its optimization level.
+ *  file: File stream to write the assembly to.
+ *
+ * Returns:
+ *  0 on success, -1 on error.
+ */
+int CodeGen_begin(CodeGenState_t *gen, FILE *file);
+
+/*
+ * CodeGen_stream:
+ *  Generate the code of a semantically checked part of the program,
+ *  as handed over by the parser (see StreamEvent). Parts are generated
+ *  in source order, so the only code not in the same place as from
+ *  CodeGen_process is a case statement's jump to its cases, which
+ *  follows them. Read only data is written just before the code using it.
+ *
+ * Arguments:
+ *  gen: State the code generation was started in by CodeGen_begin.
+ *  file: File stream to write the assembly to.
+ *  event: What part of the program 'node' is.
+ *  node: The part of the program to generate.
+ *  rodata: String constants and literals first used by the part.
+ *  count: Number of symbols in 'rodata'.
+ *
+ * Returns:
+ *  0 on success, -1 on error.
+ */
+int CodeGen_stream(CodeGenState_t *gen, FILE *file, StreamEvent event,
+                   TreeNode_t *node, Symbol_t **rodata, size_t count);
+
+/*
+ * CodeGen_end:
+ *  Finish a streamed program, and free the memory used to generate it.
+ *
+ * Arguments:
+ *  gen: State the code generation was started in by CodeGen_begin.
+ *  file: File stream to write the end of the program to, NULL if
+ *    the program failed and is only being cleaned up.
+ *
+ * Returns:
+ *  0 on success, -1 on error.
+ */
+int CodeGen_end(CodeGenState_t *gen, FILE *file);
 
 
 #endif //__CODEGEN_H__
@@ -18,6 +18,13 @@
 #define WORD_SIZE_BYTES 4
 #define WORD_SIZE_BYTES_STR "4"
 
+//storage class for state kept separately by each thread
+#define THREAD_LOCAL __thread
+
+//keep data written by different threads on separate cache lines
+#define CACHE_LINE_SIZE 64
+#define CACHE_ALIGNED __attribute__((aligned(CACHE_LINE_SIZE)))
+
 /*
  * Ensures we aren't concatenating past any buffer limits
  */
@@ -0,0 +1,182 @@
+/*
+ * CMPT 399 (Winter 2016)
+ * Assignment 4: Code Generation
+ * Author: Derrick Gold
+ *
+ * String Intern Pool API
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "intern.h"
+#include "arena.h"
+#include "defines.h"
+
+//grow the bucket array once the pool holds this many strings per bucket
+#define MAX_LOAD 1
+
+//get the pool record of an interned string
+#define INTERN_RECORD(str) \
+  ((Intern_t *)((char *)(str) - offsetof(Intern_t, string)))
+
+typedef struct InternPool_s {
+  Intern_t **buckets;
+  size_t size, count;
+} InternPool_t;
+
+//pool of the compilation running on this thread
+static THREAD_LOCAL InternPool_t *pool = NULL;
+
+
+/*
+ * Create the pool in the active arena.
+ */
+static InternPool_t *initPool(void) {
+
+  Arena_t *arena = Arena_getActive();
+  InternPool_t *newPool = Arena_alloc(arena, sizeof(InternPool_t));
+  if (!newPool) {
+    fprintf(stderr, "Intern: Error allocating intern pool\n");
+    return NULL;
+  }
+
+  newPool->size = INTERN_BASE_SIZE;
+  newPool->buckets = Arena_alloc(arena, newPool->size * sizeof(Intern_t *));
+  if (!newPool->buckets) {
+    fprintf(stderr, "Intern: Error allocating intern pool buckets\n");
+    return NULL;
+  }
+
+  return newPool;
+}
+
+/*
+ * Double the number of buckets, and move the existing
+ * strings over using their stored hash values.
+ */
+static void growPool(void) {
+
+  size_t size = pool->size << 1;
+  Intern_t **buckets = Arena_alloc(Arena_getActive(), size * sizeof(Intern_t *));
+  //keep using the old buckets if the allocation fails
+  if (!buckets)
+    return;
+
+  for (size_t i = 0; i < pool->size; i++) {
+    Intern_t *entry = pool->buckets[i];
+    while (entry) {
+      Intern_t *next = entry->next;
+      size_t pos = entry->hash & (size - 1);
+      entry->next = buckets[pos];
+      buckets[pos] = entry;
+      entry = next;
+    }
+  }
+
+  pool->buckets = buckets;
+  pool->size = size;
+}
+
+/*
+ * Find a string in the pool, given its hash.
+ */
+static Intern_t *findEntry(const char *str, size_t length, size_t hash) {
+
+  Intern_t *entry = pool->buckets[hash & (pool->size - 1)];
+  while (entry) {
+    if (entry->hash == hash && entry->length == length &&
+        !memcmp(entry->string, str, length))
+      return entry;
+
+    entry = entry->next;
+  }
+
+  return NULL;
+}
+
+
+//djb2 algorithm
+//http://www.cse.yorku.ca/~oz/hash.html
+size_t Intern_hashString(const char *str, size_t length) {
+
+  size_t hashVal = 5381;
+  for (size_t i = 0; i < length; i++)
+    hashVal = ((hashVal << 5) + hashVal) ^ (int)str[i]; /* hash * 33 + c */
+
+  return hashVal;
+}
+
+
+char *Intern_stringLen(const char *str, size_t length) {
+
+  if (!str)
+    return NULL;
+
+  if (!pool && !(pool = initPool()))
+    return NULL;
+
+  size_t hash = Intern_hashString(str, length);
+  Intern_t *entry = findEntry(str, length, hash);
+  if (entry)
+    return entry->string;
+
+  //new string, add it to the pool
+  entry = Arena_alloc(Arena_getActive(), sizeof(Intern_t) + length + 1);
+  if (!entry) {
+    fprintf(stderr, "Intern: Error allocating string: %.*s\n", (int)length, str);
+    return NULL;
+  }
+
+  entry->hash = hash;
+  entry->length = length;
+  memcpy(entry->string, str, length);
+  entry->string[length] = '\0';
+
+  if (pool->count >= pool->size * MAX_LOAD)
+    growPool();
+
+  size_t pos = hash & (pool->size - 1);
+  entry->next = pool->buckets[pos];
+  pool->buckets[pos] = entry;
+  pool->count++;
+
+  return entry->string;
+}
+
+
+char *Intern_string(const char *str) {
+
+  if (!str)
+    return NULL;
+
+  return Intern_stringLen(str, strlen(str));
+}
+
+
+char *Intern_lookup(const char *str) {
+
+  if (!str || !pool)
+    return NULL;
+
+  size_t length = strlen(str);
+  Intern_t *entry = findEntry(str, length, Intern_hashString(str, length));
+  return entry ? entry->string : NULL;
+}
+
+
+size_t Intern_hash(const char *str) {
+  return INTERN_RECORD(str)->hash;
+}
+
+size_t Intern_length(const char *str) {
+  return INTERN_RECORD(str)->length;
+}
+
+size_t Intern_count(void) {
+  return pool ? pool->count : 0;
+}
+
+void Intern_reset(void) {
+  pool = NULL;
+}
@@ -0,0 +1,125 @@
+/*
+ * CMPT 399 (Winter 2016)
+ * Assignment 4: Code Generation
+ * Author: Derrick Gold
+ *
+ * String Intern Pool API
+ *
+ * Every distinct identifier, keyword, and string lexeme of a
+ * compilation is stored exactly once in the intern pool, along with
+ * its precomputed hash. Interned strings are plain C strings, so they
+ * can be printed and copied as usual, but two interned strings are
+ * equal if and only if their pointers are equal.
+ *
+ * The pool allocates from the active arena (see Arena_setActive) and
+ * must be reset with Intern_reset before that arena is destroyed. Like
+ * the active arena, each thread has a pool of its own.
+ */
+#ifndef __INTERN_H__
+#define __INTERN_H__
+
+#include <stddef.h>
+
+//initial number of buckets in the pool, must be a power of two
+#define INTERN_BASE_SIZE 256
+
+typedef struct Intern_s {
+  struct Intern_s *next;
+  size_t hash;
+  size_t length;
+  char string[];
+} Intern_t;
+
+/*
+ * Intern_hashString:
+ *  Hash function used by the intern pool (djb2).
+ *
+ * Arguments:
+ *  str: String to hash.
+ *  length: Number of characters of the string to hash.
+ *
+ * Returns:
+ *  The hash value of the string.
+ */
+size_t Intern_hashString(const char *str, size_t length);
+
+/*
+ * Intern_string:
+ *  Get the interned copy of a string, adding it to the pool
+ *  if it doesn't exist yet.
+ *
+ * Arguments:
+ *  str: String to intern.
+ *
+ * Returns:
+ *  Pointer to the interned copy of the string. NULL if the
+ *  string could not be added to the pool.
+ */
+char *Intern_string(const char *str);
+
+/*
+ * Intern_stringLen:
+ *  Same as Intern_string, for a string that is not
+ *  null terminated.
+ *
+ * Arguments:
+ *  str: String to intern.
+ *  length: Number of characters in the string.
+ *
+ * Returns:
+ *  Pointer to the interned (null terminated) copy of the string.
+ *  NULL if the string could not be added to the pool.
+ */
+char *Intern_stringLen(const char *str, size_t length);
+
+/*
+ * Intern_lookup:
+ *  Find the interned copy of a string without adding it to the pool.
+ *
+ * Arguments:
+ *  str: String to look up.
+ *
+ * Returns:
+ *  Pointer to the interned copy of the string. NULL if the string
+ *  has never been interned.
+ */
+char *Intern_lookup(const char *str);
+
+/*
+ * Intern_hash:
+ *  Get the precomputed hash of an interned string.
+ *
+ * Arguments:
+ *  str: An interned string, as returned by Intern_string.
+ *
+ * Returns:
+ *  The hash value of the string.
+ */
+size_t Intern_hash(const char *str);
+
+/*
+ * Intern_length:
+ *  Get the length of an interned string.
+ *
+ * Arguments:
+ *  str: An interned string, as returned by Intern_string.
+ *
+ * Returns:
+ *  Number of characters in the string.
+ */
+size_t Intern_length(const char *str);
+
+/*
+ * Intern_count:
+ *  Get the number of distinct strings in the pool.
+ */
+size_t Intern_count(void);
+
+/*
+ * Intern_reset:
+ *  Forget every interned string. The memory used by the pool
+ *  is released along with the arena it was allocated from.
+ */
+void Intern_reset(void);
+
+#endif //__INTERN_H__
@@ -0,0 +1,342 @@
+/*
+ * CMPT 399 (Winter 2016)
+ * Assignment 4: Code Generation
+ * Author: Derrick Gold
+ *
+ * MacEwan Teeny Pascal Compiler Library
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "parser.h"
+#include "libmtp.h"
+#include "tree.h"
+#include "intern.h"
+#include "source.h"
+#include "parlex.h"
+
+#define DO_VERBOSE_LEXER(verbose) ((verbose) > 2)
+#define DO_VERBOSE_PARSER(verbose) ((verbose) > 1)
+#define DO_VERBOSE_SEMANTIC(verbose) ((verbose) > 0)
+#define DO_VERBOSE_CODEGEN(verbose) ((verbose) > 0)
+
+#define INTERN_STATS_MSG(output) do {                                  \
+    fprintf(output, "Intern: %zu distinct strings\n", Intern_count());  \
+  } while (0)
+
+#define NODE_STATS_MSG(output) do {                                    \
+    fprintf(output, "Nodes: %zu nodes of %zu bytes, %zu reused\n",       \
+            TreeNode_count(), sizeof(TreeNode_t), TreeNode_reusedCount()); \
+  } while (0)
+
+#define PARLEX_STATS_MSG(output, stats) do {                           \
+    fprintf(output, "Parallel lexing: %zu chunk(s), %zu repaired, "     \
+            "%zu dropped\n", (stats).chunks, (stats).repaired,          \
+            (stats).dropped);                                           \
+  } while (0)
+
+#define QUEUE_STATS_MSG(output, stats) do {                            \
+    fprintf(output, "Token queue: %zu tokens in %zu batches, scanner "   \
+            "waited %zu, parser waited %zu time(s)\n", (stats).tokens,    \
+            (stats).batches, (stats).producerWaits, (stats).consumerWaits); \
+  } while (0)
+
+#define RODATA_STATS_MSG(output, strings, written) do {                \
+    fprintf(output, "Strings: %zu bytes of string literals and constants " \
+            "in %zu bytes of .rodata, %zu saved by sharing\n", (strings), \
+            (written), (strings) - (written));                          \
+  } while (0)
+
+//where the parser gets its tokens from
+typedef enum {
+  TOKENS_SCANNER,   //scanned as they are parsed
+  TOKENS_SPLIT,     //scanned up front by several threads, see ParLex_scan
+  TOKENS_QUEUE      //scanned on a thread of their own, see scanThread
+} TokenSource;
+
+#define TOKEN_STATS_MSG(output, stats) do {                            \
+    fprintf(output, "Tokens: %zu handed to parser, %zu recycled, "      \
+            "%zu reused, %zu slab(s)\n", (stats).handed, (stats).recycled, \
+            (stats).reused, (stats).slabs);                             \
+  } while (0)
+
+
+MtpContext_t *MtpContext_create(void) {
+
+  MtpContext_t *ctx = calloc(1, sizeof(MtpContext_t));
+  if (!ctx) {
+    fprintf(stderr, "MtpContext_create: Error allocating context\n");
+    return NULL;
+  }
+
+  ctx->mapInput = true;
+  ctx->lexThreads = 1;
+  ctx->optimize = 1;
+  return ctx;
+}
+
+
+void MtpContext_destroy(MtpContext_t *ctx) {
+
+  if (!ctx)
+    return;
+
+  memset(ctx, 0, sizeof(MtpContext_t));
+  free(ctx);
+}
+
+
+/*
+ * Scans a mapped source on a thread of its own, passing the tokens
+ * to the parser through the context's queue. Lexemes are left in the
+ * source, and interned by the parser's thread (see Lexer_internSpan).
+ * Only the scanning fields of the lexer state are touched here, the
+ * parser's thread keeps the token storage fields to itself.
+ */
+static void *scanThread(void *arg) {
+
+  MtpContext_t *ctx = arg;
+  LexToken_t token;
+  do {
+    token = Lexer_getSpan(ctx->scanner);
+
+    //an unterminated string's error comes before the end of file
+    if (token.type == TOK_ENDFILE &&
+        Lexer_getContext(ctx->scanner, NULL) == LEXCONTEXT_STRING &&
+        TokenQueue_push(&ctx->queue, (LexToken_t) {.offset = token.offset, .type = TOK_ERROR}))
+      break;
+
+    if (TokenQueue_push(&ctx->queue, token))
+      break;
+  } while (!LEXTOKEN_ISEOF(token.type));
+
+  TokenQueue_flush(&ctx->queue);
+  return NULL;
+}
+
+
+/*
+ * Hands a part of a streamed parse over to semantic analysis, then
+ * has the code generator write it out, see ParserStream_t.
+ */
+static int streamNode(StreamEvent event, TreeNode_t *node, void *data) {
+
+  MtpContext_t *ctx = data;
+  if (Analyze_Stream(&ctx->analyze, event, node))
+    return -1;
+
+  size_t count;
+  Symbol_t **rodata = Analyze_TakeRodata(&ctx->analyze, &count);
+  return CodeGen_stream(&ctx->codegen, ctx->out, event, node, rodata, count);
+}
+
+
+/*
+ * Tokenizes the input with flex, parses the tokens with lemon,
+ * runs semantic checks on the AST, then generates the assembly.
+ */
+int mtp_compile(MtpContext_t *ctx, FILE *in, FILE *out) {
+
+  if (!ctx || !in || !out)
+    return EXIT_FAILURE;
+
+  int returnVal = EXIT_SUCCESS;
+
+  //all tokens, nodes and symbols of this compilation
+  //are allocated from a single arena
+  ctx->arena = Arena_create(ARENA_BLOCK_SIZE);
+  if (!ctx->arena)
+    return EXIT_FAILURE;
+  Arena_setActive(ctx->arena);
+  Intern_reset();
+  TreeNode_resetPool();
+
+  if (Lexer_init(&ctx->lexer, &ctx->scanner)) {
+    fprintf(stderr, "Error initializing lexer.\n");
+    Arena_setActive(NULL);
+    Arena_destroy(ctx->arena);
+    ctx->arena = NULL;
+    return EXIT_FAILURE;
+  }
+
+  /*
+   * Regular files are mapped into memory and scanned in place,
+   * anything else (like a pipe) is read by flex from the stream.
+   */
+  Source_t *source = Source_open(in, ctx->mapInput);
+  //tokens of a source scanned before parsing, see ParLex_scan
+  ParLex_t lexed = {0};
+  size_t next = 0;
+  TokenSource tokens = TOKENS_SCANNER;
+  pthread_t scannerThread;
+
+  if (!source)
+    returnVal = EXIT_FAILURE;
+  else if (Source_isMapped(source)) {
+    Lexer_scanBuffer(ctx->scanner, source->buffer, source->size);
+
+    //a large enough source is split up between several threads
+    int threads = ParLex_chunksFor(source->size, ctx->lexThreads);
+    if (threads > 1) {
+      tokens = TOKENS_SPLIT;
+      if (ParLex_scan(&lexed, source->buffer, source->size, threads))
+        returnVal = EXIT_FAILURE;
+    }
+    //otherwise scanning may overlap with parsing
+    else if (ctx->pipeline && !TokenQueue_init(&ctx->queue)) {
+      tokens = TOKENS_QUEUE;
+      if (pthread_create(&scannerThread, NULL, scanThread, ctx)) {
+        fprintf(stderr, "Error starting scanner thread.\n");
+        TokenQueue_free(&ctx->queue);
+        tokens = TOKENS_SCANNER;
+      }
+    }
+  } else
+    Lexer_setInput(ctx->scanner, source->file);
+
+  //initialize the parser
+  void *parser = ParseAlloc(malloc);
+  memset(&ctx->parser, 0, sizeof(ParserState_t));
+  ctx->parser.scanner = ctx->scanner;
+  ctx->codegen.optimize = ctx->optimize;
+  int type = 0;
+
+  //when streaming, each statement is checked and written as it is reduced
+  if (ctx->streaming) {
+    ctx->out = out;
+    ctx->parser.stream = streamNode;
+    ctx->parser.streamData = ctx;
+    if (Analyze_Begin(&ctx->analyze) || CodeGen_begin(&ctx->codegen, out))
+      returnVal = EXIT_FAILURE;
+  }
+  LexToken_t *tok = NULL;
+
+  //Loop through input file, tokenize, and parse
+  while (returnVal != EXIT_FAILURE && parser) {
+    //get token
+    LexToken_t token;
+    switch (tokens) {
+      case TOKENS_SPLIT:
+        token = lexed.tokens[next++];
+        break;
+      case TOKENS_QUEUE:
+        token = TokenQueue_pop(&ctx->queue);
+        Lexer_internSpan(&token, source->buffer);
+        break;
+      default:
+        token = Lexer_getToken(ctx->scanner);
+        break;
+    }
+    type = token.type;
+
+    //print out the token if -vv is used
+    if (DO_VERBOSE_LEXER(ctx->verbose)) {
+      Lexer_printToken(token, stdout);
+      fprintf(stdout, "\n");
+    }
+
+    //heapify token for storing in a node
+    tok = Lexer_heapifyToken(ctx->scanner, token);
+    if (!tok) break;
+
+    //pass token into parser
+    Parse(parser, token.type, tok, &ctx->parser);
+
+    if (LEXTOKEN_ISEOF(type) || Parser_hasError(&ctx->parser))
+      break;
+  }
+
+  //the scanner thread is done with the queue once it has stopped
+  if (tokens == TOKENS_QUEUE) {
+    TokenQueue_close(&ctx->queue);
+    pthread_join(scannerThread, NULL);
+  }
+
+  //if there was an error in the lexer, set return status to fail
+  if (!parser || type == TOK_SYSERR)
+    returnVal = EXIT_FAILURE;
+
+  //If there was an error in the Parser, set return status to fail
+  if (returnVal == EXIT_FAILURE || Parser_hasError(&ctx->parser))
+    returnVal = EXIT_FAILURE;
+  //otherwise, print the tree if -v is used (a streamed one is gone)
+  else if (DO_VERBOSE_PARSER(ctx->verbose) && !ctx->streaming)
+    TreeNode_print(stdout, Parser_getTree(&ctx->parser), false);
+
+  //a streamed program was checked and generated as it was parsed
+  if (ctx->streaming) {
+    if (CodeGen_end(&ctx->codegen, returnVal != EXIT_FAILURE ? out : NULL))
+      returnVal = EXIT_FAILURE;
+    Analyze_End(&ctx->analyze);
+  }
+
+  //check if abstract syntax tree was properly generated
+  //before analyzing
+  else if (returnVal != EXIT_FAILURE) {
+    //run semantic checks
+    Analyze_Semantics(&ctx->analyze, Parser_getTree(&ctx->parser),
+                      DO_VERBOSE_SEMANTIC(ctx->verbose));
+    if (Analyze_GetStatus(&ctx->analyze) != NONE)
+      returnVal = EXIT_FAILURE;
+  }
+
+  //check if semantics was successful before generating code
+  if (returnVal != EXIT_FAILURE && !ctx->streaming &&
+      CodeGen_process(&ctx->codegen, out, Parser_getTree(&ctx->parser),
+                      Analyze_GetRodata(&ctx->analyze)))
+    returnVal = EXIT_FAILURE;
+
+  //print what the peephole optimizer rewrote if -v or -s is used
+  if (returnVal != EXIT_FAILURE && ctx->optimize &&
+      (DO_VERBOSE_CODEGEN(ctx->verbose) || ctx->stats))
+    Peephole_printHits(&ctx->codegen.peephole, stderr);
+
+  /*
+   * Clean up
+   */
+  //the EOF token is not consumed by lemon
+  if (type == TOK_ENDFILE && tok)
+    Lexer_recycleToken(ctx->scanner, tok);
+
+  if (ctx->stats) {
+    LexTokenStats_t tokenStats;
+    Lexer_getTokenStats(ctx->scanner, &tokenStats);
+    if (tokens == TOKENS_SPLIT)
+      PARLEX_STATS_MSG(stderr, lexed.stats);
+    if (tokens == TOKENS_QUEUE) {
+      TokenQueueStats_t queueStats;
+      TokenQueue_getStats(&ctx->queue, &queueStats);
+      QUEUE_STATS_MSG(stderr, queueStats);
+    }
+    TOKEN_STATS_MSG(stderr, tokenStats);
+    INTERN_STATS_MSG(stderr);
+    NODE_STATS_MSG(stderr);
+    if (returnVal != EXIT_FAILURE)
+      RODATA_STATS_MSG(stderr, ctx->analyze.stringBytes, ctx->codegen.rodataBytes);
+    Arena_printStats(stderr, ctx->arena);
+  }
+
+  //free the lemon parser
+  if (parser)
+    ParseFree(parser, free);
+  //free up any memory used by the lexer
+  Lexer_destroy(ctx->scanner);
+  ctx->scanner = NULL;
+  ParLex_free(&lexed);
+  if (tokens == TOKENS_QUEUE)
+    TokenQueue_free(&ctx->queue);
+  //unmap the input file
+  Source_close(source);
+
+  //forget the interned strings and nodes before their arena goes away,
+  //then free the tokens, abstract syntax tree + symbol tables at once
+  Intern_reset();
+  TreeNode_resetPool();
+  Arena_setActive(NULL);
+  Arena_destroy(ctx->arena);
+  ctx->arena = NULL;
+
+  return returnVal;
+}
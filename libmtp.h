@@ -0,0 +1,94 @@
+/*
+ * CMPT 399 (Winter 2016)
+ * Assignment 4: Code Generation
+ * Author: Derrick Gold
+ *
+ * MacEwan Teeny Pascal Compiler Library
+ *
+ * Everything a compilation needs (scanner, parser, semantic analysis
+ * and code generator state, along with the arena they allocate from)
+ * lives in a compiler context. Contexts share nothing, so separate
+ * threads may each compile a program with their own context at the
+ * same time.
+ */
+#ifndef __LIBMTP_H__
+#define __LIBMTP_H__
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "lexer.h"
+#include "parserHelper.h"
+#include "analyze.h"
+#include "codegen.h"
+#include "arena.h"
+#include "tokenq.h"
+
+typedef struct MtpContext_s {
+  //debugging output level, same as the -v count of mtp
+  int verbose;
+  //print memory usage statistics on stderr after compiling
+  bool stats;
+  //map regular input files into memory instead of reading them
+  bool mapInput;
+  //most threads a large mapped input is scanned with, before
+  //parsing starts, 1 to scan every input as it is parsed
+  int lexThreads;
+  //scan a mapped input on a thread of its own while it is parsed
+  bool pipeline;
+  //analyze and generate each statement as soon as it is parsed,
+  //rather than once the whole tree is built
+  bool streaming;
+  //optimization level of the generated code, 0 to evaluate every
+  //expression on the stack as the code generator first did
+  int optimize;
+
+  //arena of the compilation in progress
+  Arena_t *arena;
+
+  //per module state of the compilation in progress
+  void *scanner;
+  LexerState_t lexer;
+  TokenQueue_t queue;
+  ParserState_t parser;
+  AnalyzeState_t analyze;
+  CodeGenState_t codegen;
+  //stream a streamed compilation writes its assembly to
+  FILE *out;
+} MtpContext_t;
+
+/*
+ * MtpContext_create:
+ *  Create a compiler context with the default options.
+ *
+ * Returns:
+ *  Pointer to the new context. NULL on error.
+ */
+MtpContext_t *MtpContext_create(void);
+
+/*
+ * MtpContext_destroy:
+ *  Free a compiler context.
+ *
+ * Arguments:
+ *  ctx: The context to free.
+ */
+void MtpContext_destroy(MtpContext_t *ctx);
+
+/*
+ * mtp_compile:
+ *  Compile a MacEwan Teeny Pascal program into x86 assembly.
+ *  A context runs one compilation at a time, but may be reused
+ *  for any number of them.
+ *
+ * Arguments:
+ *  ctx: Context to compile with.
+ *  in: Stream of the program source.
+ *  out: Stream to write the generated assembly to.
+ *
+ * Returns:
+ *  EXIT_SUCCESS if the program was compiled, EXIT_FAILURE otherwise.
+ */
+int mtp_compile(MtpContext_t *ctx, FILE *in, FILE *out);
+
+#endif //__LIBMTP_H__
@@ -0,0 +1,119 @@
+/*
+ * CMPT 399 (Winter 2016)
+ * Assignment 4: Code Generation
+ * Author: Derrick Gold
+ *
+ * Line Index API
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lineindex.h"
+#include "defines.h"
+
+//index lines are looked up in, each thread has its own
+static THREAD_LOCAL LineIndex_t *activeIndex = NULL;
+
+
+/*
+ * Record the newlines in a range of the source, 'base' being
+ * the offset of the range within the source.
+ */
+static int addNewlines(LineIndex_t *index, const char *text, size_t length, size_t base) {
+
+  const char *end = text + length;
+  const char *p = text;
+  while ((p = memchr(p, '\n', end - p))) {
+    if (index->count == index->capacity) {
+      size_t capacity = index->capacity ? index->capacity << 1 : LINEINDEX_BASE_SIZE;
+      size_t *newlines = realloc(index->newlines, capacity * sizeof(size_t));
+      if (!newlines) {
+        fprintf(stderr, "LineIndex: Error growing newline index\n");
+        return -1;
+      }
+      index->newlines = newlines;
+      index->capacity = capacity;
+    }
+
+    index->newlines[index->count++] = base + (size_t)(p - text);
+    p++;
+  }
+
+  return 0;
+}
+
+
+void LineIndex_init(LineIndex_t *index) {
+
+  if (index)
+    memset(index, 0, sizeof(LineIndex_t));
+}
+
+
+void LineIndex_setText(LineIndex_t *index, const char *text, size_t size) {
+
+  if (!index)
+    return;
+
+  index->text = text;
+  index->size = size;
+  index->indexed = 0;
+  index->count = 0;
+}
+
+
+int LineIndex_append(LineIndex_t *index, const char *chunk, size_t length) {
+
+  if (!index || !chunk)
+    return -1;
+
+  int status = addNewlines(index, chunk, length, index->size);
+  index->size += length;
+  index->indexed = index->size;
+  return status;
+}
+
+
+int LineIndex_lineOf(LineIndex_t *index, size_t offset) {
+
+  if (!index)
+    return -1;
+
+  //search the text up to the offset, if it hasn't been yet
+  if (index->text && offset > index->indexed) {
+    size_t end = offset < index->size ? offset : index->size;
+    addNewlines(index, index->text + index->indexed, end - index->indexed, index->indexed);
+    index->indexed = end;
+  }
+
+  //the line is one more than the number of newlines before the offset
+  size_t low = 0, high = index->count;
+  while (low < high) {
+    size_t mid = low + ((high - low) >> 1);
+    if (index->newlines[mid] < offset)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  return (int)low + 1;
+}
+
+
+void LineIndex_free(LineIndex_t *index) {
+
+  if (!index)
+    return;
+
+  free(index->newlines);
+  memset(index, 0, sizeof(LineIndex_t));
+}
+
+
+void LineIndex_setActive(LineIndex_t *index) {
+  activeIndex = index;
+}
+
+LineIndex_t *LineIndex_getActive(void) {
+  return activeIndex;
+}
@@ -0,0 +1,118 @@
+/*
+ * CMPT 399 (Winter 2016)
+ * Assignment 4: Code Generation
+ * Author: Derrick Gold
+ *
+ * Line Index API
+ *
+ * Tokens remember where they are in the source as a byte offset,
+ * which costs the lexer nothing to keep track of. Offsets are only
+ * turned into line numbers when one needs to be shown (diagnostics,
+ * verbose output), by looking them up in an index of the offsets of
+ * the newlines in the source.
+ *
+ * A source scanned in place is searched for newlines lazily, and only
+ * as far as the offsets that have been looked up. A source read in
+ * chunks has each chunk indexed as it is read, since the chunks
+ * aren't around any more once they have been scanned.
+ *
+ * Like the active arena, each thread has an active index of its own,
+ * which is used to look up the lines of tokens.
+ */
+#ifndef __LINEINDEX_H__
+#define __LINEINDEX_H__
+
+#include <stddef.h>
+
+//initial number of newline offsets the index has room for
+#define LINEINDEX_BASE_SIZE 1024
+
+typedef struct LineIndex_s {
+  //source searched for newlines on demand, NULL if read in chunks
+  const char *text;
+  //bytes of the source known to the index, and searched so far
+  size_t size, indexed;
+
+  //offsets of the newlines found, in order
+  size_t *newlines;
+  size_t count, capacity;
+} LineIndex_t;
+
+/*
+ * LineIndex_init:
+ *  Initialize an empty index, for a source read in chunks.
+ *
+ * Arguments:
+ *  index: The index to initialize.
+ */
+void LineIndex_init(LineIndex_t *index);
+
+/*
+ * LineIndex_setText:
+ *  Have an index search a source in memory for newlines when needed.
+ *  The text must stay around, and keep its newlines, for as long as
+ *  lines are looked up in the index.
+ *
+ * Arguments:
+ *  index: The index of the source.
+ *  text: Contents of the source.
+ *  size: Size of the source in bytes.
+ */
+void LineIndex_setText(LineIndex_t *index, const char *text, size_t size);
+
+/*
+ * LineIndex_append:
+ *  Index the next chunk of a source read in chunks.
+ *
+ * Arguments:
+ *  index: The index of the source.
+ *  chunk: Bytes of the source following those already indexed.
+ *  length: Number of bytes in the chunk.
+ *
+ * Returns:
+ *  0 on success, -1 if the index couldn't grow.
+ */
+int LineIndex_append(LineIndex_t *index, const char *chunk, size_t length);
+
+/*
+ * LineIndex_lineOf:
+ *  Get the line number of a position in a source.
+ *
+ * Arguments:
+ *  index: The index of the source.
+ *  offset: Byte offset of the position.
+ *
+ * Returns:
+ *  The line number (starting at 1) of the position. -1 if there
+ *  is no index.
+ */
+int LineIndex_lineOf(LineIndex_t *index, size_t offset);
+
+/*
+ * LineIndex_free:
+ *  Free the memory used by an index, leaving it empty.
+ *
+ * Arguments:
+ *  index: The index to free.
+ */
+void LineIndex_free(LineIndex_t *index);
+
+/*
+ * LineIndex_setActive:
+ *  Set the index lines are looked up in by this thread.
+ *
+ * Arguments:
+ *  index: The index to look up lines in, NULL for none.
+ */
+void LineIndex_setActive(LineIndex_t *index);
+
+/*
+ * LineIndex_getActive:
+ *  Get the index lines are looked up in by this thread.
+ *
+ * Returns:
+ *  The active index. NULL if there is none.
+ */
+LineIndex_t *LineIndex_getActive(void);
+
+#endif //__LINEINDEX_H__
@@ -9,21 +9,14 @@
  *
  */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
 #include <unistd.h> //include for getopt
 #include <libgen.h> //include for basename
 
 
-#include "parser.h"
-#include "lexer.h"
-#include "tree.h"
-#include "parserHelper.h"
-#include "analyze.h"
-#include "codegen.h"
-
-#define DO_VERBOSE_LEXER(verbose) ((verbose) > 2)
-#define DO_VERBOSE_PARSER(verbose) ((verbose) > 1)
-#define DO_VERBOSE_SEMANTIC(verbose) ((verbose) > 0)
+#include "libmtp.h"
 
 #define DEFAULT_ASMOUT "program.s"
 #define OUTFILE_EXT ".s"
@@ -35,23 +28,20 @@
    "Options:\n"                                                         \
    "\t-h\t\tdisplay this help and exit\n"                               \
    "\t-v\t\tdisplay extra (verbose) debugging information\n"            \
-   "\t\t\t(multiple -v options increase verbosity)\n")
+   "\t\t\t(multiple -v options increase verbosity)\n"                   \
+   "\t-s\t\tdisplay memory usage statistics on stderr\n"                \
+   "\t-r\t\tread the input file through stdio instead of mapping it\n" \
+   "\t-j threads\tscan a large input file with up to this many threads\n" \
+   "\t-p\t\tscan the input file on a thread of its own while parsing\n" \
+   "\t-m\t\tgenerate each statement as soon as it is parsed, bounding\n" \
+   "\t\t\tmemory use by the program's nesting rather than its size\n" \
+   "\t-O level\toptimization level of the generated code, 0 or 1 (default)\n")
 
 
 //store the program's binary name
 static char *_prgmName = NULL;
 
 
-#define ERR_TOK_MSG(token, output) do {                  \
-    fprintf(output, "Invalid token detected: (line ");   \
-    Lexer_printToken(token, output);                     \
-    fprintf(output, ")\n");                              \
-  } while (0)
-
-#define SYSERR_TOK_MSG(output) do {                                     \
-    fprintf(output, "Lexer has encounterd a critical error: memory alloc failed.\n"); \
-  } while (0)
-
 /*
  * printHelp:
  *
@@ -68,89 +58,6 @@ static void printHelp(void) {
   printf(HELP_TEXT, _prgmName);
 }
 
-/*
- * So far, tokenizes input from a given file using flex,
- * parses the tokens with lemon, and runs semantic checks
- * on the AST.
- * Soon to be a completely working compile function.
- */
-static int compile(FILE *asmOut, int verbose) {
-
-  if (!asmOut)
-    return EXIT_FAILURE;
-  
-  int returnVal = EXIT_SUCCESS;
-
-  //initialize the parser
-  void *parser = ParseAlloc(malloc);
-  int type = 0;
-  LexToken_t *tok = NULL;
-
-  //Loop through input file, tokenize, and parse
-  do {
-    //get token
-    LexToken_t token = Lexer_getToken();
-    type = token.type;
-
-    //print out the token if -vv is used    
-    if (DO_VERBOSE_LEXER(verbose)) {
-      Lexer_printToken(token, stdout);
-      fprintf(stdout, "\n");
-    }
-
-    //heapify token for storing in a node
-    tok = Lexer_heapifyToken(token);
-    if (!tok) break;
-
-    //pass token into parser
-    Parse(parser, token.type, tok);
-    
-  } while (!LEXTOKEN_ISEOF(type) && !Parser_hasError());
-
-  //if there was an error in the lexer, set return status to fail
-  if (type == TOK_SYSERR)
-    returnVal = EXIT_FAILURE;
-
-  //If there was an error in the Parser, set return status to fail
-  if (Parser_hasError())
-    returnVal = EXIT_FAILURE;
-  //otherwise, print the tree if -v is used
-  else if (DO_VERBOSE_PARSER(verbose))
-    TreeNode_print(stdout, Parser_getTree(), false);
-
-  //check if abstract syntax tree was properly generated
-  //before analyzing
-  if (returnVal != EXIT_FAILURE) {
-    //run semantic checks
-    Analyze_Semantics(Parser_getTree(), DO_VERBOSE_SEMANTIC(verbose));
-    if (Analyze_GetStatus() != NONE)
-      returnVal = EXIT_FAILURE; 
-  }
-
-  //check if semantics was successful before generating code
-  if (returnVal != EXIT_FAILURE && CodeGen_process(asmOut, Parser_getTree(), Analyze_GetRodata()))
-      returnVal = EXIT_FAILURE;
-  
-  /*
-   * Clean up
-   */
-  //free the heapified EOF token that is not consumed by lemon
-  if (type == TOK_ENDFILE && tok)
-    Lexer_tokenDestructor(tok);
-
-  //free any memory used in the semantic analysis
-  Analyze_Cleanup();
-  //free the abstract syntax tree + symbol tabls
-  TreeNode_destroy(Parser_getTree());
-  //free the lemon parser
-  ParseFree(parser, free);
-  //free up any memory used by the lexer
-  yylex_destroy();
-
-  return returnVal;
-}
-
-
 /*
  * main:
  *
@@ -170,12 +77,18 @@ int main(int argc, char *argv[]) {
   }
 
   int verbose = 0;
+  bool stats = false;
+  bool mapInput = true;
+  int lexThreads = 1;
+  bool pipeline = false;
+  bool streaming = false;
+  int optimize = 1;
   char *inputFile = NULL;
   char *outputFile = NULL;
 
   //loop through arguments and collect options
   int c;
-  while ((c = getopt(argc, argv, "hvo:")) != -1) {
+  while ((c = getopt(argc, argv, "hvsrpmj:O:o:")) != -1) {
 
     switch (c) {
       case 'h':
@@ -185,6 +98,32 @@ int main(int argc, char *argv[]) {
       case 'v':
         verbose++;
         break;
+      case 's':
+        stats = true;
+        break;
+      case 'r':
+        mapInput = false;
+        break;
+      case 'p':
+        pipeline = true;
+        break;
+      case 'm':
+        streaming = true;
+        break;
+      case 'j':
+        lexThreads = atoi(optarg);
+        if (lexThreads < 1) {
+          fprintf(stderr, "Invalid number of threads: %s\n", optarg);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'O':
+        optimize = atoi(optarg);
+        if (optimize < 0 || optimize > 1) {
+          fprintf(stderr, "Invalid optimization level: %s\n", optarg);
+          return EXIT_FAILURE;
+        }
+        break;
     case 'o':
       outputFile = optarg;
       break;
@@ -226,18 +165,14 @@ int main(int argc, char *argv[]) {
 
   /*
    * Open the file to put through the lexer.
-   * It is necessary to create a copy of the file handle since
-   * flex will set its copy of the file handle to 0 when it is 
-   * finished.
-   *
-   * This way we still have a reference to close the file with.
+   * The compiler maps regular files into memory and scans them
+   * in place, anything else (like a pipe) is read through the stream.
    */
   FILE *inFile = fopen(inputFile, "r");
   if (!inFile) {
     fprintf(stderr, "Error opening input fle: %s\n\n", inputFile);
     return EXIT_FAILURE;
   }
-  yyin = inFile;
 
 
   //set the default output file name if one hasn't been specified
@@ -260,18 +195,31 @@ int main(int argc, char *argv[]) {
   FILE *outFile = fopen(outputFile, "w");
   if (!outFile) {
     fprintf(stderr, "ERror opening assembly output file: %s\n", outputFile);
+    fclose(inFile);
     return EXIT_FAILURE;
   }
   
 
   
-  /*
-   * Store lexer + parser status for future assignments
-   * when more parts will be added after this point.
-   */
-  int compileStatus = compile(outFile, verbose);
+  MtpContext_t *ctx = MtpContext_create();
+  if (!ctx) {
+    fclose(inFile);
+    fclose(outFile);
+    return EXIT_FAILURE;
+  }
+
+  ctx->verbose = verbose;
+  ctx->stats = stats;
+  ctx->mapInput = mapInput;
+  ctx->lexThreads = lexThreads;
+  ctx->pipeline = pipeline;
+  ctx->streaming = streaming;
+  ctx->optimize = optimize;
+
+  int compileStatus = mtp_compile(ctx, inFile, outFile);
+  MtpContext_destroy(ctx);
 
-  //close input file 
+  //close input file
   fclose(inFile);
   //close output file
   fclose(outFile);
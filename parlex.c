@@ -0,0 +1,279 @@
+/*
+ * CMPT 399 (Winter 2016)
+ * Assignment 4: Code Generation
+ * Author: Derrick Gold
+ *
+ * Parallel Scanner API
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "parser.h"
+#include "parlex.h"
+#include "tokens.h"
+#include "lineindex.h"
+#include "source.h"
+
+/*
+ * A part of the source scanned on its own.
+ */
+typedef struct Chunk_s {
+  //bytes of the chunk, and their offset in the source
+  const char *text;
+  size_t start, length;
+
+  //context the chunk is scanned from, then the one it ended in
+  LexContext_t context;
+  int depth;
+
+  //tokens of the chunk, lexemes still left in the source
+  LexToken_t *tokens;
+  size_t count, capacity;
+
+  int status;
+  //thread the chunk was scanned on, if it got one
+  pthread_t thread;
+  bool threaded;
+} Chunk_t;
+
+
+static int addToken(Chunk_t *chunk, LexToken_t token) {
+
+  if (chunk->count == chunk->capacity) {
+    //start from a guess of how many tokens the chunk holds
+    size_t capacity = chunk->capacity ? chunk->capacity << 1 : (chunk->length >> 3) + 16;
+    LexToken_t *tokens = realloc(chunk->tokens, capacity * sizeof(LexToken_t));
+    if (!tokens)
+      return -1;
+
+    chunk->tokens = tokens;
+    chunk->capacity = capacity;
+  }
+
+  chunk->tokens[chunk->count++] = token;
+  return 0;
+}
+
+/*
+ * Scan a chunk from its context with a scanner of its own, leaving
+ * the context it ended in. Flex needs a writable buffer followed by
+ * the end of buffer sentinel, so the chunk is scanned from a copy.
+ */
+static int scanChunk(Chunk_t *chunk) {
+
+  char *buffer = malloc(chunk->length + SOURCE_PADDING);
+  if (!buffer) {
+    fprintf(stderr, "ParLex: Error allocating chunk buffer\n");
+    return -1;
+  }
+  memcpy(buffer, chunk->text, chunk->length);
+  memset(buffer + chunk->length, 0, SOURCE_PADDING);
+
+  //the scanner would replace the lines tokens are looked up in
+  LineIndex_t *lines = LineIndex_getActive();
+
+  LexerState_t state;
+  void *scanner = NULL;
+  if (Lexer_init(&state, &scanner) || Lexer_scanBuffer(scanner, buffer, chunk->length)) {
+    fprintf(stderr, "ParLex: Error initializing chunk scanner\n");
+    Lexer_destroy(scanner);
+    LineIndex_setActive(lines);
+    free(buffer);
+    return -1;
+  }
+
+  //tokens are given their offsets in the whole source
+  state.offset = chunk->start;
+  Lexer_setContext(scanner, chunk->context, chunk->depth);
+
+  int status = 0;
+  chunk->count = 0;
+  LexToken_t token = Lexer_getSpan(scanner);
+  for (; !LEXTOKEN_ISEOF(token.type); token = Lexer_getSpan(scanner)) {
+    if (addToken(chunk, token)) {
+      fprintf(stderr, "ParLex: Error growing chunk tokens\n");
+      status = -1;
+      break;
+    }
+  }
+
+  chunk->context = Lexer_getContext(scanner, &chunk->depth);
+
+  Lexer_destroy(scanner);
+  LineIndex_setActive(lines);
+  free(buffer);
+  return status;
+}
+
+static void *scanThread(void *arg) {
+
+  Chunk_t *chunk = arg;
+  chunk->status = scanChunk(chunk);
+  return NULL;
+}
+
+/*
+ * Find where to end a chunk, just after the first line break from
+ * 'target' that follows a ';' if there is one close by, otherwise
+ * just after the first line break. NULL if there are no line breaks.
+ */
+static const char *findSplit(const char *source, size_t size, size_t target) {
+
+  const char *end = source + size;
+  const char *p = source + target;
+  const char *window = end - p > PARLEX_SPLIT_WINDOW ? p + PARLEX_SPLIT_WINDOW : end - 1;
+  while (p < window && (p = memchr(p, ';', window - p))) {
+    if (p[1] == '\n')
+      return p + 2;
+    p++;
+  }
+
+  const char *newline = memchr(source + target, '\n', size - target);
+  return newline ? newline + 1 : NULL;
+}
+
+/*
+ * Split a source into at most 'count' chunks of about the same size,
+ * each ending just after a line break (or at the end of the source).
+ * Returns the number of chunks made.
+ */
+static int splitSource(Chunk_t *chunks, int count, const char *source, size_t size) {
+
+  int made = 0;
+  size_t start = 0;
+  for (int i = 0; i < count && start < size; i++) {
+    size_t end = size;
+    if (i < count - 1) {
+      size_t target = size / count * (i + 1);
+      if (target < start)
+        target = start;
+
+      const char *split = findSplit(source, size, target);
+      if (split)
+        end = (size_t)(split - source);
+    }
+
+    chunks[made++] = (Chunk_t) {
+      .text = source + start,
+      .start = start,
+      .length = end - start,
+      .context = LEXCONTEXT_CODE
+    };
+    start = end;
+  }
+
+  return made;
+}
+
+
+int ParLex_scan(ParLex_t *result, const char *source, size_t size, int threads) {
+
+  if (!result || !source)
+    return -1;
+
+  memset(result, 0, sizeof(ParLex_t));
+  if (threads < 1)
+    threads = 1;
+  else if (threads > PARLEX_MAX_THREADS)
+    threads = PARLEX_MAX_THREADS;
+
+  Chunk_t chunks[PARLEX_MAX_THREADS];
+  int count = splitSource(chunks, threads, source, size);
+
+  //the first chunk is scanned on this thread, while the others are
+  //scanned on threads of their own (or here, if one can't be started)
+  for (int i = 1; i < count; i++) {
+    chunks[i].threaded = !pthread_create(&chunks[i].thread, NULL, scanThread, &chunks[i]);
+    if (!chunks[i].threaded)
+      chunks[i].status = scanChunk(&chunks[i]);
+  }
+  int status = count ? scanChunk(&chunks[0]) : 0;
+  for (int i = 1; i < count; i++) {
+    if (chunks[i].threaded)
+      pthread_join(chunks[i].thread, NULL);
+    status |= chunks[i].status;
+  }
+
+  /*
+   * Check each chunk started in the context the one before it ended
+   * in, scanning it again if it didn't. Anything after a chunk ending
+   * in an unterminated string is part of that string.
+   */
+  LexContext_t context = LEXCONTEXT_CODE;
+  int depth = 0, used = 0;
+  size_t total = 0;
+  for (; !status && used < count && context != LEXCONTEXT_STRING; used++) {
+    Chunk_t *chunk = &chunks[used];
+    if (context != LEXCONTEXT_CODE) {
+      chunk->context = context;
+      chunk->depth = depth;
+      status = scanChunk(chunk);
+      result->stats.repaired++;
+    }
+
+    context = chunk->context;
+    depth = chunk->depth;
+    total += chunk->count;
+  }
+  result->stats.chunks = count;
+  result->stats.dropped = count - used;
+
+  //room for the end of file, after an unterminated string's error
+  if (!status)
+    result->tokens = malloc((total + 2) * sizeof(LexToken_t));
+  if (!status && !result->tokens) {
+    fprintf(stderr, "ParLex: Error allocating source tokens\n");
+    status = -1;
+  }
+
+  //join the tokens in source order, interning them in order too
+  for (int i = 0; i < used && !status; i++) {
+    for (size_t t = 0; t < chunks[i].count && !status; t++) {
+      result->tokens[result->count] = chunks[i].tokens[t];
+      status = Lexer_internSpan(&result->tokens[result->count++], source);
+    }
+  }
+
+  if (!status && context == LEXCONTEXT_STRING) {
+    result->tokens[result->count] = (LexToken_t) {.offset = size, .type = TOK_ERROR};
+    status = Lexer_internSpan(&result->tokens[result->count++], source);
+  }
+  if (!status)
+    result->tokens[result->count++] = (LexToken_t) {.offset = size, .type = TOK_ENDFILE};
+
+  for (int i = 0; i < count; i++)
+    free(chunks[i].tokens);
+
+  if (status) {
+    ParLex_free(result);
+    return -1;
+  }
+
+  return 0;
+}
+
+
+int ParLex_chunksFor(size_t size, int threads) {
+
+  size_t most = size / PARLEX_MIN_CHUNK;
+  if (threads > PARLEX_MAX_THREADS)
+    threads = PARLEX_MAX_THREADS;
+  if ((size_t)threads > most)
+    threads = (int)most;
+
+  return threads > 0 ? threads : 1;
+}
+
+
+void ParLex_free(ParLex_t *result) {
+
+  if (!result)
+    return;
+
+  free(result->tokens);
+  result->tokens = NULL;
+  result->count = 0;
+}
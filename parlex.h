@@ -0,0 +1,96 @@
+/*
+ * CMPT 399 (Winter 2016)
+ * Assignment 4: Code Generation
+ * Author: Derrick Gold
+ *
+ * Parallel Scanner API
+ *
+ * Tokenizes a source held in memory with several threads at once.
+ * The source is split into chunks at line breaks, and each chunk is
+ * scanned by a thread of its own on the guess that it starts outside
+ * of any comment or string. Line breaks following a ';' are preferred,
+ * as they end a statement far more often than they are in a comment.
+ *
+ * Once all chunks are scanned, the guesses are checked in order: a
+ * chunk's true starting context is the context the chunk before it
+ * ended in. A chunk that actually starts within a comment is scanned
+ * again from the nesting depth it starts at. One that starts within
+ * an unterminated string is dropped, along with every chunk after it,
+ * since the string runs to the end of the source.
+ *
+ * The tokens of the chunks are then joined into one array, in source
+ * order, exactly as a single scanner would have produced them.
+ */
+#ifndef __PARLEX_H__
+#define __PARLEX_H__
+
+#include <stddef.h>
+
+#include "lexer.h"
+
+//most threads a source is scanned with
+#define PARLEX_MAX_THREADS 64
+
+//smallest chunk worth scanning on a thread of its own
+#define PARLEX_MIN_CHUNK (64 * 1024)
+
+//bytes searched for a statement's end to split the source at
+#define PARLEX_SPLIT_WINDOW 4096
+
+typedef struct ParLexStats_s {
+  size_t chunks;    //chunks the source was split into
+  size_t repaired;  //chunks scanned again since they began in a comment
+  size_t dropped;   //chunks within an unterminated string
+} ParLexStats_t;
+
+typedef struct ParLex_s {
+  //tokens of the source in order, the last one being
+  //TOK_ENDFILE, with their lexemes interned
+  LexToken_t *tokens;
+  size_t count;
+
+  ParLexStats_t stats;
+} ParLex_t;
+
+/*
+ * ParLex_scan:
+ *  Tokenize a source with several threads. Lexemes are interned in
+ *  the intern pool of the calling thread, as Lexer_getToken would.
+ *
+ * Arguments:
+ *  result: Where to store the tokens of the source.
+ *  source: Contents of the source, which are not modified.
+ *  size: Size of the source in bytes.
+ *  threads: Number of chunks to split the source into, each scanned
+ *    by a thread of its own. At most PARLEX_MAX_THREADS, fewer chunks
+ *    are used if the source doesn't have enough line breaks.
+ *
+ * Returns:
+ *  0 on success, -1 on error.
+ */
+int ParLex_scan(ParLex_t *result, const char *source, size_t size, int threads);
+
+/*
+ * ParLex_chunksFor:
+ *  Get the number of threads worth using for a source, so that no
+ *  chunk is smaller than PARLEX_MIN_CHUNK.
+ *
+ * Arguments:
+ *  size: Size of the source in bytes.
+ *  threads: Most threads that may be used.
+ *
+ * Returns:
+ *  Number of threads to scan the source with, at least 1.
+ */
+int ParLex_chunksFor(size_t size, int threads);
+
+/*
+ * ParLex_free:
+ *  Free the tokens of a scanned source.
+ *
+ * Arguments:
+ *  result: The tokens to free.
+ */
+void ParLex_free(ParLex_t *result);
+
+#endif //__PARLEX_H__
@@ -28,7 +28,7 @@ s * Author: Derrick Gold
   TreeNode_printNode(stderr, node1, false);  \
 } while (0)
 
-#define PARSER_ERR_MSG fprintf(stderr, "%s\n", Parser_getErrorStr())
+#define PARSER_ERR_MSG fprintf(stderr, "%s\n", Parser_getErrorStr(state))
 
 static const char *PARSER_STATUS_STRINGS[] = {
   "Parser still in progress.",
@@ -39,20 +39,15 @@ static const char *PARSER_STATUS_STRINGS[] = {
   "Parser stopped: failed node allocation.",
   "Parser stopped: failed to add sibling node.",
   "Parser stopped: failed to add child node.",
+  "Parser stopped: streamed statement failed.",
 };
 
-//set status to in progress by default
-static ParseStatus errors = PARSE_INPROGRESS;
-
-static TreeNode_t *theTree = NULL;
-
-
 /*
  * Public accessor for the abstract syntax tree built
  * by the parser.
  */
-TreeNode_t *Parser_getTree(void) {
-  return theTree;
+TreeNode_t *Parser_getTree(ParserState_t *state) {
+  return state->tree;
 } 
 
 /*
@@ -61,15 +56,15 @@ TreeNode_t *Parser_getTree(void) {
  * of the %syntax error directive.
  *
  */
-ParseStatus Parser_getStatus(void) {
-  return errors;
+ParseStatus Parser_getStatus(ParserState_t *state) {
+  return state->status;
 }
 
 /*
  * Returns true if the parser encountered an error.
  */
-bool Parser_hasError(void) {
-  ParseStatus status = Parser_getStatus();
+bool Parser_hasError(ParserState_t *state) {
+  ParseStatus status = Parser_getStatus(state);
   return !(status == PARSE_SUCCESS || status == PARSE_INPROGRESS);
 }
 
@@ -77,8 +72,8 @@ bool Parser_hasError(void) {
  * Returns a message based on the current parser status.
  * Statuses include success as well as errors.
  */
-const char *Parser_getErrorStr(void) {
-  return PARSER_STATUS_STRINGS[Parser_getStatus()];
+const char *Parser_getErrorStr(ParserState_t *state) {
+  return PARSER_STATUS_STRINGS[Parser_getStatus(state)];
 }
 
 
@@ -87,16 +82,16 @@ const char *Parser_getErrorStr(void) {
  * Wrapper functions to catch tree library errors and
  * report them appropriately.
  */
-static TreeNode_t *parser_mkNode(NodeType type, LexToken_t *token) {
+static TreeNode_t *parser_mkNode(ParserState_t *state, NodeType type, LexToken_t *token) {
 
   //exit if errors already exist
-  if (Parser_hasError())
+  if (Parser_hasError(state))
     return NULL;
 
   TreeNode_t *newNode = TreeNode_newNode(type, token);
   if (!newNode) {
     //set parser error
-    errors = NODE_ALLOC_ERR;
+    state->status = NODE_ALLOC_ERR;
     PARSER_ERR_MSG;
     return NULL;
   }
@@ -104,29 +99,29 @@ static TreeNode_t *parser_mkNode(NodeType type, LexToken_t *token) {
   return newNode;
 }
 
-static void parser_addSibling(TreeNode_t *node, TreeNode_t *newSib) {
+static void parser_addSibling(ParserState_t *state, TreeNode_t *node, TreeNode_t *newSib) {
 
   //exit if errors already exist
-  if (Parser_hasError())
+  if (Parser_hasError(state))
     return;
 
   if (!TreeNode_addSibling(node, newSib)) {
-    errors = NODE_SIB_ERR;
+    state->status = NODE_SIB_ERR;
     NODE_DBG_MSG(node, newSib);
     PARSER_ERR_MSG;
   }
   
 }
 
-static void parser_addChild(TreeNode_t *parent, TreeNode_t *child, int slot) {
+static void parser_addChild(ParserState_t *state, TreeNode_t *parent, TreeNode_t *child, int slot) {
 
   //exit if errors already exist
-  if (Parser_hasError())
+  if (Parser_hasError(state))
     return;
 
   //if (!TreeNode_addChild(parent, child)) {
   if (!TreeNode_setChild(parent, child, slot)) {
-    errors = NODE_CHILD_ERR;
+    state->status = NODE_CHILD_ERR;
     NODE_DBG_MSG(parent, child);
     PARSER_ERR_MSG;
   }
@@ -134,22 +129,79 @@ static void parser_addChild(TreeNode_t *parent, TreeNode_t *child, int slot) {
 }
 
 
+/*
+ * Streaming helpers. When the parse isn't streamed, nodes are
+ * kept in the tree and these do nothing.
+ */
+
+//hand a node over to the stream
+static void parser_stream(ParserState_t *state, StreamEvent event, TreeNode_t *node) {
+
+  //exit if errors already exist
+  if (Parser_hasError(state) || !state->stream || !node)
+    return;
+
+  //whoever receives the node reports why it failed
+  if (state->stream(event, node, state->streamData))
+    state->status = PARSE_STREAMERR;
+}
 
+static int parser_freeNode(int depth, TreeNode_t *node, void *data) {
+
+  ParserState_t *state = data;
+  LexToken_t *token = TreeNode_getToken(node);
+  if (token)
+    Lexer_recycleToken(state->scanner, token);
+
+  TreeNode_free(node);
+  return 0;
+}
+
+//free a subtree that was streamed, along with its tokens
+static void parser_release(ParserState_t *state, TreeNode_t *node) {
+
+  if (state->stream && node)
+    TreeNode_traverse(0, node, state, NULL, parser_freeNode);
+}
+
+//hand a statement over to the stream then free it, leaving null
+//statements for the statement they belong to
+static TreeNode_t *parser_streamStmt(ParserState_t *state, TreeNode_t *node) {
+
+  if (!state->stream || !node || TreeNode_hasType(node, NULL_STMT))
+    return node;
+
+  parser_stream(state, STREAM_STMT, node);
+  parser_release(state, node);
+  return NULL;
+}
 
  
 } //end of %include
 
 %start_symbol   program
 
+//each parse keeps its own state, see ParserState_t
+%extra_argument   { ParserState_t *state }
+
+//grow the parser stack as needed instead of limiting how deeply
+//expressions can be nested
+%stack_size       0
+
 %default_type     { TreeNode_t * }/* for non-terminals */
 %token_type       { LexToken_t * }/* for a token's attributes */
 
-%default_destructor       {
-  TreeNode_destroy($$);
-}
-
+/*
+ * Nodes are allocated from the compilation arena, which releases
+ * them all at once when the compilation is done. So no destructor
+ * is needed for them.
+ *
+ * Tokens that are not stored in a node (punctuation, keywords)
+ * are destructed by lemon once their production is reduced. Their
+ * storage is handed back to the lexer for the next tokens.
+ */
 %token_destructor {
-  Lexer_tokenDestructor($$);
+  Lexer_recycleToken(state->scanner, $$);
 }
 
 /*
@@ -160,11 +212,11 @@ static void parser_addChild(TreeNode_t *parent, TreeNode_t *child, int slot) {
  * into it by flex.
  */
 %destructor TOK_ERROR {
-  Lexer_tokenDestructor($$);
+  Lexer_recycleToken(state->scanner, $$);
 }
 
 %destructor TOK_SYSERR {
-  Lexer_tokenDestructor($$);
+  Lexer_recycleToken(state->scanner, $$);
 }
 
 /*
@@ -185,8 +237,12 @@ static void parser_addChild(TreeNode_t *parent, TreeNode_t *child, int slot) {
  *
  */
 %syntax_error {
+  //a streamed statement failed on this token, and said why
+  if (state->status == PARSE_STREAMERR)
+    return;
+
   //set the parser status
-  errors = PARSE_SYNTAXERR;
+  state->status = PARSE_SYNTAXERR;
 
   //get the current token that lemon was working on
   LexToken_t *tok = TOKEN;
@@ -239,23 +295,24 @@ static void parser_addChild(TreeNode_t *parent, TreeNode_t *child, int slot) {
   //lemon code will continue on from here
 } //end of syntax error
 
-//set parser status as stack overflow
+//set parser status as stack overflow, only happens if
+//the parser stack can't be grown any further
 %stack_overflow {
-  errors = PARSE_STACKOFERR;
+  state->status = PARSE_STACKOFERR;
 }
 
 //set parser status as fully done
 %parse_accept {
   //successfully parsed all tokens
-  errors = PARSE_SUCCESS;
+  state->status = PARSE_SUCCESS;
 }
 
 %parse_failure {
-  errors = PARSE_FAILED;  
+  state->status = PARSE_FAILED;  
 }
 
 program ::= block(A) TOK_PERIOD. {
-  theTree = A;
+  state->tree = A;
 }
 
 
@@ -264,8 +321,14 @@ program ::= block(A) TOK_PERIOD. {
  * Statement list can be either one or more statements.
  */
 statement_list(A) ::= statement(B). {
-  A = parser_mkNode(STMT_LIST, NULL);
-  parser_addChild(A, B, 0);
+  //streamed statements are already done with
+  if (state->stream) {
+    A = NULL;
+    parser_release(state, B);
+  } else {
+    A = parser_mkNode(state, STMT_LIST, NULL);
+    parser_addChild(state, A, B, 0);
+  }
 }
 
 
@@ -275,7 +338,10 @@ statement_list(A) ::= statement(B). {
  */
 statement_list(A) ::= statement_list(B) TOK_SEMICOLON statement(C). {
   A = B;                 
-  parser_addSibling(A->child[0], C);
+  if (state->stream)
+    parser_release(state, C);
+  else
+    parser_addSibling(state, TreeNode_getChild(A, 0), C);
 }
 
 /*
@@ -287,16 +353,21 @@ statement(A) ::= block(B). {
 }
 
 statement(A) ::= . {
-  A = parser_mkNode(NULL_STMT, NULL);
+  A = parser_mkNode(state, NULL_STMT, NULL);
 }
 
 statement(A) ::= assign_statement(B). {
-  A = B;
+  A = parser_streamStmt(state, B);
 }
 
 
 statement(A) ::= case_statement(B) TOK_KEY_END. {
   A = B;
+  parser_stream(state, STREAM_CASE_END, A);
+  if (state->stream) {
+    parser_release(state, A);
+    A = NULL;
+  }
 }
 
 statement(A) ::= if_statement(B). {
@@ -308,11 +379,11 @@ statement(A) ::= while_statement(B). {
 }
 
 statement(A) ::= write_statement(B). {
-  A = B;
+  A = parser_streamStmt(state, B);
 }
 
 statement(A) ::= read_statement(B). {
-  A = B;
+  A = parser_streamStmt(state, B);
 }
 
 
@@ -322,17 +393,37 @@ statement(A) ::= read_statement(B). {
  */
 
 //constant section, variable section
-block(A) ::= const_section(B) var_section(C) TOK_KEY_BEGIN statement_list(D) TOK_KEY_END. {
-  A = parser_mkNode(BLOCK, NULL);
+block(A) ::= block_head(B) statement_list(D) TOK_KEY_END. {
+  A = B;
+
+  if (state->stream) {
+    parser_stream(state, STREAM_BLOCK_END, A);
+    parser_release(state, A);
+    A = NULL;
+  } else
+    parser_addChild(state, A, D, 2);
+}
+
+/*
+ * A block's declarations are known by the time its statements
+ * start, so they can be handed over on their own.
+ */
+block_head(A) ::= const_section(B) var_section(C) TOK_KEY_BEGIN. {
+  A = parser_mkNode(state, BLOCK, NULL);
   TreeNode_addType(A, BLOCK_STMT);
   
   if (B)
-    parser_addChild(A, B, 0);
+    parser_addChild(state, A, B, 0);
     
   if (C)
-    parser_addChild(A, C, 1);
-    
-  parser_addChild(A, D, 2);
+    parser_addChild(state, A, C, 1);
+
+  //the declarations are in the symbol table once streamed
+  parser_stream(state, STREAM_BLOCK, A);
+  if (state->stream) {
+    parser_release(state, TreeNode_removeChild(A, 0));
+    parser_release(state, TreeNode_removeChild(A, 1));
+  }
 }
 
 /* Assignment statements
@@ -343,68 +434,131 @@ block(A) ::= const_section(B) var_section(C) TOK_KEY_BEGIN statement_list(D) TOK
  * ambigiously typed identifiers.
  */
 assign_statement(A) ::= simple_name(B) TOK_ASSIGN expression(C). {
-  A = parser_mkNode(ASSIGN_STMT, NULL);
-  parser_addChild(A, B, 0);
-  parser_addChild(A, C, 1);
+  A = parser_mkNode(state, ASSIGN_STMT, NULL);
+  parser_addChild(state, A, B, 0);
+  parser_addChild(state, A, C, 1);
 }
 
 assign_statement(A) ::= variable(B) TOK_ASSIGN(D) expression(C). {
-  A = parser_mkNode(ASSIGN_STMT, D);
-  parser_addChild(A, B, 0);
-  parser_addChild(A, C, 1);
+  A = parser_mkNode(state, ASSIGN_STMT, D);
+  parser_addChild(state, A, B, 0);
+  parser_addChild(state, A, C, 1);
 }
 
 
+/*
+ * Statements holding other statements are split up where their
+ * nested statements start, so each part can be streamed as soon
+ * as it is reduced. When streamed, the nested statements are
+ * already done with (or are null statements) once the statement
+ * holding them is reduced.
+ */
+
+/*
+ * Each part ends with an empty rule after its keyword, so the keyword
+ * is shifted before the part is reduced rather than both at once.
+ * Syntax error suggestions only list tokens that are shifted.
+ */
+part_start ::= .
+
 /* Case Statements */
 //just case no else
-case_statement(A) ::= TOK_KEY_CASE expression(B) TOK_KEY_OF case_list(C). {
-  A = parser_mkNode(CASE_STMT, NULL);
-  parser_addChild(A, B, 0);
-  parser_addChild(A, C, 1);
+case_statement(A) ::= case_head(B) case_list(C). {
+  A = B;
+  parser_addChild(state, A, C, 1);
 }
 
 //case else
-case_statement(A) ::= case_statement(B) TOK_KEY_ELSE statement(C). {
+case_statement(A) ::= case_else(B) statement(C). {
   A = B;
-  parser_addChild(A, C, 2);
+  //only the last else of a case is kept
+  parser_release(state, TreeNode_removeChild(A, 2));
+  if (C)
+    parser_addChild(state, A, C, 2);
+}
+
+case_head(A) ::= TOK_KEY_CASE expression(B) TOK_KEY_OF part_start. {
+  A = parser_mkNode(state, CASE_STMT, NULL);
+  parser_addChild(state, A, B, 0);
+  parser_stream(state, STREAM_CASE, A);
+}
+
+case_else(A) ::= case_statement(B) TOK_KEY_ELSE part_start. {
+  A = B;
+  parser_stream(state, STREAM_CASE_ELSE, A);
 }
 
 
 /* If statements */
-if_statement(A) ::= TOK_KEY_IF condition(B) TOK_KEY_THEN statement(C). {
-  A = parser_mkNode(IF_STMT, NULL);
-  parser_addChild(A, B, 0);
-  parser_addChild(A, C, 1);
-  
+if_statement(A) ::= if_head(B) statement(C). [TOK_KEY_IF] {
+  A = B;
+  if (C)
+    parser_addChild(state, A, C, 1);
+
+  parser_stream(state, STREAM_IF_END, A);
+  if (state->stream) {
+    parser_release(state, A);
+    A = NULL;
+  }
 }
 
 
-if_statement(A) ::= TOK_KEY_IF condition(B) TOK_KEY_THEN statement(C) TOK_KEY_ELSE statement(D). {
-  A = parser_mkNode(IF_STMT, NULL);
-  parser_addChild(A, B, 0);
-  parser_addChild(A, C, 1);
-  parser_addChild(A, D, 2);
+if_statement(A) ::= if_else(B) statement(D). {
+  A = B;
+  if (D)
+    parser_addChild(state, A, D, 2);
+
+  parser_stream(state, STREAM_IF_END, A);
+  if (state->stream) {
+    parser_release(state, A);
+    A = NULL;
+  }
+}
+
+if_head(A) ::= TOK_KEY_IF condition(B) TOK_KEY_THEN part_start. {
+  A = parser_mkNode(state, IF_STMT, NULL);
+  parser_addChild(state, A, B, 0);
+  parser_stream(state, STREAM_IF, A);
+}
+
+if_else(A) ::= if_head(B) statement(C) TOK_KEY_ELSE part_start. {
+  A = B;
+  if (C)
+    parser_addChild(state, A, C, 1);
+  parser_stream(state, STREAM_IF_ELSE, A);
 }
 
 
 /* While Statements */
-while_statement(A) ::= TOK_KEY_WHILE condition(B) TOK_KEY_DO statement(C). {
-  A = parser_mkNode(WHILE_STMT, NULL);
-  parser_addChild(A, B, 0);
-  parser_addChild(A, C, 1);
+while_statement(A) ::= while_head(B) statement(C). {
+  A = B;
+  if (C)
+    parser_addChild(state, A, C, 1);
+
+  parser_stream(state, STREAM_WHILE_END, A);
+  if (state->stream) {
+    parser_release(state, A);
+    A = NULL;
+  }
+}
+
+while_head(A) ::= TOK_KEY_WHILE condition(B) TOK_KEY_DO part_start. {
+  A = parser_mkNode(state, WHILE_STMT, NULL);
+  parser_addChild(state, A, B, 0);
+  parser_stream(state, STREAM_WHILE, A);
 }
 
 
 
 write_statement(A) ::= TOK_KEY_WRITE TOK_LPAREN exp_list(B) TOK_RPAREN. {
-  A = parser_mkNode(WRITE_STMT, NULL);
-  parser_addChild(A, B, 0);
+  A = parser_mkNode(state, WRITE_STMT, NULL);
+  parser_addChild(state, A, B, 0);
 }
 
 
 read_statement(A) ::= TOK_KEY_READ TOK_LPAREN variable_list(B) TOK_RPAREN. {
-  A = parser_mkNode(READ_STMT, NULL);
-  parser_addChild(A, B, 0);
+  A = parser_mkNode(state, READ_STMT, NULL);
+  parser_addChild(state, A, B, 0);
 }
 
 
@@ -414,7 +568,7 @@ exp_list(A) ::= expression(B). {
 
 exp_list(A) ::= exp_list(B) TOK_COMMA expression(C). {
   A = B;
-  parser_addSibling(A, C);
+  parser_addSibling(state, A, C);
 }
 
 /*
@@ -441,12 +595,12 @@ variable_list(A) ::= variable(B). {
 
 variable_list(A) ::= variable_list(B) TOK_COMMA variable(C). {
   A = B;
-  parser_addSibling(A, C);
+  parser_addSibling(state, A, C);
 }
 
 variable_list(A) ::= variable_list(B) TOK_COMMA simple_name(C). {
   A = B;
-  parser_addSibling(A, C);
+  parser_addSibling(state, A, C);
 }
 
 
@@ -455,14 +609,14 @@ variable_list(A) ::= variable_list(B) TOK_COMMA simple_name(C). {
 const_sec(A) ::= const_sec(C) const_decl(D). {
   A = C;
   if (A)
-    parser_addSibling(A->child[0], D);
+    parser_addSibling(state, TreeNode_getChild(A, 0), D);
 
 }
 
 const_sec(C) ::= TOK_KEY_CONST const_decl(D). {
 
-  C = parser_mkNode(CONST_SEC, NULL);
-  parser_addChild(C, D, 0);
+  C = parser_mkNode(state, CONST_SEC, NULL);
+  parser_addChild(state, C, D, 0);
 }
 
 const_section(A) ::= .{
@@ -475,16 +629,16 @@ const_section(A) ::= const_sec(B). {
 
 /* Constant Declarations */
 const_decl(A) ::= TOK_ID(B) TOK_ASSIGN TOK_NUM(D) TOK_SEMICOLON.{
-  A = parser_mkNode(CONST_DECL, NULL);
+  A = parser_mkNode(state, CONST_DECL, NULL);
 
-  parser_addChild(A, parser_mkNode(LITERAL, B), 0);
-  parser_addChild(A, parser_mkNode(LITERAL, D), 1);
+  parser_addChild(state, A, parser_mkNode(state, LITERAL, B), 0);
+  parser_addChild(state, A, parser_mkNode(state, LITERAL, D), 1);
 }
 
 const_decl(A) ::= TOK_ID(B) TOK_ASSIGN TOK_STR(D) TOK_SEMICOLON.{
-  A = parser_mkNode(CONST_DECL, NULL);
-  parser_addChild(A, parser_mkNode(LITERAL, B), 0);
-  parser_addChild(A, parser_mkNode(STRING, D), 1);
+  A = parser_mkNode(state, CONST_DECL, NULL);
+  parser_addChild(state, A, parser_mkNode(state, LITERAL, B), 0);
+  parser_addChild(state, A, parser_mkNode(state, STRING, D), 1);
 }
 
 
@@ -495,23 +649,23 @@ constant(A) ::= simple_name(B). {
 }
 
 constant(A) ::= TOK_NUM(B). {
-  A = parser_mkNode(CONSTANT, B); 
+  A = parser_mkNode(state, CONSTANT, B); 
 }
 
 constant(A) ::= TOK_STR(B). {
-  A = parser_mkNode(CONSTANT, B); 
+  A = parser_mkNode(state, CONSTANT, B); 
 }
 
 
 var_sec(A) ::= var_sec(B) var_decl(C). {
   A = B;
   if (A)
-    parser_addSibling(A->child[0], C);
+    parser_addSibling(state, TreeNode_getChild(A, 0), C);
 }
 
 var_sec(A) ::= TOK_KEY_VAR var_decl(C). {
-  A = parser_mkNode(VAR_SEC, NULL);
-  parser_addChild(A, C, 0);
+  A = parser_mkNode(state, VAR_SEC, NULL);
+  parser_addChild(state, A, C, 0);
 }
 
 
@@ -526,7 +680,7 @@ var_section(A) ::= . {
 /* Variable declaration */
 var_decl(A) ::= var_list(B) TOK_COLON TOK_KEY_ARRAY TOK_LPAREN constant(C) TOK_RPAREN TOK_KEY_OF TOK_KEY_INTEGER TOK_SEMICOLON. {
   A = B;
-  parser_addChild(A, C, 1);
+  parser_addChild(state, A, C, 1);
   TreeNode_addType(C, ARRAY);
   TreeNode_addType(C, TYPE);
   TreeNode_addType(C, INTEGER);
@@ -536,24 +690,24 @@ var_decl(A) ::= var_list(B) TOK_COLON TOK_KEY_ARRAY TOK_LPAREN constant(C) TOK_R
 var_decl(A) ::= var_list(B) TOK_COLON TOK_KEY_INTEGER(C) TOK_SEMICOLON. {
   A = B;
   
-  TreeNode_t *child = parser_mkNode(TYPE, C);
+  TreeNode_t *child = parser_mkNode(state, TYPE, C);
   TreeNode_addType(child, INTEGER);
   
-  parser_addChild(A, child, 1);
+  parser_addChild(state, A, child, 1);
   TreeNode_addType(A, VAR_DECL);
 }
 
 
 /* Variable listing */
 var_list(A) ::= TOK_ID(B). {
-  A = parser_mkNode(VAR_LIST, NULL);
-  parser_addChild(A, parser_mkNode(LITERAL, B), 0);
+  A = parser_mkNode(state, VAR_LIST, NULL);
+  parser_addChild(state, A, parser_mkNode(state, LITERAL, B), 0);
 }
 
 var_list(A) ::= var_list(B) TOK_COMMA TOK_ID(C). {
   A = B;
   if (A)
-    parser_addSibling(A->child[0], parser_mkNode(LITERAL, C));
+    parser_addSibling(state, TreeNode_getChild(A, 0), parser_mkNode(state, LITERAL, C));
 }
 
 
@@ -565,8 +719,8 @@ expression(A) ::= simple_expression(B). {
 expression(A) ::= simple_expression(B) relational_operator(C) simple_expression(D). {
   A = C;
   TreeNode_addType(A, EXP);
-  parser_addChild(A, B, 0);
-  parser_addChild(A, D, 1);
+  parser_addChild(state, A, B, 0);
+  parser_addChild(state, A, D, 1);
 }
 
 
@@ -574,14 +728,14 @@ expression(A) ::= simple_expression(B) relational_operator(C) simple_expression(
 simple_expression(A) ::= simple_expression(B) binary_adding_operator(C) term(D). {
   A = C;
   TreeNode_addType(A, SIMPEXP);
-  parser_addChild(A, B, 0);
-  parser_addChild(A, D, 1);
+  parser_addChild(state, A, B, 0);
+  parser_addChild(state, A, D, 1);
 }
 
 simple_expression(A) ::= unary_operator(B) term(C). {
   A = B;
   //TreeNode_addType(A, SIMPEXP);
-  parser_addChild(B, C, 0);
+  parser_addChild(state, B, C, 0);
 }
 
 simple_expression(A) ::= term(B). {
@@ -594,8 +748,8 @@ simple_expression(A) ::= term(B). {
 term(A) ::= term(B) multiply_operator(C) factor(D). {
   A = C;
   TreeNode_addType(A, TERM);
-  parser_addChild(A, B, 0);
-  parser_addChild(A, D, 1);
+  parser_addChild(state, A, B, 0);
+  parser_addChild(state, A, D, 1);
 }
 
 term(A) ::= factor(B). {
@@ -620,7 +774,11 @@ factor(A) ::= variable(B). {
 
 factor(A) ::= TOK_KEY_NOT factor(C). {
   A = C;
-  TreeNode_addType(A, NOT);
+  //a 'not' of a 'not' cancels out
+  if (TreeNode_hasType(A, NOT))
+    TreeNode_rmType(A, NOT);
+  else
+    TreeNode_addType(A, NOT);
 }
 
 factor(A) ::= TOK_LPAREN expression(B) TOK_RPAREN. {
@@ -634,48 +792,57 @@ factor(A) ::= TOK_LPAREN expression(B) TOK_RPAREN. {
 variable(A) ::= simple_name(B) TOK_LPAREN expression(C) TOK_RPAREN. {
   A = B;
   TreeNode_addType(B, VARIABLE);
-  parser_addChild(B, C, 0);
+  parser_addChild(state, B, C, 0);
 }
 
 
 simple_name(A) ::= TOK_ID(B). {
-  A = parser_mkNode(SIMP_NAME, B);
+  A = parser_mkNode(state, SIMP_NAME, B);
 }
 
 
 
 case_list(A) ::= case(B). {
-  //A = parser_mkNode(CASE_LIST, NULL);
-  //parser_addChild(A, B, 0);
+  //A = parser_mkNode(state, CASE_LIST, NULL);
+  //parser_addChild(state, A, B, 0);
   A = B;
   TreeNode_addType(B, CASE_LIST);
 }
 
 case_list(A) ::= case_list(B) TOK_SEMICOLON case(C). {
   A = B;
-  parser_addSibling(A, C);
+  parser_addSibling(state, A, C);
 }
 
 
-case(A) ::= const_list(B) TOK_COLON statement(C). {
-  A = parser_mkNode(CASE, NULL);
-  if (A) {
-    parser_addChild(A, B, 0);
-    parser_addChild(A, C, 1);
-  }
+case(A) ::= case_label(B) statement(C). {
+  A = B;
+  //a streamed case only keeps its constants, for the dispatch
+  if (state->stream) {
+    parser_stream(state, STREAM_CASE_ARM_END, A);
+    parser_release(state, C);
+  } else if (A)
+    parser_addChild(state, A, C, 1);
+}
+
+case_label(A) ::= const_list(B) TOK_COLON part_start. {
+  A = parser_mkNode(state, CASE, NULL);
+  if (A)
+    parser_addChild(state, A, B, 0);
+  parser_stream(state, STREAM_CASE_ARM, A);
 }
 
 
 const_list(A) ::= constant(B). {
-  //A = parser_mkNode(CONST_LIST, NULL);
-  //parser_addChild(A, B, 0);
+  //A = parser_mkNode(state, CONST_LIST, NULL);
+  //parser_addChild(state, A, B, 0);
   A = B;
   TreeNode_addType(B, CONST_LIST);
 }
 
 const_list(A) ::= const_list(B) TOK_COMMA constant(C). {
   A = B;
-  parser_addSibling(A, C);
+  parser_addSibling(state, A, C);
 }
 
 
@@ -687,77 +854,77 @@ condition(A) ::= expression(B). {
 
 /* Operators for expressions */
 relational_operator(A) ::= TOK_EQ(B). {
-  A = parser_mkNode(RELOP, B);
+  A = parser_mkNode(state, RELOP, B);
 }
 
 relational_operator(A) ::= TOK_NOTEQ(B). {
-  A = parser_mkNode(RELOP, B);
+  A = parser_mkNode(state, RELOP, B);
 }
 
 relational_operator(A) ::= TOK_LESS(B). {
-  A = parser_mkNode(RELOP, B);
+  A = parser_mkNode(state, RELOP, B);
 }
 
 relational_operator(A) ::= TOK_GREATER(B). {
-  A = parser_mkNode(RELOP, B);
+  A = parser_mkNode(state, RELOP, B);
 }
 
 relational_operator(A) ::= TOK_LTEQ(B). {
-  A = parser_mkNode(RELOP, B);
+  A = parser_mkNode(state, RELOP, B);
 }
 
 relational_operator(A) ::= TOK_GTEQ(B). {
-  A = parser_mkNode(RELOP, B);
+  A = parser_mkNode(state, RELOP, B);
 }
 
 
 
 /* Operators for simple expressions */
 binary_adding_operator(A) ::= TOK_PLUS(B). {
-  A = parser_mkNode(BINOP, B);                           
+  A = parser_mkNode(state, BINOP, B);                           
 }
 
 binary_adding_operator(A) ::= TOK_MINUS(B). {
-  A = parser_mkNode(BINOP, B);                           
+  A = parser_mkNode(state, BINOP, B);                           
 }
 
 binary_adding_operator(A) ::= TOK_KEY_OR(B). {
-  A = parser_mkNode(BINOP, B);                          
+  A = parser_mkNode(state, BINOP, B);                          
 }
 
 
 unary_operator(A) ::= TOK_PLUS(B). {
-  A = parser_mkNode(UNARYOP, B);
+  A = parser_mkNode(state, UNARYOP, B);
 }
 
 unary_operator(A) ::= TOK_MINUS(B). {
-  A = parser_mkNode(UNARYOP, B);
+  A = parser_mkNode(state, UNARYOP, B);
 }
 
 
 
 /* Operators for terms */
 multiply_operator(A) ::= TOK_STAR(B). {
-  A = parser_mkNode(MULOP, B);
+  A = parser_mkNode(state, MULOP, B);
 }
 
 multiply_operator(A) ::= TOK_KEY_DIV(B). {
-  A = parser_mkNode(MULOP, B);
+  A = parser_mkNode(state, MULOP, B);
 }
 
 multiply_operator(A) ::= TOK_KEY_MOD(B). {
-  A = parser_mkNode(MULOP, B);
+  A = parser_mkNode(state, MULOP, B);
 }
 
 multiply_operator(A) ::= TOK_KEY_AND(B). {
-  A = parser_mkNode(MULOP, B);
+  A = parser_mkNode(state, MULOP, B);
 }
 
 multiply_operator(A) ::= TOK_KEY_SHR(B). {
-  A = parser_mkNode(MULOP, B);
+  A = parser_mkNode(state, MULOP, B);
 }
 
 multiply_operator(A) ::= TOK_KEY_SHL(B). {
-  A = parser_mkNode(MULOP, B);
+  A = parser_mkNode(state, MULOP, B);
 }
 
@@ -10,6 +10,7 @@
 #define __PARSERHELPER__H_
 
 #include "lexer.h"
+#include "tree.h"
 
 /*
  * Various statuses the parser can return, indicating
@@ -24,8 +25,72 @@ typedef enum {
   NODE_ALLOC_ERR,
   NODE_SIB_ERR,
   NODE_CHILD_ERR,
+  PARSE_STREAMERR,
 } ParseStatus;
 
+/*
+ * Points at which a streamed parse hands its nodes over (see
+ * ParserState_t). Statements that hold other statements are handed
+ * over in parts, each part as soon as it is reduced, so the statements
+ * inside them are handed over in between:
+ *
+ *  STREAM_BLOCK       block node, with its const and var sections
+ *  STREAM_BLOCK_END   the same block node, once its statements are done
+ *  STREAM_STMT        assignment, read or write statement
+ *  STREAM_IF          if statement node, with its condition
+ *  STREAM_IF_ELSE     the same if node, before its else statement
+ *  STREAM_IF_END      the same if node, with its null statements
+ *  STREAM_WHILE       while statement node, with its condition
+ *  STREAM_WHILE_END   the same while node
+ *  STREAM_CASE        case statement node, with its expression
+ *  STREAM_CASE_ARM    case node, with its constants
+ *  STREAM_CASE_ARM_END  the same case node, once its statement is done
+ *  STREAM_CASE_ELSE   case statement node, before its else statement
+ *  STREAM_CASE_END    the same case statement node, with its cases
+ *
+ * Null statements are not handed over on their own, but are kept
+ * in the statement they belong to.
+ */
+typedef enum {
+  STREAM_BLOCK,
+  STREAM_BLOCK_END,
+  STREAM_STMT,
+  STREAM_IF,
+  STREAM_IF_ELSE,
+  STREAM_IF_END,
+  STREAM_WHILE,
+  STREAM_WHILE_END,
+  STREAM_CASE,
+  STREAM_CASE_ARM,
+  STREAM_CASE_ARM_END,
+  STREAM_CASE_ELSE,
+  STREAM_CASE_END,
+} StreamEvent;
+
+/*
+ * Receives the nodes of a streamed parse. Returns 0 to keep parsing,
+ * anything else stops the parse.
+ */
+typedef int (*ParserStream_t)(StreamEvent event, TreeNode_t *node, void *data);
+
+/*
+ * State of a single parse, passed to lemon as its
+ * extra argument.
+ */
+typedef struct ParserState_s {
+  ParseStatus status;
+  //root of the abstract syntax tree once parsed
+  TreeNode_t *tree;
+  //scanner the tokens come from, tokens released by
+  //the parser are handed back to it
+  void *scanner;
+
+  //when set, statements are handed to this as soon as they are
+  //reduced then freed, instead of building the whole program's tree
+  ParserStream_t stream;
+  void *streamData;
+} ParserState_t;
+
 
 /*
  * ParseAlloc:
@@ -61,44 +126,57 @@ extern void ParseFree(void *p, void (*fn)(void*));
  *      yymajor: Token type as defined in the 'parser.h' file.
  *      data: Associated data with token type. In this program's case,
  *              a pointer to a LexToken_t structure.
+ *      state: State of the parse the token belongs to.
  */
-extern void Parse(void *yyp, int yymajor, LexToken_t *data);
+extern void Parse(void *yyp, int yymajor, LexToken_t *data, ParserState_t *state);
 
 /*
  * Parser_getTree:
  *      Get the abstract syntax tree created by the parser.
  *
+ * Arguments:
+ *      state: State of the parse.
+ *
  * Returns:
  *      A TreeNode_t pointer to the root of the abstract syntax
  *      tree.
  */
-extern TreeNode_t *Parser_getTree(void);
+extern TreeNode_t *Parser_getTree(ParserState_t *state);
 
 /*
  * Parser_getStatus:
  *      Get the current state of the parser.
  *
+ * Arguments:
+ *      state: State of the parse.
+ *
  * Returns:
  *      Returns a status defined by the ParseStatus enum.
  */
-extern ParseStatus Parser_getStatus(void);
+extern ParseStatus Parser_getStatus(ParserState_t *state);
 
 /*
  * Parser_hasError:
  *      Determines if the parser has encountered an error.
  *
+ * Arguments:
+ *      state: State of the parse.
+ *
  * Returns:
  *      True if an error occurred, false otherwise.
  */
-extern bool Parser_hasError(void);
+extern bool Parser_hasError(ParserState_t *state);
 
 /*
  * Parser_getErrorStr:
  *      Get an error message based on the parser's status.
  *
+ * Arguments:
+ *      state: State of the parse.
+ *
  * Returns:
  *      Pointer to error message string array.
  */
-extern const char *Parser_getErrorStr(void);
+extern const char *Parser_getErrorStr(ParserState_t *state);
 
 #endif //__PARSERHELPER__H_
@@ -332,7 +332,7 @@ void SyntaxErr_printMsg(FILE *output, LexToken_t *unexpected, char *tokList, Syn
     return;
   }
   //get line number
-  int lineno = unexpected->line;
+  int lineno = Lexer_tokenLine(*unexpected);
 
   //get the type string for the unexpected token
   const char *unexpectedType = LEXER_TOKEN_STRINGS[unexpected->type];
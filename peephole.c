@@ -0,0 +1,639 @@
+/*
+ * CMPT 399 (Winter 2016)
+ * Assignment 4: Code Generation
+ * Author: Derrick Gold
+ *
+ * Peephole Optimizer API
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "peephole.h"
+
+//most instructions a rule matches, checks it makes, and operands it names
+#define PATTERN_MAX 3
+#define TESTS_MAX 4
+#define CAPTURE_MAX 4
+
+//instructions before one that was rewritten that are tried again
+#define RETRY_BEHIND 2
+
+//pattern of a label line rather than an instruction, labels in front
+//of it are skipped as they are at the same place
+#define PEEP_LABEL ":"
+//rewrite that leaves the matched line as it is
+#define PEEP_KEEP "="
+
+#define SIZE_PREFIX "DWORD "
+
+/*
+ * Registers by number, along with the names of their parts. Only the
+ * general registers (before ebp) are ever dead.
+ */
+#define PEEP_REGISTER_COUNT 8
+#define GENERAL_REGISTERS 6
+#define REGISTER_NAMES_MAX 4
+#define REG_EAX 0
+#define REG_ECX 2
+#define REG_EDX 3
+static const char *const REGISTER_NAMES[PEEP_REGISTER_COUNT][REGISTER_NAMES_MAX] = {
+  {"eax", "ax", "al", "ah"},
+  {"ebx", "bx", "bl", "bh"},
+  {"ecx", "cx", "cl", "ch"},
+  {"edx", "dx", "dl", "dh"},
+  {"esi", "si"},
+  {"edi", "di"},
+  {"ebp", "bp"},
+  {"esp", "sp"},
+};
+
+//what a rule needs of its operands, or of the code following it
+typedef enum {
+  IF_NONE = 0,
+  IF_REGISTER,   //operand 'a' is a general register
+  IF_DEAD,       //register 'a' isn't read again before it is written
+  IF_FLAGS_DEAD, //the flags aren't read again before they are set
+  IF_APART,      //operand 'b' uses none of the registers operand 'a' does
+  IF_OFF_STACK,  //operand 'a' isn't relative to the stack pointer
+} PeepholeTest;
+
+typedef struct PeepholeCheck_s {
+  PeepholeTest test;
+  int a, b;
+} PeepholeCheck_t;
+
+/*
+ * An instruction of a rule. Operands are matched as they are written,
+ * other than for the size in front of them, with "$n" standing for
+ * the same text wherever it is used.
+ */
+typedef struct PeepholeInsn_s {
+  const char *op;
+  const char *args[PEEPHOLE_ARGS_MAX];
+} PeepholeInsn_t;
+
+/*
+ * A rule: the instructions it matches, what each of them is rewritten
+ * to (no instruction deletes it), and the checks it needs to pass.
+ */
+typedef struct PeepholeRule_s {
+  const char *name;
+  PeepholeInsn_t match[PATTERN_MAX];
+  PeepholeInsn_t rewrite[PATTERN_MAX];
+  PeepholeCheck_t checks[TESTS_MAX];
+} PeepholeRule_t;
+
+static const PeepholeRule_t PEEPHOLE_RULES[PEEPHOLE_RULE_COUNT] = {
+  [PEEPHOLE_PUSH_POP_SAME] = {
+    .name = "push and pop of the same operand",
+    .match = {{"push", {"$0"}}, {"pop", {"$0"}}},
+    .checks = {{IF_OFF_STACK, 0}},
+  },
+  [PEEPHOLE_PUSH_POP] = {
+    .name = "push and pop into a register",
+    .match = {{"push", {"$0"}}, {"pop", {"$1"}}},
+    .rewrite = {{"mov", {"$1", "$0"}}},
+    .checks = {{IF_REGISTER, 1}, {IF_OFF_STACK, 0}},
+  },
+  [PEEPHOLE_LOAD_PUSH] = {
+    .name = "push of a value just loaded",
+    .match = {{"mov", {"$0", "$1"}}, {"push", {"$0"}}},
+    .rewrite = {{NULL}, {"push", {"$1"}}},
+    .checks = {{IF_REGISTER, 0}, {IF_DEAD, 0}, {IF_OFF_STACK, 1}},
+  },
+  [PEEPHOLE_ADDRESS_LOAD] = {
+    .name = "load through an address just taken",
+    .match = {{"lea", {"$0", "$1"}}, {"mov", {"$2", "[$0]"}}},
+    .rewrite = {{NULL}, {"mov", {"$2", "$1"}}},
+    .checks = {{IF_REGISTER, 0}, {IF_REGISTER, 2}, {IF_DEAD, 0}, {IF_APART, 0, 2}},
+  },
+  [PEEPHOLE_MOVE_BACK] = {
+    .name = "move back to where a value came from",
+    .match = {{"mov", {"$0", "$1"}}, {"mov", {"$1", "$0"}}},
+    .rewrite = {{PEEP_KEEP}},
+    .checks = {{IF_APART, 0, 1}},
+  },
+  [PEEPHOLE_UPDATE_ADD] = {
+    .name = "add through another register",
+    .match = {{"mov", {"$0", "$1"}}, {"add", {"$0", "$2"}}, {"mov", {"$1", "$0"}}},
+    .rewrite = {{NULL}, {"add", {"$1", "$2"}}},
+    .checks = {{IF_REGISTER, 0}, {IF_REGISTER, 1}, {IF_APART, 0, 2}, {IF_DEAD, 0}},
+  },
+  [PEEPHOLE_UPDATE_SUB] = {
+    .name = "subtract through another register",
+    .match = {{"mov", {"$0", "$1"}}, {"sub", {"$0", "$2"}}, {"mov", {"$1", "$0"}}},
+    .rewrite = {{NULL}, {"sub", {"$1", "$2"}}},
+    .checks = {{IF_REGISTER, 0}, {IF_REGISTER, 1}, {IF_APART, 0, 2}, {IF_DEAD, 0}},
+  },
+  [PEEPHOLE_CLEAR] = {
+    .name = "clear a register with xor",
+    .match = {{"mov", {"$0", "0"}}},
+    .rewrite = {{"xor", {"$0", "$0"}}},
+    .checks = {{IF_REGISTER, 0}, {IF_FLAGS_DEAD}},
+  },
+  [PEEPHOLE_ADD_ZERO] = {
+    .name = "add of 0",
+    .match = {{"add", {"$0", "0"}}},
+    .checks = {{IF_FLAGS_DEAD}},
+  },
+  [PEEPHOLE_SUB_ZERO] = {
+    .name = "subtract of 0",
+    .match = {{"sub", {"$0", "0"}}},
+    .checks = {{IF_FLAGS_DEAD}},
+  },
+  [PEEPHOLE_JUMP_NEXT] = {
+    .name = "jump to the next instruction",
+    .match = {{"jmp", {"$0"}}, {PEEP_LABEL, {"$0"}}},
+    .rewrite = {{NULL}, {PEEP_KEEP}},
+  },
+};
+
+//operands captured by a rule's "$n"
+typedef struct Captures_s {
+  char text[CAPTURE_MAX][PEEPHOLE_TEXT_LEN];
+  bool bound[CAPTURE_MAX];
+} Captures_t;
+
+static bool isFiller(const PeepholeLine_t *line) {
+
+  return !line->op[0] && !line->label[0];
+}
+
+static bool isLabelOnly(const PeepholeLine_t *line) {
+
+  return !line->op[0] && line->label[0];
+}
+
+//operand without the size in front of it
+static const char *bareOperand(const char *text) {
+
+  size_t length = strlen(SIZE_PREFIX);
+  return strncmp(text, SIZE_PREFIX, length) ? text : text + length;
+}
+
+//number of the register an operand is, -1 if it isn't one
+static int registerNumber(const char *text) {
+
+  for (int i = 0; i < PEEP_REGISTER_COUNT; i++) {
+    if (!strcmp(text, REGISTER_NAMES[i][0]))
+      return i;
+  }
+  return -1;
+}
+
+//whether an operand uses any part of a register
+static bool mentions(const char *text, int reg) {
+
+  const char *pos = text;
+  while (*pos) {
+    if (!isalnum((unsigned char)*pos)) {
+      pos++;
+      continue;
+    }
+
+    const char *start = pos;
+    while (isalnum((unsigned char)*pos) || *pos == '_')
+      pos++;
+
+    size_t length = pos - start;
+    for (int i = 0; i < REGISTER_NAMES_MAX && REGISTER_NAMES[reg][i]; i++) {
+      if (strlen(REGISTER_NAMES[reg][i]) == length && !strncmp(start, REGISTER_NAMES[reg][i], length))
+        return true;
+    }
+  }
+  return false;
+}
+
+static bool isJump(const char *op) {
+
+  return op[0] == 'j';
+}
+
+//instructions writing a whole register without reading it
+static bool isAssignment(const char *op) {
+
+  return !strcmp(op, "mov") || !strcmp(op, "lea") || !strcmp(op, "movzx") || !strcmp(op, "movsx");
+}
+
+static bool readsRegister(const PeepholeLine_t *line, int reg) {
+
+  const char *op = line->op;
+  //where a jump goes, and what is read there, isn't known
+  if (isJump(op))
+    return true;
+  if (!strcmp(op, "call"))
+    return false;
+  if (!strcmp(op, "ret"))
+    return reg != REG_ECX && reg != REG_EDX;
+  if (!strcmp(op, "cdq"))
+    return reg == REG_EAX;
+  if (line->argc == 1 && (!strcmp(op, "idiv") || !strcmp(op, "div") || !strcmp(op, "imul") || !strcmp(op, "mul")) &&
+      (reg == REG_EAX || reg == REG_EDX))
+    return true;
+  //clearing a register with itself doesn't depend on it
+  if (line->argc == 2 && (!strcmp(op, "xor") || !strcmp(op, "sub")) &&
+      !strcmp(line->args[0], line->args[1]) && registerNumber(line->args[0]) == reg)
+    return false;
+
+  for (int i = 0; i < line->argc; i++) {
+    const char *arg = bareOperand(line->args[i]);
+    //a whole register written to is not read, a part of it, or an address, is
+    if (i == 0 && (isAssignment(op) || !strcmp(op, "pop")) && registerNumber(arg) >= 0)
+      continue;
+    if (mentions(arg, reg))
+      return true;
+  }
+  return false;
+}
+
+//whether a line sets the whole register, read or not
+static bool writesRegister(const PeepholeLine_t *line, int reg) {
+
+  const char *op = line->op;
+  if (!strcmp(op, "call"))
+    return reg == REG_EAX || reg == REG_ECX || reg == REG_EDX;
+  if (!strcmp(op, "cdq"))
+    return reg == REG_EDX;
+  if (line->argc == 0 || registerNumber(bareOperand(line->args[0])) != reg)
+    return false;
+  if (isAssignment(op) || !strcmp(op, "pop"))
+    return true;
+  return line->argc == 2 && (!strcmp(op, "xor") || !strcmp(op, "sub")) &&
+    !strcmp(line->args[0], line->args[1]);
+}
+
+static bool readsFlags(const char *op) {
+
+  return (isJump(op) && strcmp(op, "jmp")) || !strncmp(op, "set", 3) || !strncmp(op, "cmov", 4) ||
+    !strcmp(op, "adc") || !strcmp(op, "sbb");
+}
+
+static bool writesFlags(const char *op) {
+
+  static const char *const WRITERS[] = {"cmp", "test", "add", "sub", "and", "or", "xor", "neg", "imul"};
+  for (size_t i = 0; i < sizeof(WRITERS) / sizeof(WRITERS[0]); i++) {
+    if (!strcmp(op, WRITERS[i]))
+      return true;
+  }
+  return false;
+}
+
+//whether a register is written before it is read from line 'from' on
+static bool deadFrom(Peephole_t *peephole, int from, int reg) {
+
+  if (reg < 0 || reg >= GENERAL_REGISTERS)
+    return false;
+
+  for (int i = from; i < peephole->count; i++) {
+    PeepholeLine_t *line = &peephole->lines[i];
+    if (line->boundary)
+      return !(line->live & (1u << reg));
+    if (!line->op[0])
+      continue;
+    if (readsRegister(line, reg))
+      return false;
+    if (writesRegister(line, reg))
+      return true;
+  }
+  return false;
+}
+
+static bool flagsDeadFrom(Peephole_t *peephole, int from) {
+
+  for (int i = from; i < peephole->count; i++) {
+    PeepholeLine_t *line = &peephole->lines[i];
+    if (line->boundary)
+      return true;
+    if (!line->op[0])
+      continue;
+    if (readsFlags(line->op) || !strcmp(line->op, "jmp"))
+      return false;
+    if (writesFlags(line->op) || !strcmp(line->op, "call") || !strcmp(line->op, "ret"))
+      return true;
+  }
+  return false;
+}
+
+/*
+ * Match an operand against a pattern, capturing the text its "$n"
+ * stand for. A capture runs up to the pattern's next character.
+ */
+static bool matchOperand(const char *pattern, const char *text, Captures_t *captures) {
+
+  text = bareOperand(text);
+  while (*pattern) {
+    if (pattern[0] != '$') {
+      if (*pattern++ != *text++)
+        return false;
+      continue;
+    }
+
+    int n = pattern[1] - '0';
+    pattern += 2;
+    const char *end = *pattern ? strchr(text, *pattern) : text + strlen(text);
+    if (!end || end == text || end - text >= PEEPHOLE_TEXT_LEN)
+      return false;
+
+    size_t length = end - text;
+    if (captures->bound[n]) {
+      if (strlen(captures->text[n]) != length || strncmp(captures->text[n], text, length))
+        return false;
+    } else {
+      memcpy(captures->text[n], text, length);
+      captures->text[n][length] = '\0';
+      captures->bound[n] = true;
+    }
+    text = end;
+  }
+
+  return !*text;
+}
+
+//fill a rewritten operand in from its pattern, false if it doesn't fit
+static bool expandOperand(const char *pattern, Captures_t *captures, char *output) {
+
+  size_t length = 0;
+  while (*pattern) {
+    const char *part = pattern;
+    size_t partLength = 1;
+    if (pattern[0] == '$') {
+      part = captures->text[pattern[1] - '0'];
+      partLength = strlen(part);
+      pattern += 2;
+    } else
+      pattern++;
+
+    if (length + partLength >= PEEPHOLE_TEXT_LEN)
+      return false;
+    memcpy(output + length, part, partLength);
+    length += partLength;
+  }
+
+  output[length] = '\0';
+  return true;
+}
+
+//index of the first line from 'from' on that isn't filler
+static int skipFiller(Peephole_t *peephole, int from) {
+
+  while (from < peephole->count && isFiller(&peephole->lines[from]))
+    from++;
+  return from;
+}
+
+/*
+ * Match a rule's instructions from line 'start', setting the lines
+ * they were matched in. The lines after the first can't be labelled.
+ */
+static bool matchRule(Peephole_t *peephole, const PeepholeRule_t *rule, int start,
+                      int *matched, int *count, Captures_t *captures) {
+
+  int next = start;
+  for (*count = 0; *count < PATTERN_MAX && rule->match[*count].op; (*count)++) {
+    const PeepholeInsn_t *insn = &rule->match[*count];
+    next = *count ? skipFiller(peephole, next) : next;
+
+    if (!strcmp(insn->op, PEEP_LABEL)) {
+      while (next < peephole->count && isLabelOnly(&peephole->lines[next]) &&
+             !matchOperand(insn->args[0], peephole->lines[next].label, captures))
+        next = skipFiller(peephole, next + 1);
+      if (next == peephole->count || !isLabelOnly(&peephole->lines[next]))
+        return false;
+
+      matched[*count] = next++;
+      continue;
+    }
+
+    if (next == peephole->count)
+      return false;
+    PeepholeLine_t *line = &peephole->lines[next];
+    if ((*count && line->label[0]) || strcmp(line->op, insn->op))
+      return false;
+
+    int argc = 0;
+    while (argc < PEEPHOLE_ARGS_MAX && insn->args[argc])
+      argc++;
+    if (line->argc != argc)
+      return false;
+    for (int i = 0; i < argc; i++) {
+      if (!matchOperand(insn->args[i], line->args[i], captures))
+        return false;
+    }
+
+    matched[*count] = next++;
+  }
+
+  return true;
+}
+
+static bool passesCheck(Peephole_t *peephole, const PeepholeCheck_t *check, int after, Captures_t *captures) {
+
+  const char *a = captures->text[check->a];
+  switch (check->test) {
+  case IF_REGISTER:
+    return registerNumber(a) >= 0 && registerNumber(a) < GENERAL_REGISTERS;
+  case IF_DEAD:
+    return deadFrom(peephole, after, registerNumber(a));
+  case IF_FLAGS_DEAD:
+    return flagsDeadFrom(peephole, after);
+  case IF_APART:
+    for (int reg = 0; reg < PEEP_REGISTER_COUNT; reg++) {
+      if (mentions(a, reg) && mentions(captures->text[check->b], reg))
+        return false;
+    }
+    return true;
+  case IF_OFF_STACK:
+    return !mentions(a, registerNumber("esp"));
+  default:
+    return true;
+  }
+}
+
+static void removeLine(Peephole_t *peephole, int index) {
+
+  PeepholeLine_t *line = &peephole->lines[index];
+  //keep the label of a labelled instruction
+  if (line->label[0]) {
+    line->op[0] = '\0';
+    line->comment[0] = '\0';
+    line->argc = 0;
+    return;
+  }
+
+  memmove(line, line + 1, (peephole->count - index - 1) * sizeof(PeepholeLine_t));
+  peephole->count--;
+}
+
+//rewrite the lines a rule matched at 'start', false if it doesn't apply
+static bool applyRule(Peephole_t *peephole, const PeepholeRule_t *rule, int start) {
+
+  int matched[PATTERN_MAX], count;
+  Captures_t captures = {0};
+  if (!matchRule(peephole, rule, start, matched, &count, &captures))
+    return false;
+
+  for (int i = 0; i < TESTS_MAX && rule->checks[i].test; i++) {
+    if (!passesCheck(peephole, &rule->checks[i], matched[count - 1] + 1, &captures))
+      return false;
+  }
+
+  //the operands of every rewrite have to fit before any is made
+  char args[PATTERN_MAX][PEEPHOLE_ARGS_MAX][PEEPHOLE_TEXT_LEN];
+  for (int i = 0; i < count; i++) {
+    const PeepholeInsn_t *insn = &rule->rewrite[i];
+    for (int j = 0; insn->op && j < PEEPHOLE_ARGS_MAX && insn->args[j]; j++) {
+      char *arg = args[i][j];
+      if (!expandOperand(insn->args[j], &captures, arg))
+        return false;
+
+      //a pushed value has to be given its size, unless it is a register
+      if (!strcmp(insn->op, "push") && registerNumber(arg) < 0) {
+        if (strlen(arg) + strlen(SIZE_PREFIX) >= PEEPHOLE_TEXT_LEN)
+          return false;
+        memmove(arg + strlen(SIZE_PREFIX), arg, strlen(arg) + 1);
+        memcpy(arg, SIZE_PREFIX, strlen(SIZE_PREFIX));
+      }
+    }
+  }
+
+  for (int i = count - 1; i >= 0; i--) {
+    const PeepholeInsn_t *insn = &rule->rewrite[i];
+    PeepholeLine_t *line = &peephole->lines[matched[i]];
+    if (!insn->op) {
+      removeLine(peephole, matched[i]);
+      continue;
+    }
+    if (!strcmp(insn->op, PEEP_KEEP))
+      continue;
+
+    strcpy(line->op, insn->op);
+    for (line->argc = 0; line->argc < PEEPHOLE_ARGS_MAX && insn->args[line->argc]; line->argc++)
+      strcpy(line->args[line->argc], args[i][line->argc]);
+  }
+
+  return true;
+}
+
+//start of the instruction 'behind' instructions before line 'index'
+static int instructionBefore(Peephole_t *peephole, int index, int behind) {
+
+  while (index > 0 && behind > 0) {
+    index--;
+    if (peephole->lines[index].op[0])
+      behind--;
+  }
+  return index;
+}
+
+//run the rules over the window until none of them apply
+static void rewriteWindow(Peephole_t *peephole) {
+
+  int index = 0;
+  while (index < peephole->count) {
+    if (!peephole->lines[index].op[0]) {
+      index++;
+      continue;
+    }
+
+    int rule = 0;
+    while (rule < PEEPHOLE_RULE_COUNT && !applyRule(peephole, &PEEPHOLE_RULES[rule], index))
+      rule++;
+
+    if (rule == PEEPHOLE_RULE_COUNT)
+      index++;
+    else {
+      peephole->hits[rule]++;
+      index = instructionBefore(peephole, index, RETRY_BEHIND);
+    }
+  }
+}
+
+//write out the first 'count' lines of the window
+static void writeLines(Peephole_t *peephole, FILE *output, PeepholeWrite write, int count) {
+
+  for (int i = 0; i < count; i++) {
+    if (!peephole->lines[i].boundary)
+      write(output, &peephole->lines[i]);
+  }
+
+  memmove(peephole->lines, peephole->lines + count, (peephole->count - count) * sizeof(PeepholeLine_t));
+  peephole->count -= count;
+}
+
+//make room for a line, rewriting the window and writing half of it out once full
+static PeepholeLine_t *nextLine(Peephole_t *peephole, FILE *output, PeepholeWrite write) {
+
+  if (peephole->count == PEEPHOLE_WINDOW) {
+    rewriteWindow(peephole);
+    if (peephole->count > PEEPHOLE_WINDOW / 2)
+      writeLines(peephole, output, write, peephole->count - PEEPHOLE_WINDOW / 2);
+  }
+
+  PeepholeLine_t *line = &peephole->lines[peephole->count++];
+  memset(line, 0, sizeof(PeepholeLine_t));
+  return line;
+}
+
+int Peephole_add(Peephole_t *peephole, FILE *output, PeepholeWrite write, const char *label,
+                 const char *op, const char *comment, int argc, const char *const *args) {
+
+  if (argc > PEEPHOLE_ARGS_MAX || (label && strlen(label) >= PEEPHOLE_TEXT_LEN) ||
+      (op && strlen(op) >= PEEPHOLE_TEXT_LEN) || (comment && strlen(comment) >= PEEPHOLE_COMMENT_LEN))
+    return -1;
+  for (int i = 0; i < argc; i++) {
+    if (strlen(args[i]) >= PEEPHOLE_TEXT_LEN)
+      return -1;
+  }
+
+  PeepholeLine_t *line = nextLine(peephole, output, write);
+  if (label)
+    strcpy(line->label, label);
+  if (op)
+    strcpy(line->op, op);
+  if (comment)
+    strcpy(line->comment, comment);
+  for (line->argc = 0; line->argc < argc; line->argc++)
+    strcpy(line->args[line->argc], args[line->argc]);
+  return 0;
+}
+
+void Peephole_boundary(Peephole_t *peephole, FILE *output, PeepholeWrite write,
+                       const char *const *live, int count) {
+
+  unsigned int registers = 0;
+  for (int i = 0; i < count; i++) {
+    int reg = registerNumber(live[i]);
+    if (reg >= 0)
+      registers |= 1u << reg;
+  }
+
+  //nothing happens between two boundaries in a row, both hold
+  PeepholeLine_t *last = peephole->count ? &peephole->lines[peephole->count - 1] : NULL;
+  if (last && last->boundary) {
+    last->live &= registers;
+    return;
+  }
+
+  PeepholeLine_t *line = nextLine(peephole, output, write);
+  line->boundary = true;
+  line->live = registers;
+}
+
+void Peephole_flush(Peephole_t *peephole, FILE *output, PeepholeWrite write) {
+
+  rewriteWindow(peephole);
+  writeLines(peephole, output, write, peephole->count);
+}
+
+void Peephole_printHits(Peephole_t *peephole, FILE *output) {
+
+  size_t total = 0;
+  for (int i = 0; i < PEEPHOLE_RULE_COUNT; i++)
+    total += peephole->hits[i];
+
+  fprintf(output, "Peephole: %zu rewrite(s)\n", total);
+  for (int i = 0; i < PEEPHOLE_RULE_COUNT; i++)
+    fprintf(output, "  %-40s %zu\n", PEEPHOLE_RULES[i].name, peephole->hits[i]);
+}
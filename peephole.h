@@ -0,0 +1,136 @@
+/*
+ * CMPT 399 (Winter 2016)
+ * Assignment 4: Code Generation
+ * Author: Derrick Gold
+ *
+ * Peephole Optimizer API
+ *
+ * Generated instructions are held back in a small window before they
+ * are written, and rewritten there by a table of rules: each rule
+ * matches a few instructions in a row (comments between them aside),
+ * checks what it needs of the instructions following them, such as a
+ * register being overwritten before it is read again, and replaces
+ * them with fewer or cheaper ones. The rules are tried at every
+ * instruction of the window, and again at the instructions before
+ * one that was rewritten, as the rewrite can make them match.
+ *
+ * The code generator can mark the points between statements, after
+ * which nothing but the registers it names is read again. Without
+ * them, a register only counts as dead if it is overwritten within
+ * the window, before any jump.
+ */
+#ifndef __PEEPHOLE_H__
+#define __PEEPHOLE_H__
+
+#include <stdio.h>
+#include <stdbool.h>
+
+//instructions held back, half of them are written once it fills up
+#define PEEPHOLE_WINDOW 16
+//most operands of an instruction, and the longest text of a line
+#define PEEPHOLE_ARGS_MAX 2
+#define PEEPHOLE_TEXT_LEN 64
+#define PEEPHOLE_COMMENT_LEN 256
+
+//the rules, see PEEPHOLE_RULES in peephole.c
+typedef enum {
+  PEEPHOLE_PUSH_POP_SAME,
+  PEEPHOLE_PUSH_POP,
+  PEEPHOLE_LOAD_PUSH,
+  PEEPHOLE_ADDRESS_LOAD,
+  PEEPHOLE_MOVE_BACK,
+  PEEPHOLE_UPDATE_ADD,
+  PEEPHOLE_UPDATE_SUB,
+  PEEPHOLE_CLEAR,
+  PEEPHOLE_ADD_ZERO,
+  PEEPHOLE_SUB_ZERO,
+  PEEPHOLE_JUMP_NEXT,
+  PEEPHOLE_RULE_COUNT
+} PeepholeRule;
+
+//a line of assembly: a label, an instruction, a comment, or a mix of them
+typedef struct PeepholeLine_s {
+  char label[PEEPHOLE_TEXT_LEN];
+  char op[PEEPHOLE_TEXT_LEN];
+  char args[PEEPHOLE_ARGS_MAX][PEEPHOLE_TEXT_LEN];
+  int argc;
+  char comment[PEEPHOLE_COMMENT_LEN];
+  //a point between statements, which writes nothing, see Peephole_boundary
+  bool boundary;
+  unsigned int live;
+} PeepholeLine_t;
+
+//writes a line out to the assembly file
+typedef void (*PeepholeWrite)(FILE *output, const PeepholeLine_t *line);
+
+/*
+ * The window of a peephole optimizer. A zeroed one is empty, and
+ * has rewritten nothing yet.
+ */
+typedef struct Peephole_s {
+  PeepholeLine_t lines[PEEPHOLE_WINDOW];
+  int count;
+  //number of times each rule rewrote instructions
+  size_t hits[PEEPHOLE_RULE_COUNT];
+} Peephole_t;
+
+/*
+ * Peephole_add:
+ *  Add a line to the window, writing out the lines that leave it.
+ *  NULL, or empty strings, leave out that part of the line.
+ *
+ * Arguments:
+ *  peephole: The optimizer's window.
+ *  output: File the lines are written to.
+ *  write: How lines are written.
+ *  label: Label of the line.
+ *  op: Instruction of the line.
+ *  comment: Comment of the line.
+ *  argc: Number of operands of the instruction.
+ *  args: The instruction's operands.
+ *
+ * Returns:
+ *  0 on success, -1 if the line doesn't fit into the window, in
+ *  which case it is left for the caller to write, after calling
+ *  Peephole_flush.
+ */
+int Peephole_add(Peephole_t *peephole, FILE *output, PeepholeWrite write, const char *label,
+                 const char *op, const char *comment, int argc, const char *const *args);
+
+/*
+ * Peephole_boundary:
+ *  Mark the point after the last line added as one where all but the
+ *  named registers are dead, along with the flags.
+ *
+ * Arguments:
+ *  peephole: The optimizer's window.
+ *  output: File the lines are written to.
+ *  write: How lines are written.
+ *  live: Names of the registers read after the point.
+ *  count: Number of names in 'live'.
+ */
+void Peephole_boundary(Peephole_t *peephole, FILE *output, PeepholeWrite write,
+                       const char *const *live, int count);
+
+/*
+ * Peephole_flush:
+ *  Rewrite what is left in the window, and write all of it out.
+ *
+ * Arguments:
+ *  peephole: The optimizer's window.
+ *  output: File the lines are written to.
+ *  write: How lines are written.
+ */
+void Peephole_flush(Peephole_t *peephole, FILE *output, PeepholeWrite write);
+
+/*
+ * Peephole_printHits:
+ *  Print the number of times each rule rewrote instructions.
+ *
+ * Arguments:
+ *  peephole: The optimizer's window.
+ *  output: File stream to print to.
+ */
+void Peephole_printHits(Peephole_t *peephole, FILE *output);
+
+#endif //__PEEPHOLE_H__
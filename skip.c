@@ -0,0 +1,125 @@
+/*
+ * CMPT 399 (Winter 2016)
+ * Assignment 4: Code Generation
+ * Author: Derrick Gold
+ *
+ * Scanner Fast Path
+ */
+#include <stdint.h>
+#include "skip.h"
+
+/*
+ * A block of source bytes is compared against a character all at
+ * once, giving a mask with bit i set if byte i of the block matched.
+ */
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+#define SKIP_METHOD "avx2"
+#define BLOCK_SIZE 32
+#define BLOCK_FULL 0xffffffffu
+
+typedef __m256i Block_t;
+#define loadBlock(p) _mm256_loadu_si256((const __m256i *)(p))
+#define matchByte(block, c)                                              \
+  ((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8((block), _mm256_set1_epi8(c))))
+
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+
+#define SKIP_METHOD "sse2"
+#define BLOCK_SIZE 16
+#define BLOCK_FULL 0xffffu
+
+typedef __m128i Block_t;
+#define loadBlock(p) _mm_loadu_si128((const __m128i *)(p))
+#define matchByte(block, c)                                              \
+  ((uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8((block), _mm_set1_epi8(c))))
+
+#else
+#define SKIP_METHOD "scalar"
+#endif
+
+#define IS_WHITESPACE(c) ((c) == ' ' || (c) == '\t' || (c) == '\n')
+
+
+const char *Skip_whitespace(const char *p, const char *end) {
+
+#ifdef BLOCK_SIZE
+  while (end - p >= BLOCK_SIZE) {
+    Block_t block = loadBlock(p);
+    uint32_t other = ~(matchByte(block, '\n') | matchByte(block, ' ') |
+                       matchByte(block, '\t')) & BLOCK_FULL;
+    if (other)
+      return p + __builtin_ctz(other);
+
+    p += BLOCK_SIZE;
+  }
+#endif
+
+  while (p < end && IS_WHITESPACE(*p))
+    p++;
+  return p;
+}
+
+
+/*
+ * Find the next '*' in a comment, the only character that can
+ * open or close a comment.
+ */
+static const char *findStar(const char *p, const char *end) {
+
+#ifdef BLOCK_SIZE
+  while (end - p >= BLOCK_SIZE) {
+    uint32_t stars = matchByte(loadBlock(p), '*');
+    if (stars)
+      return p + __builtin_ctz(stars);
+
+    p += BLOCK_SIZE;
+  }
+#endif
+
+  while (p < end && *p != '*')
+    p++;
+  return p;
+}
+
+
+const char *Skip_comment(const char *p, const char *end, int *depth) {
+
+  const char *start = p;
+  while (*depth > 0) {
+    p = findStar(p, end);
+    if (p == end) {
+      //a '(' last may open a nested comment with the '*' read next,
+      //so it is left for flex to match along with it
+      if (p > start && p[-1] == '(')
+        p--;
+      break;
+    }
+
+    //"(*" opens a nested comment, checked first as flex would
+    //have matched it starting from the '('
+    if (p > start && p[-1] == '(') {
+      (*depth)++;
+      p++;
+    }
+    //whether "*)" closes the comment isn't known until the
+    //next character is read
+    else if (p + 1 == end)
+      break;
+    else if (p[1] == ')') {
+      (*depth)--;
+      p += 2;
+    } else
+      p++;
+  }
+
+  return p;
+}
+
+
+const char *Skip_method(void) {
+
+  return SKIP_METHOD;
+}
@@ -0,0 +1,61 @@
+/*
+ * CMPT 399 (Winter 2016)
+ * Assignment 4: Code Generation
+ * Author: Derrick Gold
+ *
+ * Scanner Fast Path API
+ *
+ * Skips over the parts of a source that produce no tokens (whitespace
+ * and comment bodies) a block of bytes at a time, rather than having
+ * flex match them one character at a time. Blocks are 32 bytes when
+ * compiled with AVX2 (-mavx2), 16 bytes with SSE2 (any x86-64 build),
+ * and a plain byte loop is used everywhere else.
+ */
+#ifndef __SKIP_H__
+#define __SKIP_H__
+
+/*
+ * Skip_whitespace:
+ *  Find the end of a run of whitespace (spaces, tabs and newlines).
+ *
+ * Arguments:
+ *  p: Start of the run.
+ *  end: End of the bytes that may be examined.
+ *
+ * Returns:
+ *  Pointer to the first byte that isn't whitespace, or end.
+ */
+const char *Skip_whitespace(const char *p, const char *end);
+
+/*
+ * Skip_comment:
+ *  Find the end of a (possibly nested) comment, from somewhere
+ *  within its body. Comments open with "(*" and close with "*)",
+ *  and are matched the same way the lexer matches them.
+ *
+ * Arguments:
+ *  p: Position within the comment body, which must not be between
+ *    the two characters of a "(*" or "*)".
+ *  end: End of the bytes that may be examined.
+ *  depth: Number of comments p is nested within. Updated for every
+ *    comment opened or closed.
+ *
+ * Returns:
+ *  Pointer to the byte following the outermost comment's end, with
+ *  depth set to 0. If the comment doesn't end before 'end', the
+ *  position up to which the comment was scanned, with depth still
+ *  greater than 0. A '(' or '*' last is left unscanned, as the
+ *  byte read after it decides whether it opens or closes a comment.
+ */
+const char *Skip_comment(const char *p, const char *end, int *depth);
+
+/*
+ * Skip_method:
+ *  Get the name of the instruction set the fast path was built with.
+ *
+ * Returns:
+ *  "avx2", "sse2" or "scalar".
+ */
+const char *Skip_method(void);
+
+#endif //__SKIP_H__
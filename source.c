@@ -0,0 +1,96 @@
+/*
+ * CMPT 399 (Winter 2016)
+ * Assignment 4: Code Generation
+ * Author: Derrick Gold
+ *
+ * Source Input API
+ */
+//needed for MAP_ANONYMOUS
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "source.h"
+
+
+/*
+ * Map a regular file into memory, followed by SOURCE_PADDING
+ * null bytes. An anonymous (zero filled) region large enough for
+ * the file and padding is reserved first, then the file is mapped
+ * over the start of it. Private mappings are used since flex
+ * writes into the buffer it scans.
+ *
+ * Returns 0 on success, -1 if the file couldn't be mapped.
+ */
+static int mapFile(Source_t *source, int fd, size_t size) {
+
+  size_t mapSize = size + SOURCE_PADDING;
+  char *region = mmap(NULL, mapSize, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (region == MAP_FAILED)
+    return -1;
+
+  char *file = mmap(region, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_FIXED, fd, 0);
+  if (file == MAP_FAILED) {
+    munmap(region, mapSize);
+    return -1;
+  }
+
+  //the tail of the last file page is zero filled by mmap, but make
+  //sure the padding is null when it falls within the file's pages
+  memset(region + size, 0, SOURCE_PADDING);
+
+  source->buffer = region;
+  source->size = size;
+  source->mapSize = mapSize;
+  return 0;
+}
+
+
+Source_t *Source_open(FILE *file, bool map) {
+
+  if (!file)
+    return NULL;
+
+  Source_t *source = calloc(1, sizeof(Source_t));
+  if (!source) {
+    fprintf(stderr, "Source_open: Error allocating source\n");
+    return NULL;
+  }
+  source->file = file;
+
+  //only non-empty regular files can be mapped, and only if
+  //nothing has been read from the stream yet
+  struct stat info;
+  int fd = fileno(file);
+  if (map && fd >= 0 && !fstat(fd, &info) && S_ISREG(info.st_mode) &&
+      info.st_size > 0 && ftell(file) == 0)
+    mapFile(source, fd, (size_t)info.st_size);
+
+  //if it couldn't be mapped, the source is read from the stream
+  return source;
+}
+
+
+bool Source_isMapped(Source_t *source) {
+
+  return source && source->buffer;
+}
+
+
+void Source_close(Source_t *source) {
+
+  if (!source)
+    return;
+
+  if (source->buffer)
+    munmap(source->buffer, source->mapSize);
+
+  memset(source, 0, sizeof(Source_t));
+  free(source);
+}
@@ -0,0 +1,70 @@
+/*
+ * CMPT 399 (Winter 2016)
+ * Assignment 4: Code Generation
+ * Author: Derrick Gold
+ *
+ * Source Input API
+ *
+ * Prepares a program source for the lexer. Regular files are mapped
+ * into memory so the lexer can scan them in place, followed by the
+ * two null bytes flex needs at the end of a buffer. Anything that
+ * can't be mapped (pipes, terminals, empty files) is read through
+ * its stdio stream instead.
+ */
+#ifndef __SOURCE_H__
+#define __SOURCE_H__
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//number of null bytes following a mapped source
+#define SOURCE_PADDING 2
+
+typedef struct Source_s {
+  //stdio stream of the source
+  FILE *file;
+
+  //contents of a mapped source, NULL if it isn't mapped
+  char *buffer;
+  //size of the source, and of its mapping, in bytes
+  size_t size, mapSize;
+} Source_t;
+
+/*
+ * Source_open:
+ *  Prepare an opened file as a program source.
+ *
+ * Arguments:
+ *  file: Stream of the source file, it remains owned by the caller.
+ *  map: Try to map the file into memory. If false, or if the
+ *    file can't be mapped, the source is read through 'file'.
+ *
+ * Returns:
+ *  Pointer to the source. NULL on error.
+ */
+Source_t *Source_open(FILE *file, bool map);
+
+/*
+ * Source_isMapped:
+ *  Check if a source has been mapped into memory.
+ *
+ * Arguments:
+ *  source: The source to check.
+ *
+ * Returns:
+ *  True if the source contents are in source->buffer,
+ *  false if they need to be read from source->file.
+ */
+bool Source_isMapped(Source_t *source);
+
+/*
+ * Source_close:
+ *  Unmap a source and free it. Does not close the source's stream.
+ *
+ * Arguments:
+ *  source: The source to close.
+ */
+void Source_close(Source_t *source);
+
+#endif //__SOURCE_H__
@@ -8,21 +8,46 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <math.h>
+#include <stdint.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "symtab.h"
 #include "defines.h"
+#include "arena.h"
+#include "intern.h"
 
 //size of variable on the stack
 #define VAR_STACK_SIZE WORD_SIZE_BYTES
 
-//Limit how many times to rehash an entry before
-//resizing the hash table
-#define LOOKUP_ATTEMPTS 5
+/*
+ * The index of a table is an open addressing hash table of symbols,
+ * with a control byte per slot: CTRL_EMPTY for a free slot, or the low
+ * 7 bits of the key's hash (its tag) for a used one. Slots are probed
+ * a group at a time, the tags of a whole group are compared at once,
+ * so slots are only looked at on a tag match. A slot keeps its
+ * symbol's key, so a lookup doesn't have to follow the symbol to
+ * compare it.
+ */
+#define GROUP_WIDTH 16
+#define CTRL_EMPTY 0x80
+#define TAG_BITS 7
+#define TAG_MASK 0x7f
+
+//the index grows (doubling) once this fraction of its slots is used
+#define MAX_LOAD_NUM 7
+#define MAX_LOAD_DEN 8
+
+//fewest slots an index has, a group must not wrap onto itself
+#define MIN_CAPACITY GROUP_WIDTH
 
-//how large to grow the table each time it is
-//automatically resized. As a percentage of its
-//current size.
-#define GROWTH_RATE 0.21f
+//spreads the hash of short keys across all bits (Fibonacci hashing)
+#define HASH_MULTIPLIER 0x9E3779B97F4A7C15ull
+
+typedef struct SymSlot_s {
+  char *key;
+  Symbol_t *symbol;
+} SymSlot_t;
 
 
 //fancy symbol table printing macros
@@ -59,15 +84,9 @@ const char *SYM_TYPE_TEXT[] = {
 
 
 
-static size_t growSize(size_t oldSize) {
-  
-  return oldSize  + (size_t)floor(oldSize * GROWTH_RATE);
-}
-
-
 Symbol_t *Symbol_create(char *key, symdata data,  SymbolType type) {
 
-  Symbol_t *entry = calloc(1, sizeof(Symbol_t));
+  Symbol_t *entry = Arena_alloc(Arena_getActive(), sizeof(Symbol_t));
   if (!entry) {
     fprintf(stderr, "Error allocating hash data\n");
     return NULL;
@@ -81,20 +100,6 @@ Symbol_t *Symbol_create(char *key, symdata data,  SymbolType type) {
   return entry;
 }
 
-void Symbol_destroy(Symbol_t *data) {
-
-  if (!data)
-    return;
-
-  memset(data, 0, sizeof(Symbol_t));
-  free(data);
-}
-
-static int symbolDestroyHelper(Symbol_t *entry, void *data) {
-  Symbol_destroy(entry);
-  return 0;
-}
-
 
 void Symbol_addType(Symbol_t *data, SymbolType type) {
 
@@ -215,177 +220,200 @@ static int symbolPrintHelper(Symbol_t *symbol, void *data) {
   return 0;
 }
 
-//djb2 algorithm
-//http://www.cse.yorku.ca/~oz/hash.html
-size_t hash1(char *key, size_t num, size_t last) {
+static uint64_t mixHash(size_t hash) {
 
-  size_t hashVal = 5381 + last;
-  int c;
+  uint64_t mixed = (uint64_t)hash * HASH_MULTIPLIER;
+  return mixed ^ (mixed >> 32);
+}
 
-  while ((c = *key++) != '\0')
-    hashVal = ((hashVal << 5) + hashVal) ^ c; /* hash * 33 + c */
+/*
+ * Control bytes of a group, and bit masks of the slots in a group
+ * with a given tag (bit i set for slot 'group + i') or that are free.
+ * Free slots are the only ones with the top bit of their byte set.
+ */
+#ifdef __SSE2__
+typedef __m128i Group_t;
+typedef __m128i GroupTag_t;
+#define GROUP_LOAD(control) _mm_loadu_si128((const __m128i *)(control))
+#define GROUP_TAG(tag) _mm_set1_epi8((char)(tag))
+#define GROUP_MATCH(group, tag) ((unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8((group), (tag))))
+#define GROUP_EMPTY(group) ((unsigned)_mm_movemask_epi8(group))
+#else
+typedef const uint8_t *Group_t;
+typedef uint8_t GroupTag_t;
+#define GROUP_LOAD(control) (control)
+#define GROUP_TAG(tag) (tag)
+#define GROUP_MATCH(group, tag) matchGroup((group), (tag))
+#define GROUP_EMPTY(group) matchGroup((group), CTRL_EMPTY)
+
+static unsigned matchGroup(const uint8_t *group, uint8_t byte) {
+
+  unsigned mask = 0;
+  for (int i = 0; i < GROUP_WIDTH; i++)
+    mask |= (unsigned)(group[i] == byte) << i;
+  return mask;
+}
+#endif
 
+/*
+ * The control bytes of the first group are repeated after the last
+ * slot, so a group can be loaded starting from any slot.
+ */
+static void setControl(SymTable_t *table, size_t slot, uint8_t byte) {
 
-  return hashVal % num;
+  table->control[slot] = byte;
+  if (slot < GROUP_WIDTH)
+    table->control[table->capacity + slot] = byte;
 }
 
-size_t hash2(char *key, size_t num, int attempt1) {
-
-  size_t hashVal = 0;
-  while (*key != '\0') {
-    hashVal = ((hashVal << 4) + *key) % num;
-    key++;
-  }
+/*
+ * Groups are probed at triangular distances from the key's first
+ * slot, which visits every group when the capacity is a power of two.
+ */
+static Symbol_t **findEntry(SymTable_t *table, char *key, uint64_t mixed) {
 
-  return (attempt1 - hashVal) % num;
-}
+  size_t mask = table->capacity - 1;
+  size_t pos = (size_t)(mixed >> TAG_BITS) & mask;
 
+  //most keys are in the first slot they could be in
+  if (table->control[pos] == (mixed & TAG_MASK) && table->slots[pos].key == key)
+    return &table->slots[pos].symbol;
 
+  GroupTag_t tag = GROUP_TAG(mixed & TAG_MASK);
 
-Symbol_t **SymTable_getEntry(SymTable_t *table, char *key) {
+  for (size_t step = GROUP_WIDTH; ; step += GROUP_WIDTH) {
+    Group_t group = GROUP_LOAD(&table->control[pos]);
 
-  if (!table || !key)
-    return NULL;
+    for (unsigned match = GROUP_MATCH(group, tag); match; match &= match - 1) {
+      SymSlot_t *slot = &table->slots[(pos + __builtin_ctz(match)) & mask];
+      //interned keys are equal only if they are the same string
+      if (slot->key == key)
+        return &slot->symbol;
+    }
 
-  size_t pos = hash1(key, table->size, 0);
+    //the key would have been put in the first free slot
+    if (GROUP_EMPTY(group))
+      return NULL;
 
-  Symbol_t **curPos = &table->entries[pos];
+    pos = (pos + step) & mask;
+  }
+}
 
-  //no table entries allocated?
-  if (!curPos)
-    return NULL;
-    
-  //if first attempt and nothing exists, return the free position
-  if (!*curPos)
-    return curPos;
+static Symbol_t **insertSlot(SymTable_t *table, uint64_t mixed, char *key, Symbol_t *symbol) {
 
-  //otherwise, check that we've got the right one
-  int attempt = 0;
-  
-  do {
-    Symbol_t *entry = *curPos;
-    
-    if (!strcmp(key, entry->key))
-      return curPos;
-    
-    //pos = (pos + attempt) % table->size;
-    pos = hash1(key, table->size, pos + (attempt<<1));
-    curPos = &table->entries[pos];
-  } while (*curPos != NULL && attempt++ < LOOKUP_ATTEMPTS);
+  size_t mask = table->capacity - 1;
+  size_t pos = (size_t)(mixed >> TAG_BITS) & mask;
 
-  if (attempt >= LOOKUP_ATTEMPTS)
-    return NULL;
+  for (size_t step = GROUP_WIDTH; ; step += GROUP_WIDTH) {
+    unsigned empty = GROUP_EMPTY(GROUP_LOAD(&table->control[pos]));
+    if (empty) {
+      size_t slot = (pos + __builtin_ctz(empty)) & mask;
+      setControl(table, slot, mixed & TAG_MASK);
+      table->slots[slot] = (SymSlot_t) {.key = key, .symbol = symbol};
+      return &table->slots[slot].symbol;
+    }
 
-  return curPos;
+    pos = (pos + step) & mask;
+  }
 }
 
+//build an empty index of 'capacity' slots, a power of two
+static int initIndex(SymTable_t *table, size_t capacity) {
 
+  Arena_t *arena = Arena_getActive();
+  uint8_t *control = Arena_alloc(arena, capacity + GROUP_WIDTH);
+  SymSlot_t *slots = Arena_alloc(arena, capacity * sizeof(SymSlot_t));
+  if (!control || !slots) {
+    fprintf(stderr, "SymTable: Error allocating table index\n");
+    return -1;
+  }
+  memset(control, CTRL_EMPTY, capacity + GROUP_WIDTH);
 
-int SymTable_copy(SymTable_t *dest, SymTable_t *src) {
+  table->control = control;
+  table->slots = slots;
+  table->capacity = capacity;
+  table->growAt = capacity / MAX_LOAD_DEN * MAX_LOAD_NUM;
+  return 0;
+}
 
-  //make sure the dest table is at least as large as the source
-  if (dest->size < src->size)
+/*
+ * Double the slots of the index, and move the used slots into it.
+ * A slot's symbol may no longer be the entry first added under its
+ * key (see SymTable_bind), so the slots are moved rather than the
+ * entries added again. The old index is released along with the arena.
+ */
+static int growIndex(SymTable_t *table) {
+
+  uint8_t *control = table->control;
+  SymSlot_t *slots = table->slots;
+  size_t capacity = table->capacity;
+
+  if (initIndex(table, capacity << 1))
     return -1;
-  
-  //rehash all entries and copy them over
-  for (size_t e = 0; e < src->size; e++) {
 
-    //skip null entries
-    if (src->entries[e] == NULL)
+  for (size_t i = 0; i < capacity; i++) {
+    if (control[i] == CTRL_EMPTY)
       continue;
 
-    //have a valid entry
-    Symbol_t **pos = SymTable_getEntry(dest, src->entries[e]->key);
-    if (!pos) {
-      return -1;
-    }
+    insertSlot(table, mixHash(Intern_hash(slots[i].key)), slots[i].key, slots[i].symbol);
+  }
 
-    if (*pos == NULL)
-      *pos = src->entries[e];
-    else {
-      return -1;
-    }
-    
+  return 0;
+}
+
+static int growEntries(SymTable_t *table) {
+
+  size_t size = table->size << 1;
+  Symbol_t **entries = Arena_alloc(Arena_getActive(), size * sizeof(Symbol_t *));
+  if (!entries) {
+    fprintf(stderr, "SymTable: Error growing table entries\n");
+    return -1;
   }
 
-  dest->curStackPtr = src->curStackPtr;
-  dest->stackFrameDepth = src->stackFrameDepth;
-  dest->id = src->id;
+  memcpy(entries, table->entries, table->count * sizeof(Symbol_t *));
+  table->entries = entries;
+  table->size = size;
   return 0;
 }
 
+
+Symbol_t **SymTable_getEntry(SymTable_t *table, char *key) {
+
+  if (!table || !key || !table->control)
+    return NULL;
+
+  //keys are interned, so their hash has already been computed
+  return findEntry(table, key, mixHash(Intern_hash(key)));
+}
+
+
 SymTable_t *SymTable_init(size_t size) {
 
-  static int nextID = 0;
-  
   if (size <= 0)
     return NULL;
 
-  SymTable_t *table = calloc(1, sizeof(SymTable_t));
+  Arena_t *arena = Arena_getActive();
+  SymTable_t *table = Arena_alloc(arena, sizeof(SymTable_t));
   if (!table) {
     fprintf(stderr, "SymTable_init: Error allocating symbol table\n");
     return NULL;
   }
   table->size = size;
-  table->entries = calloc(size, sizeof(Symbol_t*));
+  table->entries = Arena_alloc(arena, size * sizeof(Symbol_t*));
   if (!table->entries) {
     fprintf(stderr, "SymTable_init: Error allocating symtable entries\n");
-    free(table);
     return NULL;
   }
 
-  table->id = nextID++;
-
-  return table;
-}
-
-
-
-void SymTable_destroy(SymTable_t *table) {
-
-  if (!table)
-    return;
-
+  //enough slots for 'size' entries without growing
+  size_t capacity = MIN_CAPACITY;
+  while (capacity / MAX_LOAD_DEN * MAX_LOAD_NUM < size)
+    capacity <<= 1;
 
-  if (table->entries) {    
-    SymTable_forEach(table, NULL, symbolDestroyHelper);
-    free(table->entries);
-  }
-
-  memset(table, 0, sizeof(SymTable_t));
-  free(table);
-}
-
-
-int SymTable_resize(SymTable_t *table, size_t size) {
-
-  SymTable_t *newTable = NULL;
-  int status = 0;
-  do {
-    newTable = SymTable_init(size);
-    if (!newTable) {
-      fprintf(stderr, "Error initializing new table\n");
-      return -1;
-    }
-
-    status = SymTable_copy(newTable, table);
+  if (initIndex(table, capacity))
+    return NULL;
 
-    //error copying data, resize the table 
-    if (status) {
-      size = growSize(size);
-      free(newTable);
-    }
-  } while (status);
-    
-  //then free old table, and assign new table
-  free(table->entries);
-
-  //make original table point to new table stuff
-  table->entries = newTable->entries;
-  table->size = newTable->size;
-  free(newTable);
-  //and done
-  return 0;
+  return table;
 }
 
 
@@ -408,17 +436,10 @@ int SymTable_forEach(SymTable_t *table, void *data, int (*fn) (Symbol_t *, void
   if (!table || !fn)
     return 0;
   
-  //loop through all symbol table entries
-  for (size_t i = 0; i < table->size; i++) {
-
-    //skip entries where key may not be set (malformed entries)
-    Symbol_t *entry = table->entries[i];
-    
-    //skip empty entries
-    if (!entry)
-      continue;
+  //symbols are visited in the order they were added
+  for (size_t i = 0; i < table->count; i++) {
 
-    int status = fn(entry, data);
+    int status = fn(table->entries[i], data);
     if (status)
       return status;
 
@@ -429,35 +450,31 @@ int SymTable_forEach(SymTable_t *table, void *data, int (*fn) (Symbol_t *, void
 
 Symbol_t **SymTable_add(SymTable_t *table, Symbol_t *data) {
 
-  if (!table || !table->entries)
+  if (!table || !table->entries || !data)
    return NULL;
 
-  //if we somehow managed to fill the table, make it grow
-  if (table->count >= table->size)
-    SymTable_resize(table, growSize(table->size));
+  uint64_t mixed = mixHash(Intern_hash(data->key));
 
-       
-  Symbol_t **position = SymTable_getEntry(table, data->key);
-  
-  if (!position) {
-    SymTable_resize(table, growSize(table->size));
-    //try adding the data again
-    return SymTable_add(table, data);;
+  //if an entry already exists for a given key,
+  //just return that data instead
+  Symbol_t **position = findEntry(table, data->key, mixed);
+  if (position)
+    return position;
 
-  }
-  if (!*position) {
-    (*position) = data;
-    table->count++;
-  }
-  //if this statement is false, that means an entry already
-  //exists for a given key, just return that data instead
-  return position;
+  if (table->count == table->size && growEntries(table))
+    return NULL;
+
+  if (table->count >= table->growAt && growIndex(table))
+    return NULL;
+
+  table->entries[table->count++] = data;
+  return insertSlot(table, mixed, data->key, data);
 }
 
 Symbol_t *SymTable_find(SymTable_t *table, char *key) {
     
   Symbol_t **position = SymTable_getEntry(table, key);
-  if (!*position) {
+  if (!position || !*position) {
     return NULL;
   }
 
@@ -496,16 +513,61 @@ Symbol_t *SymTable_findAll(SymTable_t *table, char *key, int *bytesOff) {
 }
 
 
+int SymTable_bind(SymTable_t *visible, Symbol_t *symbol) {
+
+  Symbol_t **binding = SymTable_add(visible, symbol);
+  if (!binding)
+    return -1;
+
+  //the name was seen before, hide whatever it is bound to
+  if (*binding != symbol) {
+    symbol->shadows = *binding;
+    *binding = symbol;
+  }
+
+  return 0;
+}
+
+
+void SymTable_unbind(SymTable_t *visible, SymTable_t *scope) {
+
+  for (size_t i = 0; i < scope->count; i++) {
+    Symbol_t *symbol = scope->entries[i];
+    Symbol_t **binding = SymTable_getEntry(visible, symbol->key);
+
+    //an unbound name keeps its slot, holding no symbol
+    if (binding && *binding == symbol)
+      *binding = symbol->shadows;
+  }
+}
+
+
+int SymTable_frameOffset(SymTable_t *table, Symbol_t *symbol) {
+
+  //offsets started at 0, so add 1 word to get the proper position
+  return table->frameBase - symbol->frameBase - (symbol->stackOffset + WORD_SIZE_BYTES);
+}
+
+int SymTable_elementOffset(SymTable_t *table, Symbol_t *symbol, int index) {
+
+  //the frame offset is of the highest word
+  int first = SymTable_frameOffset(table, symbol) - (symbol->stackWords - 1) * WORD_SIZE_BYTES;
+  return first + index * WORD_SIZE_BYTES;
+}
+
+
 void SymTable_addStackVar(SymTable_t *table, Symbol_t *symbol) {
   
   //store stack offset for variable
   symbol->stackOffset = table->curStackPtr;
+  symbol->frameBase = table->frameBase;
   //then increase the stack pointer for the current scope
   if (Symbol_hasType(symbol, SYMTYPE_ARRAY)) {
     Symbol_t *size = Symbol_getArraySizeEntry(table, symbol);
-    table->curStackPtr += VAR_STACK_SIZE * size->data.value;
+    symbol->stackWords = size->data.value;
   } else
-    table->curStackPtr += VAR_STACK_SIZE;
+    symbol->stackWords = 1;
+  table->curStackPtr += VAR_STACK_SIZE * symbol->stackWords;
 }
 
 int SymTable_getStackDepth(SymTable_t *table) {
@@ -523,5 +585,7 @@ int SymTable_addParent(SymTable_t *table, SymTable_t *parent) {
   //update locations
   int depth =SymTable_getStackDepth(parent);
   table->stackFrameDepth = depth + 1;
+  //the parent's frame, and its link to its own, lie between
+  table->frameBase = parent->frameBase + parent->curStackPtr + WORD_SIZE_BYTES;
   return 0;
 }
@@ -9,6 +9,7 @@
 #define __SYMBOL_TABLE_H__
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "lexer.h"
 
 
@@ -57,15 +58,34 @@ typedef struct Symbol_s {
   symdata data;
   SymbolType type;
   int stackOffset;
+  //number of words the variable takes on the stack, an array's length
+  int stackWords;
+  //frame base of the scope the variable was declared in
+  int frameBase;
+  //symbol of the same name this one hides while in scope
+  struct Symbol_s *shadows;
+  //.rodata entry holding a string constant's value, or for an
+  //entry of .rodata, the entry holding the bytes of its string
+  //(NULL if the entry holds them itself)
+  struct Symbol_s *rodata;
 } Symbol_t;
 
 
 typedef struct SymTable_s {
   struct SymTable_s *parent;
+  //symbols in the order they were added, and room for 'size' of them
   size_t count, size;
   Symbol_t **entries;
+  //hash index of the entries: a control byte and a
+  //symbol per slot, see symtab.c
+  uint8_t *control;
+  struct SymSlot_s *slots;
+  size_t capacity, growAt;
   int curStackPtr;
   int stackFrameDepth;
+  //bytes of the enclosing scopes' frames, including their links,
+  //between the outermost frame and this scope's
+  int frameBase;
   int id;
 } SymTable_t;
 
@@ -75,17 +95,16 @@ typedef struct SymTable_s {
  *  Create a symbol for entry in the symbol table.
  *
  * Arguments:
- *  key*: string to use for lookup.
+ *  key*: interned string to use for lookup (see Intern_string).
  *  data*: string or integer data to associate with key
  *  type: Type of symbol that best represents the associated key/data
  *
  *  *: Only pointer copies of these fields are made, must exist
- *    for the life time of the table. That being said, these
- *    values are also not free'd by SymTable_destroy.
+ *    for the life time of the table.
  *
  * Returns:
- *  Pointer to new populated symbol instance. NULL if symbol
- *  creation fails in any way.
+ *  Pointer to new populated symbol instance, allocated from the
+ *  active arena. NULL if symbol creation fails in any way.
  */
 Symbol_t *Symbol_create(char *key, symdata data, SymbolType type);
 
@@ -156,42 +175,32 @@ void Symbol_print(FILE *output, Symbol_t *entry);
 
 /*
  * SymTable_init
- *  Initialize a symbol table instance.
+ *  Initialize a symbol table instance. The table grows as
+ *  symbols are added.
  *
  * Arguments:
  *  size: initial number of elements to allocate in symbol table.
  *
  * Returns:
- *  A pointer to a Symbol table instance. NULL if any error occured
- *  in initialization.
+ *  A pointer to a Symbol table instance, allocated from the active
+ *  arena. NULL if any error occured in initialization.
  */
 SymTable_t *SymTable_init(size_t size);
 
-/*
- * SymTable_destroy:
- *  Free all memory allocated by a symbol table instance.
- *  Does not free key pointers nor pointers used in symbol
- *  data.
- *
- * Arguments:
- *  table: Symbol table to destroy
- *
- */
-void SymTable_destroy(SymTable_t *table);
-
 /*
  * Symbol_getEntry:
  *  Get a pointer to the symbols position in the symbol table.
  *
  * Arguments:
  *  table: Symbol table instance to search in
- *  key: Key to look up symbol with
+ *  key: Interned key to look up symbol with (see Intern_string)
  *  
  * Returns:
- *  A pointer to a location in the symbol table where the
- *  symbol should reside. Does not return the symbol itself.
- *  To get the symbol from this location, one just needs to
- *  dereference the return value, or use SymTable_find instead.
+ *  A pointer to the location in the symbol table where the
+ *  symbol resides, NULL if it isn't in the table. Does not return
+ *  the symbol itself. To get the symbol from this location, one
+ *  just needs to dereference the return value, or use SymTable_find
+ *  instead. The location is valid until the next symbol is added.
  */
 Symbol_t **SymTable_getEntry(SymTable_t *table, char *key);
 
@@ -204,8 +213,9 @@ Symbol_t **SymTable_getEntry(SymTable_t *table, char *key);
  *  data: symbol to add into symbol table.
  *
  * Returns:
- *  Location in Symbol Table in which the symbol was added to.
- *  NULL if no table or symbol arguments given.
+ *  Location in Symbol Table in which the symbol was added to, or
+ *  of the symbol already in the table with the same key. NULL if
+ *  no table or symbol arguments given, or the table failed to grow.
  */
 Symbol_t **SymTable_add(SymTable_t *table, Symbol_t *data);
 
@@ -217,15 +227,75 @@ Symbol_t **SymTable_add(SymTable_t *table, Symbol_t *data);
  *
  * Arguments:
  *  table: Symbol table to search for symbol in
- *  key: Key to look up symbol with
+ *  key: Interned key to look up symbol with
  *
  * Returns:
- *  A pointer to a symbol instance.
+ *  A pointer to a symbol instance. NULL if not found.
  */
 Symbol_t *SymTable_find(SymTable_t *table, char *key);
 
 Symbol_t *SymTable_findAll(SymTable_t *table, char *key, int *bytesOff);
 
+/*
+ * SymTable_bind:
+ *  Make a symbol the one visible under its name in a table of
+ *  visible symbols, hiding (until unbound) any symbol of the same
+ *  name that was visible before it. The table keeps one slot per
+ *  name, so a lookup finds the innermost symbol without walking
+ *  through any scopes. Only SymTable_find should be used on it.
+ *
+ * Arguments:
+ *  visible: Table of the symbols visible by name.
+ *  symbol: The symbol to bind.
+ *
+ * Returns:
+ *  0 on success, -1 if the table failed to grow.
+ */
+int SymTable_bind(SymTable_t *visible, Symbol_t *symbol);
+
+/*
+ * SymTable_unbind:
+ *  Undo SymTable_bind for every symbol of a scope being left,
+ *  making the symbols they hid visible again.
+ *
+ * Arguments:
+ *  visible: Table of the symbols visible by name.
+ *  scope: The scope whose symbols go out of scope.
+ */
+void SymTable_unbind(SymTable_t *visible, SymTable_t *scope);
+
+/*
+ * SymTable_frameOffset:
+ *  Get the offset of a variable from the frame pointer of a scope
+ *  the variable is visible in, as found by SymTable_findAll but
+ *  without walking through the scopes in between.
+ *
+ * Arguments:
+ *  table: The scope the variable is referenced from.
+ *  symbol: The variable's symbol.
+ *
+ * Returns:
+ *  Offset of the variable's first word, in bytes.
+ */
+int SymTable_frameOffset(SymTable_t *table, Symbol_t *symbol);
+
+/*
+ * SymTable_elementOffset:
+ *  Get the offset of an array's element from the frame pointer of a
+ *  scope the array is visible in. The elements go up from the lowest
+ *  word of the array, so the offset of any element is that of the
+ *  first plus the index scaled by the word size.
+ *
+ * Arguments:
+ *  table: The scope the array is referenced from.
+ *  symbol: The array's symbol.
+ *  index: Index of the element.
+ *
+ * Returns:
+ *  Offset of the element, in bytes.
+ */
+int SymTable_elementOffset(SymTable_t *table, Symbol_t *symbol, int index);
+
 /*
  * SymTable_print:
  *  Print out a symbol table.
@@ -241,8 +311,33 @@ void SymTable_addStackVar(SymTable_t *table, Symbol_t *symbol);
 
 int SymTable_getStackDepth(SymTable_t *table);
 
+/*
+ * SymTable_forEach:
+ *  Call a function on every symbol of a table, in the order
+ *  the symbols were added.
+ *
+ * Arguments:
+ *  table: The table to go through.
+ *  data: Passed along to the function.
+ *  fn: Function to call, returning non-zero stops the walk.
+ *
+ * Returns:
+ *  0, or the first non-zero value returned by the function.
+ */
 int SymTable_forEach(SymTable_t *table, void *data, int (*fn) (Symbol_t *, void *));
 
+/*
+ * SymTable_addParent:
+ *  Nest a scope in another. The parent's variables must all have
+ *  been added, as the frame base of the scope is set from them.
+ *
+ * Arguments:
+ *  table: The nested scope.
+ *  parent: The scope it is nested in.
+ *
+ * Returns:
+ *  0 on success, -1 if either table is missing.
+ */
 int SymTable_addParent(SymTable_t *table, SymTable_t *parent);
 #endif
 
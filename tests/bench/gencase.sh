@@ -0,0 +1,37 @@
+#!/bin/bash
+
+# CMPT 399 (Winter 2016)
+# Assignment 4: Code Generation
+# By Derrick Gold
+
+# Generates a MacEwan Teeny Pascal program of case statements with a
+# very large number of labels, for stress testing the checks and code
+# generation of case statements. The labels of each statement are the
+# values up to the number of labels, in a scrambled order, a few to
+# each case. The program is written to stdout.
+
+# Usage: gencase.sh labels [statements]
+
+LABELS=${1:-100000}
+STATEMENTS=${2:-1}
+
+awk -v n="$LABELS" -v s="$STATEMENTS" 'BEGIN {
+    print "(* generated stress program: " s " case statement(s) of " n " labels *)";
+    print "var a : integer;";
+    print "";
+    print "begin";
+    print "\tread(a);";
+    for (j = 0; j < s; j++) {
+        print "\tcase a of";
+        # 7919 is prime, so stepping by it visits every value once
+        # (unless the number of labels is a multiple of it)
+        for (i = 0; i < n; i++) {
+            printf("%s%d", i % 4 ? ", " : "\t", (i * 7919) % n);
+            if (i % 4 == 3 || i == n - 1)
+                printf(":\n\t\twrite(%d)%s\n", i, i == n - 1 ? "" : ";");
+        }
+        print "\tend;";
+    }
+    print "\twrite(a)";
+    print "end.";
+}'
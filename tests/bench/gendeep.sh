@@ -0,0 +1,29 @@
+#!/bin/bash
+
+# CMPT 399 (Winter 2016)
+# Assignment 4: Code Generation
+# By Derrick Gold
+
+# Generates a MacEwan Teeny Pascal program with a single, deeply
+# nested expression for stress testing the compiler. The program
+# is written to stdout.
+
+# Usage: gendeep.sh depth
+
+DEPTH=${1:-10000}
+
+awk -v n="$DEPTH" 'BEGIN {
+    print "(* generated stress program: expression nested " n " deep *)";
+    print "var a : integer;";
+    print "";
+    print "begin";
+    printf("\ta := ");
+    for (i = 1; i < n; i++)
+        printf("1 + (");
+    printf("1");
+    for (i = 1; i < n; i++)
+        printf(")");
+    print ";";
+    print "\twrite(a);";
+    print "end.";
+}'
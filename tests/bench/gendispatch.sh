@@ -0,0 +1,83 @@
+#!/bin/bash
+
+# CMPT 399 (Winter 2016)
+# Assignment 4: Code Generation
+# By Derrick Gold
+
+# Generates a MacEwan Teeny Pascal program that dispatches through a
+# case statement in a loop, for timing the dispatch strategies of
+# case statements. The labels are laid out for the strategy named:
+#
+#  loop:     no case statement, the cost of the loop around one
+#  table:    a run of labels offset from 0, for a jump table
+#  clusters: four dense runs of labels far apart, for a binary search
+#            between jump tables
+#  bits:     labels within a word shared by three cases, for bit masks
+#  tree:     labels spread far apart, for a binary search
+#
+# The values dispatched on are the labels in a scrambled order, read
+# from an array so every strategy's loop does the same work around
+# its case statement. The number of iterations is read from stdin,
+# and the sum of the cases taken is written out. The program is
+# written to stdout.
+
+# Usage: gendispatch.sh strategy [labels]
+
+STRATEGY=${1:-table}
+LABELS=${2:-256}
+
+# bit masks are a word wide
+if [ "$STRATEGY" = bits ] && [ "$LABELS" -gt 32 ]; then
+    LABELS=32
+fi
+
+awk -v strategy="$STRATEGY" -v n="$LABELS" '
+function label(k) {
+    if (strategy == "clusters")
+        return (k % 4) * 100000 + int(k / 4);
+    if (strategy == "tree")
+        return k * 1000;
+    if (strategy == "bits")
+        return k;
+    return 1000 + k;
+}
+BEGIN {
+    print "(* generated dispatch benchmark: " strategy ", " n " labels *)";
+    print "var i, k, iterations, hits : integer;";
+    print "    values : array (" n ") of integer;";
+    print "";
+    print "begin";
+    for (k = 0; k < n; k++)
+        print "\tvalues(" k ") := " label(k) ";";
+    print "\tread(iterations);";
+    print "\ti := 0;";
+    print "\tk := 0;";
+    print "\thits := 0;";
+    print "\twhile i < iterations do";
+    print "\tbegin";
+    if (strategy == "loop")
+        print "\t\thits := hits + values(k);";
+    else if (strategy == "bits") {
+        # every third label shares a case
+        print "\t\tcase values(k) of";
+        for (arm = 0; arm < 3; arm++) {
+            printf("\t\t\t");
+            for (k = arm; k < n; k += 3)
+                printf("%s%d", k == arm ? "" : ", ", label(k));
+            printf(": hits := hits + %d%s\n", arm + 1, arm == 2 ? "" : ";");
+        }
+        print "\t\tend;";
+    } else {
+        print "\t\tcase values(k) of";
+        for (k = 0; k < n; k++)
+            printf("\t\t\t%d: hits := hits + %d%s\n", label(k), k % 7 + 1, k == n - 1 ? "" : ";");
+        print "\t\tend;";
+    }
+    # 7919 is prime, so stepping by it visits every label in turn
+    # (unless the number of labels is a multiple of it)
+    print "\t\tk := (k + 7919) mod " n ";";
+    print "\t\ti := i + 1";
+    print "\tend;";
+    print "\twrite(hits)";
+    print "end.";
+}'
@@ -0,0 +1,49 @@
+#!/bin/bash
+
+# CMPT 399 (Winter 2016)
+# Assignment 4: Code Generation
+# By Derrick Gold
+
+# Generates a large MacEwan Teeny Pascal program for benchmarking
+# the compiler. The program is written to stdout.
+
+# Usage: genprog.sh statements [comment lines]
+#
+# With comment lines given, every statement is preceded by a
+# (nested) comment of that many lines.
+
+STATEMENTS=${1:-100000}
+COMMENT_LINES=${2:-0}
+
+awk -v n="$STATEMENTS" -v c="$COMMENT_LINES" 'BEGIN {
+    print "(* generated benchmark program: " n " statements *)";
+    print "const greeting := '"'"'benchmark'"'"';";
+    print "var a, b, c : integer;";
+    print "    values : array(100) of integer;";
+    print "";
+    print "begin";
+    for (i = 0; i < n; i++) {
+        if (i % 50 == 0)
+            printf("\t(* statement %d *)\n", i);
+
+        if (c > 0) {
+            printf("\t(* statement %d\n", i);
+            for (j = 1; j < c; j++)
+                printf("\t *   (* note %d *) keeps a, b and c as they were, line %d\n", j, j);
+            print "\t *)";
+        }
+
+        k = i % 5;
+        if (k == 0)
+            printf("\ta := %d + b * (c - %d);\n", i, i % 97);
+        else if (k == 1)
+            printf("\tvalues(%d) := a div %d;\n", i % 100, i % 13 + 1);
+        else if (k == 2)
+            printf("\tif (a < b) and not (c = %d) then b := b + 1 else c := c - 1;\n", i);
+        else if (k == 3)
+            printf("\tc := values(%d) mod %d;\n", i % 100, i % 7 + 1);
+        else
+            print "\twrite(greeting, a);";
+    }
+    print "end.";
+}'
@@ -0,0 +1,204 @@
+/*
+ * CMPT 399 (Winter 2016)
+ * Assignment 4: Code Generation
+ * Author: Derrick Gold
+ *
+ * Parallel scanner scaling benchmark. Tokenizes a memory-mapped
+ * program source with the parallel scanner over a range of thread
+ * counts, and reports the throughput and speedup of each over a
+ * single thread. Every run's tokens are checked against those of
+ * the regular scanner.
+ *
+ * Usage: parlexbench file [threads...]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "parser.h"
+#include "lexer.h"
+#include "arena.h"
+#include "intern.h"
+#include "source.h"
+#include "parlex.h"
+
+#define ITERATIONS 5
+#define BYTES_PER_MB (1024.0 * 1024.0)
+
+#define HEADER_FMT "%-8s %10s %10s %8s %7s %9s %8s  %s\n"
+#define RESULT_FMT "%-8d %10.3f %10.2f %7.2fx %7zu %9zu %8zu  %s\n"
+
+static const int DEFAULT_THREADS[] = {1, 2, 4, 8, 16};
+
+static double now(void) {
+
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Tokenize a source with the regular scanner, the
+ * tokens are what every parallel run must produce.
+ */
+static int scanReference(Source_t *source, ParLex_t *reference) {
+
+  LexerState_t state;
+  void *scanner = NULL;
+  if (Lexer_init(&state, &scanner))
+    return -1;
+
+  //the source is scanned in place, so scan a copy of it
+  char *buffer = malloc(source->size + SOURCE_PADDING);
+  size_t capacity = 1024;
+  reference->tokens = malloc(capacity * sizeof(LexToken_t));
+  reference->count = 0;
+  if (!buffer || !reference->tokens) {
+    free(buffer);
+    Lexer_destroy(scanner);
+    return -1;
+  }
+  memcpy(buffer, source->buffer, source->size + SOURCE_PADDING);
+  Lexer_scanBuffer(scanner, buffer, source->size);
+
+  //an unterminated string gives its error until the parser stops,
+  //the parallel scanner follows it with the end of file instead
+  LexToken_t token;
+  bool unterminated = false;
+  do {
+    if (unterminated)
+      token = (LexToken_t) {.offset = token.offset, .type = TOK_ENDFILE};
+    else
+      token = Lexer_getToken(scanner);
+
+    if (reference->count == capacity) {
+      capacity <<= 1;
+      LexToken_t *tokens = realloc(reference->tokens, capacity * sizeof(LexToken_t));
+      if (!tokens) {
+        free(buffer);
+        Lexer_destroy(scanner);
+        return -1;
+      }
+      reference->tokens = tokens;
+    }
+    reference->tokens[reference->count++] = token;
+    unterminated = token.type == TOK_ERROR &&
+      Lexer_getContext(scanner, NULL) == LEXCONTEXT_STRING;
+  } while (!LEXTOKEN_ISEOF(token.type));
+
+  Lexer_destroy(scanner);
+  free(buffer);
+  return 0;
+}
+
+/*
+ * Check two scans gave the same tokens. Lexemes are interned
+ * in the same pool, so they are compared by pointer.
+ */
+static bool sameTokens(ParLex_t *a, ParLex_t *b) {
+
+  if (a->count != b->count)
+    return false;
+
+  for (size_t i = 0; i < a->count; i++) {
+    LexToken_t *x = &a->tokens[i], *y = &b->tokens[i];
+    if (x->offset != y->offset || x->type != y->type)
+      return false;
+    if (x->type == TOK_NUM ? x->lexeme.value != y->lexeme.value
+        : x->lexeme.string != y->lexeme.string)
+      return false;
+  }
+
+  return true;
+}
+
+/*
+ * Scan a source with a number of threads, and report the best run.
+ * Returns the time of the best run in seconds, negative on error.
+ */
+static double bench(Source_t *source, ParLex_t *reference, int threads, double base) {
+
+  double best = -1;
+  ParLex_t result;
+  bool same = true;
+  for (int i = 0; i < ITERATIONS; i++) {
+    double start = now();
+    if (ParLex_scan(&result, source->buffer, source->size, threads))
+      return -1;
+    double elapsed = now() - start;
+
+    same = same && sameTokens(&result, reference);
+    if (i < ITERATIONS - 1)
+      ParLex_free(&result);
+    if (best < 0 || elapsed < best)
+      best = elapsed;
+  }
+
+  if (base <= 0)
+    base = best;
+  printf(RESULT_FMT, threads, best * 1000.0,
+         best > 0 ? (source->size / BYTES_PER_MB) / best : 0.0,
+         best > 0 ? base / best : 0.0, result.stats.chunks,
+         result.stats.repaired, result.stats.dropped, same ? "ok" : "MISMATCH");
+
+  ParLex_free(&result);
+  return same ? best : -1;
+}
+
+int main(int argc, char *argv[]) {
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s file [threads...]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  FILE *file = fopen(argv[1], "r");
+  Source_t *source = file ? Source_open(file, true) : NULL;
+  if (!source || !Source_isMapped(source)) {
+    fprintf(stderr, "Error mapping: %s\n", argv[1]);
+    Source_close(source);
+    if (file)
+      fclose(file);
+    return EXIT_FAILURE;
+  }
+
+  Arena_t *arena = Arena_create(ARENA_BLOCK_SIZE);
+  if (!arena) {
+    Source_close(source);
+    fclose(file);
+    return EXIT_FAILURE;
+  }
+  Arena_setActive(arena);
+
+  int status = EXIT_SUCCESS;
+  ParLex_t reference = {0};
+  if (scanReference(source, &reference)) {
+    fprintf(stderr, "Error scanning: %s\n", argv[1]);
+    status = EXIT_FAILURE;
+  }
+
+  printf("%s (%zu bytes, %zu tokens)\n", argv[1], source->size, reference.count);
+  printf(HEADER_FMT, "threads", "ms", "MB/s", "speedup", "chunks", "repaired", "dropped", "tokens");
+
+  int counts = argc > 2 ? argc - 2 : (int)(sizeof(DEFAULT_THREADS) / sizeof(int));
+  double base = -1;
+  for (int i = 0; i < counts && status == EXIT_SUCCESS; i++) {
+    int threads = argc > 2 ? atoi(argv[i + 2]) : DEFAULT_THREADS[i];
+    double elapsed = bench(source, &reference, threads, base);
+    if (elapsed < 0) {
+      fprintf(stderr, "Error scanning with %d thread(s): %s\n", threads, argv[1]);
+      status = EXIT_FAILURE;
+    } else if (base < 0)
+      base = elapsed;
+  }
+
+  ParLex_free(&reference);
+  Intern_reset();
+  Arena_setActive(NULL);
+  Arena_destroy(arena);
+  Source_close(source);
+  fclose(file);
+  return status;
+}
@@ -0,0 +1,127 @@
+/*
+ * CMPT 399 (Winter 2016)
+ * Assignment 4: Code Generation
+ * Author: Derrick Gold
+ *
+ * Parser scaling benchmark. Tokenizes and parses each given program
+ * into an abstract syntax tree, and reports the time taken per token.
+ * Given programs of increasing size, the time per token should stay
+ * the same if parsing scales linearly.
+ *
+ * Usage: parsebench file...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "parser.h"
+#include "lexer.h"
+#include "parserHelper.h"
+#include "tree.h"
+#include "arena.h"
+#include "intern.h"
+#include "source.h"
+
+#define RESULT_FMT "%-20s %10zu tokens %12.3f ms %10.1f ns/token\n"
+
+static double now(void) {
+
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Parse a program once, returns the elapsed time in seconds
+ * or a negative number on error.
+ */
+static double parseOnce(FILE *file, size_t *tokens) {
+
+  Arena_t *arena = Arena_create(ARENA_BLOCK_SIZE);
+  if (!arena)
+    return -1;
+  Arena_setActive(arena);
+
+  LexerState_t lexer;
+  void *scanner = NULL;
+  void *parser = ParseAlloc(malloc);
+  Source_t *source = Source_open(file, true);
+  if (!parser || !source || Lexer_init(&lexer, &scanner)) {
+    if (parser)
+      ParseFree(parser, free);
+    Source_close(source);
+    Arena_destroy(arena);
+    return -1;
+  }
+
+  if (Source_isMapped(source))
+    Lexer_scanBuffer(scanner, source->buffer, source->size);
+  else
+    Lexer_setInput(scanner, source->file);
+
+  ParserState_t state;
+  memset(&state, 0, sizeof(ParserState_t));
+  state.scanner = scanner;
+
+  double start = now();
+
+  size_t count = 0;
+  int type = 0;
+  LexToken_t *tok = NULL;
+  do {
+    LexToken_t token = Lexer_getToken(scanner);
+    type = token.type;
+    count++;
+
+    tok = Lexer_heapifyToken(scanner, token);
+    if (!tok)
+      break;
+
+    Parse(parser, type, tok, &state);
+  } while (!LEXTOKEN_ISEOF(type) && !Parser_hasError(&state));
+
+  double elapsed = now() - start;
+  *tokens = count;
+
+  bool failed = !tok || type == TOK_SYSERR || Parser_hasError(&state);
+
+  ParseFree(parser, free);
+  Lexer_destroy(scanner);
+  Source_close(source);
+  Intern_reset();
+  TreeNode_resetPool();
+  Arena_setActive(NULL);
+  Arena_destroy(arena);
+  return failed ? -1 : elapsed;
+}
+
+int main(int argc, char *argv[]) {
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s file...\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  for (int i = 1; i < argc; i++) {
+    FILE *file = fopen(argv[i], "r");
+    if (!file) {
+      fprintf(stderr, "Error opening: %s\n", argv[i]);
+      return EXIT_FAILURE;
+    }
+
+    size_t tokens = 0;
+    double elapsed = parseOnce(file, &tokens);
+    fclose(file);
+
+    if (elapsed < 0) {
+      fprintf(stderr, "Error parsing: %s\n", argv[i]);
+      return EXIT_FAILURE;
+    }
+
+    printf(RESULT_FMT, argv[i], tokens, elapsed * 1000.0,
+           tokens ? elapsed * 1e9 / tokens : 0.0);
+  }
+
+  return EXIT_SUCCESS;
+}
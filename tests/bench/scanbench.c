@@ -0,0 +1,143 @@
+/*
+ * CMPT 399 (Winter 2016)
+ * Assignment 4: Code Generation
+ * Author: Derrick Gold
+ *
+ * Scanner throughput benchmark. Tokenizes a program source through
+ * both input paths of the compiler (memory-mapped and stdio) and
+ * reports the throughput of each in MB/s, along with the instruction
+ * set whitespace and comments are skipped with.
+ *
+ * Usage: scanbench file [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "parser.h"
+#include "lexer.h"
+#include "arena.h"
+#include "intern.h"
+#include "source.h"
+#include "skip.h"
+
+#define DEFAULT_ITERATIONS 5
+#define BYTES_PER_MB (1024.0 * 1024.0)
+
+#define RESULT_FMT "%-6s %10zu bytes %10zu tokens %10.3f ms %10.2f MB/s\n"
+
+static double now(void) {
+
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Scan a source once, returns the elapsed time in seconds
+ * or a negative number on error.
+ */
+static double scanOnce(const char *path, bool map, size_t *bytes, size_t *tokens) {
+
+  FILE *file = fopen(path, "r");
+  if (!file)
+    return -1;
+
+  Arena_t *arena = Arena_create(ARENA_BLOCK_SIZE);
+  if (!arena) {
+    fclose(file);
+    return -1;
+  }
+  Arena_setActive(arena);
+
+  LexerState_t state;
+  void *scanner = NULL;
+  if (Lexer_init(&state, &scanner)) {
+    Arena_destroy(arena);
+    fclose(file);
+    return -1;
+  }
+
+  double start = now();
+
+  Source_t *source = Source_open(file, map);
+  if (!source) {
+    Lexer_destroy(scanner);
+    Arena_destroy(arena);
+    fclose(file);
+    return -1;
+  }
+
+  if (Source_isMapped(source))
+    Lexer_scanBuffer(scanner, source->buffer, source->size);
+  else
+    Lexer_setInput(scanner, source->file);
+
+  size_t count = 0;
+  LexToken_t token;
+  do {
+    token = Lexer_getToken(scanner);
+    count++;
+  } while (!LEXTOKEN_ISEOF(token.type));
+
+  double elapsed = now() - start;
+
+  //flex counts consumed bytes in neither mode, so use the file size
+  if (Source_isMapped(source))
+    *bytes = source->size;
+  else {
+    fseek(source->file, 0, SEEK_END);
+    *bytes = (size_t)ftell(source->file);
+  }
+  *tokens = count;
+
+  Lexer_destroy(scanner);
+  Source_close(source);
+  Intern_reset();
+  Arena_setActive(NULL);
+  Arena_destroy(arena);
+  fclose(file);
+  return elapsed;
+}
+
+/*
+ * Scan a source a number of times, and report the best run.
+ */
+static int bench(const char *name, const char *path, bool map, int iterations) {
+
+  double best = -1;
+  size_t bytes = 0, tokens = 0;
+  for (int i = 0; i < iterations; i++) {
+    double elapsed = scanOnce(path, map, &bytes, &tokens);
+    if (elapsed < 0) {
+      fprintf(stderr, "Error scanning: %s\n", path);
+      return -1;
+    }
+
+    if (best < 0 || elapsed < best)
+      best = elapsed;
+  }
+
+  printf(RESULT_FMT, name, bytes, tokens, best * 1000.0,
+         best > 0 ? (bytes / BYTES_PER_MB) / best : 0.0);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s file [iterations]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  int iterations = argc > 2 ? atoi(argv[2]) : DEFAULT_ITERATIONS;
+  if (iterations < 1)
+    iterations = 1;
+
+  printf("%s (skipping with %s)\n", argv[1], Skip_method());
+  if (bench("mmap", argv[1], true, iterations) || bench("stdio", argv[1], false, iterations))
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
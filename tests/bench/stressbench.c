@@ -0,0 +1,81 @@
+/*
+ * CMPT 399 (Winter 2016)
+ * Assignment 4: Code Generation
+ * Author: Derrick Gold
+ *
+ * Compiler stress benchmark. Compiles each given program (typically
+ * very long, or very deeply nested) from start to finish, discarding
+ * the generated assembly, and reports how long each one took.
+ *
+ * Usage: stressbench file...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "libmtp.h"
+
+#define RESULT_FMT "%-20s %12lld bytes %12.3f ms  %s\n"
+
+static double now(void) {
+
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Compile a program once and report the result.
+ * Returns 0 if the program compiled.
+ */
+static int stress(const char *path) {
+
+  FILE *in = fopen(path, "r");
+  if (!in) {
+    fprintf(stderr, "Error opening: %s\n", path);
+    return -1;
+  }
+
+  FILE *out = fopen("/dev/null", "w");
+  MtpContext_t *ctx = MtpContext_create();
+  if (!out || !ctx) {
+    fprintf(stderr, "Error setting up compilation of: %s\n", path);
+    if (out)
+      fclose(out);
+    MtpContext_destroy(ctx);
+    fclose(in);
+    return -1;
+  }
+
+  struct stat info;
+  long long bytes = fstat(fileno(in), &info) ? -1 : (long long)info.st_size;
+
+  double start = now();
+  int status = mtp_compile(ctx, in, out);
+  double elapsed = now() - start;
+
+  printf(RESULT_FMT, path, bytes, elapsed * 1000.0,
+         status == EXIT_SUCCESS ? "ok" : "FAILED");
+
+  MtpContext_destroy(ctx);
+  fclose(out);
+  fclose(in);
+  return status == EXIT_SUCCESS ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s file...\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  int failed = 0;
+  for (int i = 1; i < argc; i++) {
+    if (stress(argv[i]))
+      failed++;
+  }
+
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,141 @@
+/*
+ * CMPT 399 (Winter 2016)
+ * Assignment 4: Code Generation
+ * Author: Derrick Gold
+ *
+ * Symbol table benchmark. Adds a number of distinct identifiers to
+ * a single symbol table, then looks each of them up again (in a
+ * different order), followed by as many identifiers that were never
+ * added. Reports the best of a few runs of each, per operation.
+ *
+ * Usage: symtabbench [identifiers]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "arena.h"
+#include "intern.h"
+#include "symtab.h"
+
+#define ITERATIONS 3
+#define DEFAULT_COUNT 1000000
+
+//initial size of the table, the same as a scope's in analyze.c
+#define TABLE_BASE_SIZE 71
+
+//identifiers are looked up in steps of this (a prime), modulo the count
+#define LOOKUP_STRIDE 7919
+
+#define NAME_LEN 32
+#define HEADER_FMT "%-8s %12s %10s  %s\n"
+#define RESULT_FMT "%-8s %12.3f %10.1f  %s\n"
+
+static double now(void) {
+
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//intern 'count' identifiers made from a prefix and a number
+static char **makeKeys(const char *prefix, size_t count) {
+
+  char **keys = malloc(count * sizeof(char *));
+  if (!keys)
+    return NULL;
+
+  char name[NAME_LEN];
+  for (size_t i = 0; i < count; i++) {
+    snprintf(name, NAME_LEN, "%s%zu", prefix, i);
+    if (!(keys[i] = Intern_string(name))) {
+      free(keys);
+      return NULL;
+    }
+  }
+
+  return keys;
+}
+
+static void report(const char *name, double best, size_t count, bool ok) {
+
+  printf(RESULT_FMT, name, best * 1000.0, best * 1e9 / count, ok ? "ok" : "MISMATCH");
+}
+
+int main(int argc, char *argv[]) {
+
+  size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_COUNT;
+  if (count < 1) {
+    fprintf(stderr, "Usage: %s [identifiers]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  Arena_t *arena = Arena_create(ARENA_BLOCK_SIZE);
+  if (!arena)
+    return EXIT_FAILURE;
+  Arena_setActive(arena);
+
+  int status = EXIT_SUCCESS;
+  char **keys = makeKeys("id", count), **missing = makeKeys("missing", count);
+  Symbol_t **symbols = malloc(count * sizeof(Symbol_t *));
+  for (size_t i = 0; symbols && keys && i < count; i++) {
+    symdata data = {.value = (int)i};
+    if (!(symbols[i] = Symbol_create(keys[i], data, SYMTYPE_INT(SYMTYPE_VARIABLE))))
+      break;
+  }
+  if (!keys || !missing || !symbols || !symbols[count - 1]) {
+    fprintf(stderr, "Error creating %zu identifiers\n", count);
+    status = EXIT_FAILURE;
+  }
+
+  double bestAdd = -1, bestFind = -1, bestMiss = -1;
+  bool added = true, found = true, missed = true;
+  SymTable_t *table = NULL;
+  for (int run = 0; run < ITERATIONS && status == EXIT_SUCCESS; run++) {
+    //every run starts from a table as small as a new scope's
+    table = SymTable_init(TABLE_BASE_SIZE);
+    if (!table) {
+      status = EXIT_FAILURE;
+      break;
+    }
+
+    double start = now();
+    for (size_t i = 0; i < count; i++)
+      added = SymTable_add(table, symbols[i]) && added;
+    double elapsed = now() - start;
+    if (bestAdd < 0 || elapsed < bestAdd)
+      bestAdd = elapsed;
+
+    start = now();
+    for (size_t i = 0, k = 0; i < count; i++, k = (k + LOOKUP_STRIDE) % count)
+      found = SymTable_find(table, keys[k]) == symbols[k] && found;
+    elapsed = now() - start;
+    if (bestFind < 0 || elapsed < bestFind)
+      bestFind = elapsed;
+
+    start = now();
+    for (size_t i = 0; i < count; i++)
+      missed = !SymTable_find(table, missing[i]) && missed;
+    elapsed = now() - start;
+    if (bestMiss < 0 || elapsed < bestMiss)
+      bestMiss = elapsed;
+  }
+
+  if (status == EXIT_SUCCESS) {
+    printf("%zu identifiers, table of %zu slots\n", count, table->capacity);
+    printf(HEADER_FMT, "op", "ms", "ns/op", "result");
+    report("add", bestAdd, count, added && table->count == count);
+    report("find", bestFind, count, found);
+    report("miss", bestMiss, count, missed);
+    if (!added || !found || !missed)
+      status = EXIT_FAILURE;
+  }
+
+  free(keys);
+  free(missing);
+  free(symbols);
+  Intern_reset();
+  Arena_setActive(NULL);
+  Arena_destroy(arena);
+  return status;
+}
@@ -0,0 +1,38 @@
+#!/bin/bash
+
+# CMPT 399 (Winter 2016)
+# Assignment 4: Code Generation
+# By Derrick Gold
+
+# Times the array benchmark programs (sieve.mtp and bubble.mtp, each
+# compiled with and without optimizations), reporting the best of a
+# few runs of each, along with what it wrote.
+
+# Usage: timearrays.sh iterations program...
+
+RUNS=3
+ITERATIONS=$1
+shift
+
+# best time of a program in nanoseconds, followed by what it wrote
+best() {
+    local best= output=
+    for ((run = 0; run < RUNS; run++)); do
+        local start=$(date +%s%N)
+        output=$(echo "$ITERATIONS" | "$1" | tr '\n' ' ')
+        local elapsed=$(($(date +%s%N) - start))
+        if [ -z "$best" ] || [ "$elapsed" -lt "$best" ]; then
+            best=$elapsed
+        fi
+    done
+    echo "$best $output"
+}
+
+echo "$ITERATIONS iterations of each program"
+printf "%-20s %10s  %s\n" "program" "ms" "output"
+for program in "$@"; do
+    read elapsed OUTPUT <<< "$(best "./$program")"
+    awk -v p="$program" -v t="$elapsed" -v o="$OUTPUT" 'BEGIN {
+        printf("%-20s %10.1f  %s\n", p, t / 1e6, o);
+    }'
+done
@@ -0,0 +1,42 @@
+#!/bin/bash
+
+# CMPT 399 (Winter 2016)
+# Assignment 4: Code Generation
+# By Derrick Gold
+
+# Times the case statement dispatch benchmark programs (compiled from
+# gendispatch.sh), reporting the best of a few runs of each. The first
+# program is the loop without a case statement, its time is taken off
+# the others to give the cost of a single dispatch.
+
+# Usage: timedispatch.sh iterations loop-program program...
+
+RUNS=3
+ITERATIONS=$1
+shift
+
+# best time of a program in nanoseconds, followed by what it wrote
+best() {
+    local best= hits=
+    for ((run = 0; run < RUNS; run++)); do
+        local start=$(date +%s%N)
+        hits=$(echo "$ITERATIONS" | "$1")
+        local elapsed=$(($(date +%s%N) - start))
+        if [ -z "$best" ] || [ "$elapsed" -lt "$best" ]; then
+            best=$elapsed
+        fi
+    done
+    echo "$best $hits"
+}
+
+read LOOP HITS <<< "$(best "./$1")"
+shift
+
+echo "$ITERATIONS dispatches, loop alone took $((LOOP / 1000000)) ms"
+printf "%-20s %10s %14s  %s\n" "program" "ms" "ns/dispatch" "hits"
+for program in "$@"; do
+    read elapsed HITS <<< "$(best "./$program")"
+    awk -v p="$program" -v t="$elapsed" -v l="$LOOP" -v n="$ITERATIONS" -v h="$HITS" 'BEGIN {
+        printf("%-20s %10.1f %14.2f  %s\n", p, t / 1e6, (t - l) / n, h);
+    }'
+done
@@ -0,0 +1,43 @@
+#!/bin/bash
+
+# CMPT 399 (Winter 2016)
+# Assignment 4: Code Generation
+# By Derrick Gold
+
+# Feeds a program through a pipe, which flex reads in chunks of 8 KiB
+# rather than all at once like a file, with a nested comment's "(*"
+# straddling the end of the first chunk. The program only compiles if
+# the "(*" is still seen as opening a comment once the rest is read.
+
+CURDIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
+program="$CURDIR/../../mtp"
+
+#bytes flex reads from a stream at a time
+CHUNK=8192
+
+if [ ! -x $program ]; then
+    echo "[Error]: $program not found."
+    exit 1
+fi
+
+head="var a : integer;
+begin
+(* outer comment "
+#pad the outer comment so its "(*" starts on the last byte of the chunk
+padding=$((CHUNK - 1 - ${#head}))
+
+output=$({
+    printf "%s" "$head"
+    printf "%${padding}s" "" | tr ' ' 'x'
+    printf "(* nested *) still the outer comment *)\na := 1;\nwrite(a)\nend.\n"
+} | $program -o /dev/null /dev/stdin 2>&1)
+
+if [ $? -eq 0 ] && [ -z "$output" ]; then
+    echo "[Success]: comment straddling a read through a pipe completed."
+else
+    echo "[Failed]: comment straddling a read through a pipe unexpected output."
+    echo "$output"
+    exit 1
+fi
+
+exit 0
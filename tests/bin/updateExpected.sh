@@ -37,7 +37,7 @@ IFS=$'\n'
 for f in $(find "$TESTDIR" -depth 1 -type f |  egrep ".*\.$INPUT_EXT" | \
 			sed -e "s/\.$INPUT_EXT//"); do
     IFS=$OLDIFS
-    "$TESTSCRIPT" -v "$f"."$INPUT_EXT" &>  "$f"."$EXPECTED_EXT"
+    "$TESTSCRIPT" -v -O0 "$f"."$INPUT_EXT" &>  "$f"."$EXPECTED_EXT"
     IFS=$'\n'
 done
 
@@ -0,0 +1,134 @@
+/*
+ * CMPT 399 (Winter 2016)
+ * Assignment 4: Code Generation
+ * Author: Derrick Gold
+ *
+ * Token Queue API
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#include "tokenq.h"
+
+//times the other side's index is checked before yielding the CPU
+#define SPIN_LIMIT 64
+
+#define SLOT(queue, index) ((queue)->slots[(index) & (TOKENQ_SIZE - 1)])
+
+#define LOAD(index) __atomic_load_n(&(index), __ATOMIC_ACQUIRE)
+#define STORE(index, value) __atomic_store_n(&(index), (value), __ATOMIC_RELEASE)
+
+
+int TokenQueue_init(TokenQueue_t *queue) {
+
+  if (!queue)
+    return -1;
+
+  memset(queue, 0, sizeof(TokenQueue_t));
+  queue->slots = malloc(TOKENQ_SIZE * sizeof(LexToken_t));
+  if (!queue->slots) {
+    fprintf(stderr, "TokenQueue: Error allocating ring\n");
+    return -1;
+  }
+
+  return 0;
+}
+
+
+int TokenQueue_push(TokenQueue_t *queue, LexToken_t token) {
+
+  if (queue->written - queue->headSeen == TOKENQ_SIZE) {
+    queue->headSeen = LOAD(queue->head);
+
+    if (queue->written - queue->headSeen == TOKENQ_SIZE) {
+      queue->producerWaits++;
+      //the consumer can't free up slots without seeing every token
+      TokenQueue_flush(queue);
+
+      for (int spins = 0; queue->written - queue->headSeen == TOKENQ_SIZE; spins++) {
+        if (LOAD(queue->closed))
+          return -1;
+        if (spins >= SPIN_LIMIT)
+          sched_yield();
+        queue->headSeen = LOAD(queue->head);
+      }
+    }
+  }
+
+  SLOT(queue, queue->written) = token;
+  queue->written++;
+  if (queue->written - queue->tail >= TOKENQ_BATCH) {
+    TokenQueue_flush(queue);
+    if (LOAD(queue->closed))
+      return -1;
+  }
+
+  return 0;
+}
+
+
+void TokenQueue_flush(TokenQueue_t *queue) {
+
+  if (queue->written == queue->tail)
+    return;
+
+  STORE(queue->tail, queue->written);
+  queue->batches++;
+}
+
+
+LexToken_t TokenQueue_pop(TokenQueue_t *queue) {
+
+  if (queue->read == queue->tailSeen) {
+    queue->tailSeen = LOAD(queue->tail);
+
+    if (queue->read == queue->tailSeen) {
+      queue->consumerWaits++;
+      //the producer may be waiting on the slots read so far
+      STORE(queue->head, queue->read);
+
+      for (int spins = 0; queue->read == queue->tailSeen; spins++) {
+        if (spins >= SPIN_LIMIT)
+          sched_yield();
+        queue->tailSeen = LOAD(queue->tail);
+      }
+    }
+  }
+
+  LexToken_t token = SLOT(queue, queue->read);
+  queue->read++;
+  if (queue->read - queue->head >= TOKENQ_BATCH)
+    STORE(queue->head, queue->read);
+
+  return token;
+}
+
+
+void TokenQueue_close(TokenQueue_t *queue) {
+
+  STORE(queue->closed, true);
+}
+
+
+void TokenQueue_getStats(TokenQueue_t *queue, TokenQueueStats_t *stats) {
+
+  if (!queue || !stats)
+    return;
+
+  stats->tokens = queue->written;
+  stats->batches = queue->batches;
+  stats->producerWaits = queue->producerWaits;
+  stats->consumerWaits = queue->consumerWaits;
+}
+
+
+void TokenQueue_free(TokenQueue_t *queue) {
+
+  if (!queue)
+    return;
+
+  free(queue->slots);
+  queue->slots = NULL;
+}
@@ -0,0 +1,139 @@
+/*
+ * CMPT 399 (Winter 2016)
+ * Assignment 4: Code Generation
+ * Author: Derrick Gold
+ *
+ * Token Queue API
+ *
+ * A fixed size ring of tokens passed from exactly one producing
+ * thread (the scanner) to exactly one consuming thread (the parser),
+ * without any locks. Each side owns one index of the ring and only
+ * reads the other's.
+ *
+ * Tokens are handed over in batches: the producer only makes its
+ * tokens visible to the consumer every TOKENQ_BATCH tokens, and the
+ * consumer only gives slots back as often, so the cache lines holding
+ * the indices move between the two cores once per batch rather than
+ * once per token. A side that finds the ring full (or empty) spins
+ * briefly, then yields its CPU until the other side catches up.
+ */
+#ifndef __TOKENQ_H__
+#define __TOKENQ_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "lexer.h"
+#include "defines.h"
+
+//number of tokens the ring holds, must be a power of two
+#define TOKENQ_SIZE 4096
+
+//number of tokens published (or released) at once
+#define TOKENQ_BATCH 64
+
+typedef struct TokenQueueStats_s {
+  size_t tokens;         //tokens passed through the queue
+  size_t batches;        //batches published by the producer
+  size_t producerWaits;  //times the producer found the ring full
+  size_t consumerWaits;  //times the consumer found the ring empty
+} TokenQueueStats_t;
+
+typedef struct TokenQueue_s {
+  LexToken_t *slots;
+
+  //written by the producer only: tokens published, and written
+  CACHE_ALIGNED size_t tail;
+  size_t written, headSeen;
+  size_t batches, producerWaits;
+
+  //written by the consumer only: tokens released, and read
+  CACHE_ALIGNED size_t head;
+  size_t read, tailSeen;
+  size_t consumerWaits;
+
+  //set by the consumer when it stops taking tokens early
+  CACHE_ALIGNED bool closed;
+} TokenQueue_t;
+
+/*
+ * TokenQueue_init:
+ *  Initialize an empty queue.
+ *
+ * Arguments:
+ *  queue: The queue to initialize.
+ *
+ * Returns:
+ *  0 on success, -1 on error.
+ */
+int TokenQueue_init(TokenQueue_t *queue);
+
+/*
+ * TokenQueue_push:
+ *  Add a token to the queue, waiting for room if the ring is full.
+ *  Only called by the producer. The token may not be seen by the
+ *  consumer until the batch it is in is full, or is flushed.
+ *
+ * Arguments:
+ *  queue: The queue to add to.
+ *  token: The token to add.
+ *
+ * Returns:
+ *  0 on success, -1 if the consumer closed the queue (which is
+ *  checked whenever a batch is published).
+ */
+int TokenQueue_push(TokenQueue_t *queue, LexToken_t token);
+
+/*
+ * TokenQueue_flush:
+ *  Publish the tokens pushed so far, even if their batch isn't
+ *  full. Only called by the producer.
+ *
+ * Arguments:
+ *  queue: The queue to publish the tokens of.
+ */
+void TokenQueue_flush(TokenQueue_t *queue);
+
+/*
+ * TokenQueue_pop:
+ *  Take the oldest token from the queue, waiting for one to be
+ *  published if there are none. Only called by the consumer.
+ *
+ * Arguments:
+ *  queue: The queue to take from.
+ *
+ * Returns:
+ *  The token taken.
+ */
+LexToken_t TokenQueue_pop(TokenQueue_t *queue);
+
+/*
+ * TokenQueue_close:
+ *  Stop taking tokens from a queue, so a producer waiting on the
+ *  queue gives up. Only called by the consumer.
+ *
+ * Arguments:
+ *  queue: The queue to close.
+ */
+void TokenQueue_close(TokenQueue_t *queue);
+
+/*
+ * TokenQueue_getStats:
+ *  Get the counters of a queue once both threads are done with it.
+ *
+ * Arguments:
+ *  queue: The queue to get the counters of.
+ *  stats: Where to store the counters.
+ */
+void TokenQueue_getStats(TokenQueue_t *queue, TokenQueueStats_t *stats);
+
+/*
+ * TokenQueue_free:
+ *  Free the memory used by a queue.
+ *
+ * Arguments:
+ *  queue: The queue to free.
+ */
+void TokenQueue_free(TokenQueue_t *queue);
+
+#endif //__TOKENQ_H__
@@ -8,7 +8,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include "tree.h"
+#include "arena.h"
+#include "defines.h"
 
 /*
  * Set the number of spaces to indent
@@ -16,6 +19,9 @@
  */
 #define DEPTH_TAB_SIZE 4
 
+//initial number of nesting levels the traversal stack can hold
+#define TRAVERSE_BASE_DEPTH 64
+
 #define CASE_ARGC_TEXT "Case Count: %d\n"
 #define ARGC_TEXT "Arguments: %d\n"
 
@@ -69,17 +75,185 @@ const char *NODE_RETURNTYPE_TEXT[] = {
 };
 
 /*
- * Find the last sibling of a node.
+ * Rules for deriving the kind of a node. A node takes the kind of
+ * the first rule whose types it all has, so a rule with more types
+ * must come before the rules with a subset of its types.
+ */
+static const struct {
+  unsigned long long types;
+  NodeKind kind;
+} KIND_RULES[] = {
+  { NODETYPE_BIT(STMT_LIST), NODEKIND_STMT_LIST },
+  { NODETYPE_BIT(READ_STMT), NODEKIND_READ_STMT },
+  { NODETYPE_BIT(WRITE_STMT), NODEKIND_WRITE_STMT },
+  { NODETYPE_BIT(CASE_STMT), NODEKIND_CASE_STMT },
+  { NODETYPE_BIT(WHILE_STMT), NODEKIND_WHILE_STMT },
+  { NODETYPE_BIT(IF_STMT), NODEKIND_IF_STMT },
+  { NODETYPE_BIT(ASSIGN_STMT), NODEKIND_ASSIGN_STMT },
+  { NODETYPE_BIT(BLOCK_STMT), NODEKIND_BLOCK_STMT },
+  { NODETYPE_BIT(RELOP), NODEKIND_RELOP },
+  { NODETYPE_BIT(BINOP), NODEKIND_BINOP },
+  { NODETYPE_BIT(MULOP), NODEKIND_MULOP },
+  { NODETYPE_BIT(UNARYOP), NODEKIND_UNARYOP },
+  { NODETYPE_BIT(VARIABLE) | NODETYPE_BIT(ARRAY), NODEKIND_ARRAY },
+  { NODETYPE_BIT(VARIABLE), NODEKIND_VARIABLE },
+  { NODETYPE_BIT(CONSTANT), NODEKIND_CONSTANT },
+};
+
+/*
+ * A chunk of the node pool. The side tables hold the types and
+ * references of the node at the same position in the chunk.
+ */
+typedef struct NodeChunk_s {
+  //pool index of the chunk's first node
+  NodeIndex first;
+  TreeNode_t nodes[TREENODE_CHUNK_SIZE];
+  NodeType types[TREENODE_CHUNK_SIZE];
+  LexToken_t *tokens[TREENODE_CHUNK_SIZE];
+  Symbol_t *entries[TREENODE_CHUNK_SIZE];
+  SymTable_t *tables[TREENODE_CHUNK_SIZE];
+  CaseLabels_t *labels[TREENODE_CHUNK_SIZE];
+} NodeChunk_t;
+
+//fails to compile if TREENODE_CHUNK_SIZE nodes don't fit in a chunk
+typedef char NodeChunkFits_t[sizeof(NodeChunk_t) <= TREENODE_CHUNK_BYTES ? 1 : -1];
+
+typedef struct NodePool_s {
+  NodeChunk_t **chunks;
+  size_t chunkCount, chunkSlots;
+  //aligned chunks reserved, but not yet added to the pool
+  char *spare;
+  size_t spareCount;
+  //index of the next node, index 0 is never used (TREENODE_NONE)
+  NodeIndex next;
+  //nodes handed back by TreeNode_free, linked by their sibling index
+  NodeIndex freed;
+  size_t reused;
+} NodePool_t;
+
+//chunk, and position within the chunk, of a node index
+#define CHUNK_OF(index) (pool->chunks[(index) / TREENODE_CHUNK_SIZE])
+#define SLOT_OF(index) ((index) % TREENODE_CHUNK_SIZE)
+
+//chunk, and position within the chunk, of a node
+#define NODE_CHUNK(node) \
+  ((NodeChunk_t *)((uintptr_t)(node) & ~(uintptr_t)(TREENODE_CHUNK_BYTES - 1)))
+#define NODE_SLOT(node) ((node) - NODE_CHUNK(node)->nodes)
+
+//pool index of a node
+#define NODE_INDEX(node) (NODE_CHUNK(node)->first + (NodeIndex)NODE_SLOT(node))
+
+//side table entry of a node
+#define NODE_SIDE(node, table) (NODE_CHUNK(node)->table[NODE_SLOT(node)])
+
+//number of chunk pointers the pool starts with
+#define POOL_BASE_CHUNKS 16
+
+//most chunks reserved at once
+#define POOL_MAX_SPARE 8
+
+//node pool of the compilation running on this thread
+static THREAD_LOCAL NodePool_t *pool = NULL;
+
+/*
+ * A node being visited by TreeNode_traverse, and the
+ * index of the next child to visit below it.
+ */
+typedef struct TraverseFrame_s {
+  TreeNode_t *node;
+  int depth;
+  int nextChild;
+} TraverseFrame_t;
+
+/*
+ * Find the last sibling of a node. The search starts from the
+ * last sibling found before, and remembers where it ended up.
  */
 static TreeNode_t *lastSibling(TreeNode_t *start) {
 
-  TreeNode_t *next = start;
+  TreeNode_t *next = start->lastSibling ? TreeNode_fromIndex(start->lastSibling) : start;
   while (next->sibling)
-    next = next->sibling;
+    next = TreeNode_fromIndex(next->sibling);
 
+  start->lastSibling = NODE_INDEX(next);
   return next;
 }
 
+/*
+ * Create the node pool in the active arena.
+ */
+static NodePool_t *initPool(void) {
+
+  Arena_t *arena = Arena_getActive();
+  NodePool_t *newPool = Arena_alloc(arena, sizeof(NodePool_t));
+  if (!newPool) {
+    fprintf(stderr, "TreeNode: Error allocating node pool\n");
+    return NULL;
+  }
+
+  newPool->chunkSlots = POOL_BASE_CHUNKS;
+  newPool->chunks = Arena_alloc(arena, newPool->chunkSlots * sizeof(NodeChunk_t *));
+  if (!newPool->chunks) {
+    fprintf(stderr, "TreeNode: Error allocating node pool chunks\n");
+    return NULL;
+  }
+
+  newPool->next = TREENODE_NONE + 1;
+  return newPool;
+}
+
+/*
+ * Reserve chunks aligned to their size. Aligning a chunk may skip up
+ * to a chunk's worth of bytes, so more chunks are reserved as the
+ * pool grows to share that cost. Returns 0 on success.
+ */
+static int reserveChunks(Arena_t *arena) {
+
+  size_t count = pool->chunkCount ? pool->chunkCount : 1;
+  if (count > POOL_MAX_SPARE)
+    count = POOL_MAX_SPARE;
+
+  //the arena aligns to ARENA_ALIGNMENT, at most the rest is skipped
+  char *mem = Arena_alloc(arena, (count + 1) * TREENODE_CHUNK_BYTES - ARENA_ALIGNMENT);
+  if (!mem)
+    return -1;
+
+  uintptr_t aligned = ((uintptr_t)mem + TREENODE_CHUNK_BYTES - 1) & ~(uintptr_t)(TREENODE_CHUNK_BYTES - 1);
+  pool->spare = (char *)aligned;
+  pool->spareCount = count;
+  return 0;
+}
+
+/*
+ * Add another chunk of nodes to the pool. Returns 0 on success.
+ */
+static int addChunk(void) {
+
+  Arena_t *arena = Arena_getActive();
+  if (pool->chunkCount == pool->chunkSlots) {
+    //the old table stays in the arena, chunks themselves never move
+    size_t slots = pool->chunkSlots << 1;
+    NodeChunk_t **chunks = Arena_alloc(arena, slots * sizeof(NodeChunk_t *));
+    if (!chunks)
+      return -1;
+
+    memcpy(chunks, pool->chunks, pool->chunkCount * sizeof(NodeChunk_t *));
+    pool->chunks = chunks;
+    pool->chunkSlots = slots;
+  }
+
+  if (!pool->spareCount && reserveChunks(arena))
+    return -1;
+
+  NodeChunk_t *chunk = (NodeChunk_t *)pool->spare;
+  pool->spare += TREENODE_CHUNK_BYTES;
+  pool->spareCount--;
+
+  chunk->first = pool->chunkCount * TREENODE_CHUNK_SIZE;
+  pool->chunks[pool->chunkCount++] = chunk;
+  return 0;
+}
+
 /*
  * Set a child node in a parent node.
  */
@@ -93,24 +267,13 @@ TreeNode_t *TreeNode_setChild(TreeNode_t *parent, TreeNode_t *child, unsigned ch
   if (childPos >= TREENODE_CHILD_MAX || childPos < 0)
     return NULL;
   
-  parent->child[(unsigned int)childPos] = child;
+  parent->child[(unsigned int)childPos] = NODE_INDEX(child);
   //indicate the node we are adding is a child node
   child->isChild = true;
   return child;
 }
 
 
-/*
- * Helper function for TreeNode_destory. It gets passed into
- * a TreeNode_traverse function call.
- */
-static int deleteHelper(int depth, TreeNode_t *node, void *data) {
-
-  TreeNode_destroyNode(node);
-  //keep traversing the tree
-  return 0;
-}
-
 /*
  * Helper function for TreeNode_print. It gets passed into
  * a TreeNode_traverse function call.
@@ -128,19 +291,81 @@ static int traversePrint(int depth, TreeNode_t *node, void *data) {
 
 TreeNode_t *TreeNode_newNode(NodeType type, LexToken_t *token) {
 
-  TreeNode_t *node = calloc(1, sizeof(TreeNode_t));
-  if (!node)
+  //nodes live in the compilation arena, and are freed with it
+  if (!pool && !(pool = initPool()))
     return NULL;
-  
-  node->type = NODETYPE_BIT(type);
-  node->numChild = 0;
-  node->token = token;
+
+  //reuse a freed node before taking a new one from the pool
+  NodeIndex index = pool->freed;
+  if (index != TREENODE_NONE) {
+    pool->freed = TreeNode_fromIndex(index)->sibling;
+    pool->reused++;
+  } else {
+    index = pool->next;
+    if (index == UINT32_MAX)
+      return NULL;
+
+    if (index / TREENODE_CHUNK_SIZE >= pool->chunkCount && addChunk())
+      return NULL;
+
+    pool->next++;
+  }
+
+  TreeNode_t *node = &CHUNK_OF(index)->nodes[SLOT_OF(index)];
+  memset(node, 0, sizeof(TreeNode_t));
   node->argc = -1;
+  CHUNK_OF(index)->types[SLOT_OF(index)] = NODETYPE_BIT(type);
+  CHUNK_OF(index)->tokens[SLOT_OF(index)] = token;
+  CHUNK_OF(index)->entries[SLOT_OF(index)] = NULL;
+  CHUNK_OF(index)->tables[SLOT_OF(index)] = NULL;
+  CHUNK_OF(index)->labels[SLOT_OF(index)] = NULL;
   
   return node;
 }
 
 
+TreeNode_t *TreeNode_fromIndex(NodeIndex index) {
+
+  if (index == TREENODE_NONE || !pool)
+    return NULL;
+
+  return &CHUNK_OF(index)->nodes[SLOT_OF(index)];
+}
+
+void TreeNode_free(TreeNode_t *node) {
+
+  if (!node || !pool)
+    return;
+
+  NODE_SIDE(node, types) = 0;
+  node->sibling = pool->freed;
+  pool->freed = NODE_INDEX(node);
+}
+
+
+TreeNode_t *TreeNode_removeChild(TreeNode_t *parent, int childNum) {
+
+  TreeNode_t *child = TreeNode_getChild(parent, childNum);
+  if (child)
+    parent->child[childNum] = TREENODE_NONE;
+
+  return child;
+}
+
+
+size_t TreeNode_count(void) {
+  return pool ? pool->next - 1 : 0;
+}
+
+size_t TreeNode_reusedCount(void) {
+  return pool ? pool->reused : 0;
+}
+
+void TreeNode_resetPool(void) {
+  pool = NULL;
+}
+
+
 TreeNode_t *TreeNode_addSibling(TreeNode_t *start, TreeNode_t *sibnode) {
   
   if (!start || !sibnode)
@@ -149,7 +374,9 @@ TreeNode_t *TreeNode_addSibling(TreeNode_t *start, TreeNode_t *sibnode) {
   //get the last node of the start nodes siblings
   TreeNode_t *lastSib = lastSibling(start);
   //add sibling to the last node
-  lastSib->sibling = sibnode;
+  lastSib->sibling = NODE_INDEX(sibnode);
+  //the list now ends with the last of the added node's siblings
+  start->lastSibling = NODE_INDEX(lastSibling(sibnode));
 
   //mark the sibling node as a sibling
   sibnode->isSibling = true;
@@ -157,66 +384,74 @@ TreeNode_t *TreeNode_addSibling(TreeNode_t *start, TreeNode_t *sibnode) {
 }
 
 
-void TreeNode_destroyNode(TreeNode_t *node) {
-
-  if (!node)
-    return;
-  
-  //free token data if necessary
-  if (node->token)
-    Lexer_tokenDestructor(node->token);
-
-  if (node->symbols)
-    SymTable_destroy(node->symbols);  
-  
-  memset(node, 0, sizeof(TreeNode_t));
-  free(node);
-}
-
-
 int TreeNode_traverse(int depth, TreeNode_t *root, void *data, int (*pre)(int, TreeNode_t *, void *),
           int (*post)(int, TreeNode_t *, void *)) {
-  
+
   if (root == NULL)
     //return 0 for all ok
     return 0;
 
-  if (pre) {
-    int rtrn = pre(depth, root, data);
-    if (rtrn)
-      return rtrn;
+  //nodes whose children are being visited, siblings are visited
+  //in place of the node before them so only nesting uses the stack
+  size_t size = TRAVERSE_BASE_DEPTH, top = 0;
+  TraverseFrame_t *stack = malloc(size * sizeof(TraverseFrame_t));
+  if (!stack) {
+    fprintf(stderr, "TreeNode_traverse: Error allocating traversal stack\n");
+    return -1;
   }
 
-  //visit all children first
-  int i = 0;
-  for (i = 0; i < TREENODE_CHILD_MAX; i++) {
-
-    if (!root->child[i])
+  int rtrn = 0;
+  stack[top++] = (TraverseFrame_t){.node = root, .depth = depth, .nextChild = -1};
+
+  while (top > 0) {
+    TraverseFrame_t *frame = &stack[top - 1];
+    TreeNode_t *node = frame->node;
+
+    //first time seeing this node
+    if (frame->nextChild < 0) {
+      frame->nextChild = 0;
+      //allow tree to short circuit if pre or post return non-zero value
+      if (pre && (rtrn = pre(frame->depth, node, data)))
+        break;
+    }
+
+    //visit all children first
+    while (frame->nextChild < TREENODE_CHILD_MAX && !node->child[frame->nextChild])
+      frame->nextChild++;
+
+    if (frame->nextChild < TREENODE_CHILD_MAX) {
+      TreeNode_t *child = TreeNode_fromIndex(node->child[frame->nextChild++]);
+      if (top == size) {
+        TraverseFrame_t *grown = realloc(stack, (size << 1) * sizeof(TraverseFrame_t));
+        if (!grown) {
+          fprintf(stderr, "TreeNode_traverse: Error growing traversal stack\n");
+          rtrn = -1;
+          break;
+        }
+        stack = grown;
+        size <<= 1;
+        frame = &stack[top - 1];
+      }
+
+      stack[top++] = (TraverseFrame_t){.node = child, .depth = frame->depth + 1, .nextChild = -1};
       continue;
-    
-    int rtrn = TreeNode_traverse(depth + 1, root->child[i], data, pre, post);
-    //allow tree to short circuit if pre or post return non-zero value
-    if (rtrn)
-      return rtrn;
-  }
+    }
 
+    //save sibling pointer incase post op is freeing nodes
+    TreeNode_t *sibling = TreeNode_fromIndex(node->sibling);
 
-  //save sibling pointer incase post op is freeing nodes
-  TreeNode_t *sibling = root->sibling;
-  
-  if (post) {
-    int rtrn = post(depth, root, data);
-    if (rtrn)
-      return rtrn;
-  }
-  //once all the children have been visited, visit the sibling
-  return TreeNode_traverse(depth, sibling, data, pre, post);
-}
+    if (post && (rtrn = post(frame->depth, node, data)))
+      break;
 
+    //once all the children have been visited, visit the sibling
+    if (sibling)
+      *frame = (TraverseFrame_t){.node = sibling, .depth = frame->depth, .nextChild = -1};
+    else
+      top--;
+  }
 
-void TreeNode_destroy(TreeNode_t *root) {
-  
-  TreeNode_traverse(0, root, NULL, NULL, deleteHelper);
+  free(stack);
+  return rtrn;
 }
 
 
@@ -235,14 +470,15 @@ void TreeNode_printNode(FILE *output, TreeNode_t *node, bool symtable) {
     fprintf(output, "[Head] ");
 
   //print out the token if available
-  if (node->token) {
-    Lexer_printToken(*node->token, output);
+  LexToken_t *token = TreeNode_getToken(node);
+  if (token) {
+    Lexer_printToken(*token, output);
     fprintf(output, ", ");
   }
   
   //print out all the types associated with the node
   int bit = 0;
-  NodeType oldType = node->type;
+  NodeType oldType = TreeNode_getTypes(node);
   
   fprintf(output, "(");
   for (bit = 0; bit < NODETYPE_BITS_COUNT && oldType > 0; bit++) {
@@ -291,10 +527,26 @@ void TreeNode_print(FILE *output, TreeNode_t *head, bool symtable) {
 
 TreeNode_t *TreeNode_getChild(TreeNode_t *parent, int childNum) {
 
-  if (!parent || childNum < 0 || childNum > TREENODE_CHILD_MAX)
+  if (!parent || childNum < 0 || childNum >= TREENODE_CHILD_MAX)
+    return NULL;
+
+  return TreeNode_fromIndex(parent->child[childNum]);
+}
+
+TreeNode_t *TreeNode_getSibling(TreeNode_t *node) {
+
+  if (!node)
     return NULL;
 
-  return parent->child[childNum];
+  return TreeNode_fromIndex(node->sibling);
+}
+
+LexToken_t *TreeNode_getToken(TreeNode_t *node) {
+
+  if (!node)
+    return NULL;
+
+  return NODE_SIDE(node, tokens);
 }
 
 void TreeNode_addType(TreeNode_t *node, NodeType type) {
@@ -302,7 +554,7 @@ void TreeNode_addType(TreeNode_t *node, NodeType type) {
   if (!node)
     return;
   
-  node->type |= NODETYPE_BIT(type);
+  NODE_SIDE(node, types) |= NODETYPE_BIT(type);
 }
 
 void TreeNode_rmType(TreeNode_t *node, NodeType type) {
@@ -310,7 +562,7 @@ void TreeNode_rmType(TreeNode_t *node, NodeType type) {
   if (!node)
     return;
   
-  node->type &= ~NODETYPE_BIT(type);
+  NODE_SIDE(node, types) &= ~NODETYPE_BIT(type);
 }
 
 bool TreeNode_hasType(TreeNode_t *node, NodeType type) {
@@ -318,7 +570,40 @@ bool TreeNode_hasType(TreeNode_t *node, NodeType type) {
   if (!node)
     return false;
   
-  return node->type & NODETYPE_BIT(type);
+  return NODE_SIDE(node, types) & NODETYPE_BIT(type);
+}
+
+NodeType TreeNode_getTypes(TreeNode_t *node) {
+
+  if (!node)
+    return 0;
+
+  return NODE_SIDE(node, types);
+}
+
+NodeKind TreeNode_resolveKind(TreeNode_t *node) {
+
+  if (!node)
+    return NODEKIND_NONE;
+
+  NodeType types = NODE_SIDE(node, types);
+  node->kind = NODEKIND_NONE;
+  for (size_t i = 0; i < sizeof(KIND_RULES) / sizeof(KIND_RULES[0]); i++) {
+    if ((types & KIND_RULES[i].types) == KIND_RULES[i].types) {
+      node->kind = KIND_RULES[i].kind;
+      break;
+    }
+  }
+
+  return node->kind;
+}
+
+NodeKind TreeNode_getKind(TreeNode_t *node) {
+
+  if (!node)
+    return NODEKIND_NONE;
+
+  return node->kind;
 }
 
 SymTable_t *TreeNode_getSymTable(TreeNode_t *node) {
@@ -326,7 +611,7 @@ SymTable_t *TreeNode_getSymTable(TreeNode_t *node) {
   if (!node)
     return NULL;
 
-  return node->symbols;
+  return NODE_SIDE(node, tables);
 }
 
 void TreeNode_setSymTable(TreeNode_t *node, SymTable_t *table) {
@@ -334,7 +619,23 @@ void TreeNode_setSymTable(TreeNode_t *node, SymTable_t *table) {
   if (!node)
     return;
 
-  node->symbols = table;
+  NODE_SIDE(node, tables) = table;
+}
+
+CaseLabels_t *TreeNode_getCaseLabels(TreeNode_t *node) {
+
+  if (!node)
+    return NULL;
+
+  return NODE_SIDE(node, labels);
+}
+
+void TreeNode_setCaseLabels(TreeNode_t *node, CaseLabels_t *labels) {
+
+  if (!node)
+    return;
+
+  NODE_SIDE(node, labels) = labels;
 }
 
 void TreeNode_setReturnType(TreeNode_t *node, NodeReturnType type) {
@@ -359,7 +660,7 @@ void TreeNode_setSymbolRef(TreeNode_t *node, Symbol_t *symbol) {
   if (!node || !symbol)
     return;
 
-  node->entry = symbol;
+  NODE_SIDE(node, entries) = symbol;
 }
 
 Symbol_t *TreeNode_getSymbolRef(TreeNode_t *node) {
@@ -367,7 +668,7 @@ Symbol_t *TreeNode_getSymbolRef(TreeNode_t *node) {
   if (!node)
     return NULL;
 
-  return node->entry;
+  return NODE_SIDE(node, entries);
 }
 
 void TreeNode_setArgCount(TreeNode_t *node, int argc) {
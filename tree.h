@@ -10,12 +10,26 @@
 #define LEXER_TREE_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
 #include "lexer.h"
 #include "symtab.h"
+#include "caselabels.h"
 
 //The number of children each node can have
 #define TREENODE_CHILD_MAX 3
 
+//Bytes of each chunk of the node pool, a power of two. Chunks are
+//aligned to their size, so a node's chunk is found from its address.
+#define TREENODE_CHUNK_BYTES (32 * 1024)
+
+//Number of nodes in each chunk of the node pool, as many as fit in
+//TREENODE_CHUNK_BYTES along with their side tables (see tree.c)
+#define TREENODE_CHUNK_SIZE 480
+
+//Index of a missing node
+#define TREENODE_NONE 0
+
 //Get a count of the maximum number of (usable) bits in a NodeType value
 #define NODETYPE_BITS_COUNT (sizeof(NodeType) << 3)
 
@@ -32,16 +46,18 @@
  * where bitNum refers to any entry (except MAKE64) in this enum.
  *
  * Type assignment for the node is done using the NODETYPE_BIT macro:
- *              node->type |= NODETYPE_BIT(bitNum) 
+ *              types |= NODETYPE_BIT(bitNum) 
  * where bitNum refers to any entry (except MAKE64) in this enum.
  *
  * To check if a node is of a certain type, one just needs to check
  * the return value of:
- *              node->type & NODETYPE_BIT(bitNum)
+ *              types & NODETYPE_BIT(bitNum)
  * where bitNum refers to any entry (except MAKE64) in this enum.
  *
- * The TreeNode_addType, TreeNode_rmType, and TreeNode_hasType functions 
- * make up the API for dealing with TreeNode types.
+ * The types of a node are kept beside it in its chunk of the node
+ * pool. The TreeNode_addType, TreeNode_rmType, TreeNode_hasType and
+ * TreeNode_getTypes functions make up the API for dealing with
+ * TreeNode types.
  */
 typedef enum {
   BLOCK = 0,
@@ -88,6 +104,40 @@ typedef enum {
   MAKE64 = NODETYPE_BIT(63)
 } NodeType;
 
+//Index of a node in the node pool
+typedef uint32_t NodeIndex;
+
+/*
+ * Canonical kind of a node. Where a node may carry any number of
+ * NodeType bits, it has exactly one kind, which is derived from its
+ * types once semantic analysis is done with the node (see
+ * TreeNode_resolveKind). Passes over the tree index their tables of
+ * per node actions by the kind, rather than testing the node's types.
+ */
+typedef enum {
+  NODEKIND_NONE = 0,
+  //statements
+  NODEKIND_STMT_LIST,
+  NODEKIND_READ_STMT,
+  NODEKIND_WRITE_STMT,
+  NODEKIND_CASE_STMT,
+  NODEKIND_WHILE_STMT,
+  NODEKIND_IF_STMT,
+  NODEKIND_ASSIGN_STMT,
+  NODEKIND_BLOCK_STMT,
+  //expressions
+  NODEKIND_RELOP,
+  NODEKIND_BINOP,
+  NODEKIND_MULOP,
+  NODEKIND_UNARYOP,
+  NODEKIND_VARIABLE,
+  NODEKIND_ARRAY,
+  NODEKIND_CONSTANT,
+
+  //number of node kinds, for sizing dispatch tables
+  NODEKIND_COUNT
+} NodeKind;
+
 //external reference to NodeType strings
 extern const char *NODE_TYPE_TEXT[];
 
@@ -122,8 +172,8 @@ extern const char *NODE_RETURNTYPE_TEXT[];
  *
  *  Each node has the potential to store a token with it, where
  *  some nodes are used as structural nodes in maintaining the
- *  relationship of the token nodes. The token property will
- *  be set to NULL, if there are no tokens associated with it.
+ *  relationship of the token nodes. The token will be NULL
+ *  if there are no tokens associated with it.
  *
  *  isSibling and isChild properties are boolean values to indiciate
  *  if the node is (true) a sibling node, child node, or head node 
@@ -141,32 +191,21 @@ extern const char *NODE_RETURNTYPE_TEXT[];
  *  nodes must be followed first, and then the sibling node is
  *  followed with the process repeating.
  *
+ *  Nodes are stored in contiguous chunks of the compilation's
+ *  node pool, and refer to each other by their 32 bit index in
+ *  the pool rather than by pointer. Only what is needed to walk
+ *  the tree is kept in the node itself, the types, token, symbol
+ *  and symbol table references live in side tables of the chunk.
+ *  Use the TreeNode_* functions to get at a node's relatives,
+ *  types and references.
  */
 typedef struct TreeNode_s {
-  NodeType type;
-  char numChild;
-  
-  bool isSibling, isChild;
-  LexToken_t *token;
-  struct TreeNode_s *sibling;
-  struct TreeNode_s *child[TREENODE_CHILD_MAX];
-
-  //Points to the symbol table if node is a block.
-  //Is always null otherwise.
-  SymTable_t *symbols;
-  //  SymTable_t *localSym;
-
-  /*
-   * If node refers to an identifier, it will point to
-   * its own entry in the symbol table
-   */
-  Symbol_t *entry;
-  
-  /*
-   * What type of value this node returns
-   *  Determined through semantic analysis
-   */
-  NodeReturnType returns;
+  //pool indices of the node's relatives, TREENODE_NONE if missing
+  NodeIndex child[TREENODE_CHILD_MAX];
+  NodeIndex sibling;
+  //last sibling known to follow this node, so appending to the
+  //list starting at this node doesn't need to walk all of it
+  NodeIndex lastSibling;
 
   /*
    * Number of arguments if this node is a Read or Write
@@ -174,7 +213,20 @@ typedef struct TreeNode_s {
    * number will indicate the number of cases that exist.
    */
   int argc;
-  
+
+  /*
+   * What type of value this node returns (NodeReturnType)
+   *  Determined through semantic analysis
+   */
+  unsigned char returns;
+
+  //canonical kind of the node (NodeKind), see TreeNode_resolveKind
+  unsigned char kind;
+  //registers an expression node needs to be evaluated in without
+  //spilling any onto the stack, numbered by the code generator
+  unsigned char registers;
+
+  bool isSibling : 1, isChild : 1;
 } TreeNode_t;
 
 /*
@@ -188,31 +240,72 @@ typedef struct TreeNode_s {
  *
  * Returns:
  *  NULL if the node failed to be created. Otherwise a pointer
- *  to the newly created TreeNode_t instance.
+ *  to the newly created TreeNode_t instance. The node is allocated
+ *  from the node pool in the active arena (see Arena_setActive), and
+ *  is freed when that arena is destroyed. Nodes handed back with
+ *  TreeNode_free are reused first.
  */
 TreeNode_t *TreeNode_newNode(NodeType type, LexToken_t *token);
 
 /*
- * TreeNode_destroyNode:
- *  Frees up all memory associated with a node.
+ * TreeNode_fromIndex:
+ *  Get a node from its index in the node pool.
  *
  * Arguments:
- *  node: The node to delete
+ *  index: Index of the node.
+ *
+ * Returns:
+ *  Pointer to the node. NULL if index is TREENODE_NONE.
  */
-void TreeNode_destroyNode(TreeNode_t *node);
+TreeNode_t *TreeNode_fromIndex(NodeIndex index);
 
 /*
- * TreeNode_destroy:
- *  Frees up all memory associated with an abstract syntax tree.
+ * TreeNode_free:
+ *  Hand a node back to the node pool, to be reused by the next
+ *  TreeNode_newNode. The node's children and siblings are not freed,
+ *  and the node must not be referred to anymore.
  *
  * Arguments:
- *  root: The root node of the abstract syntax tree to free.
+ *  node: The node to free.
+ */
+void TreeNode_free(TreeNode_t *node);
+
+/*
+ * TreeNode_count:
+ *  Get the number of nodes in the node pool. As freed nodes are
+ *  reused first, this is the most nodes that were in use at once.
+ */
+size_t TreeNode_count(void);
+
+/*
+ * TreeNode_reusedCount:
+ *  Get the number of times a freed node was reused.
+ */
+size_t TreeNode_reusedCount(void);
+
+/*
+ * TreeNode_resetPool:
+ *  Forget every node in the pool. The memory used by the nodes
+ *  is released along with the arena they were allocated from.
  */
-void TreeNode_destroy(TreeNode_t *root);
+void TreeNode_resetPool(void);
 
 
 TreeNode_t *TreeNode_setChild(TreeNode_t *parent, TreeNode_t *child, unsigned char childPos);
 
+/*
+ * TreeNode_removeChild:
+ *  Detach a child node from its parent.
+ *
+ * Arguments:
+ *  parent: The node to remove the child from.
+ *  childNum: Which child to remove by index.
+ *
+ * Returns:
+ *  The child that was removed. NULL if there was no such child.
+ */
+TreeNode_t *TreeNode_removeChild(TreeNode_t *parent, int childNum);
+
 /*
  * TreeNode_addSibling:
  *  Add a sibling to a specific node.
@@ -221,6 +314,10 @@ TreeNode_t *TreeNode_setChild(TreeNode_t *parent, TreeNode_t *child, unsigned ch
  *  start: The node to add a sibling to.
  *  sibnode: the sibling node to add to the start node.
  *
+ *  The last sibling of a list is remembered by the node the list is
+ *  appended to, so building a list by repeatedly adding siblings to
+ *  its first node takes linear time.
+ *
  * Returns:
  *  A pointer to the sibling node added on success. NULL if a NULL 
  *  value is passed into either start or sibnode arguments.
@@ -242,9 +339,14 @@ TreeNode_t *TreeNode_addSibling(TreeNode_t *start, TreeNode_t *sibnode);
  *  If post or pre functions return a value other than 0, the tree traversal will
  *  stop immediately.
  *
+ *  The traversal keeps its own stack of the nodes being visited instead of
+ *  recursing, so neither long sibling lists nor deeply nested trees are
+ *  limited by the size of the C stack.
+ *
  * Returns:
  *  0 if all nodes have been traversed. Anything else indicates the tree traversal was
- *  interrupted by a pre/post node visit action. 
+ *  interrupted by a pre/post node visit action, or -1 if the traversal stack could
+ *  not be allocated.
  */
 int TreeNode_traverse(int depth, TreeNode_t *root, void *data, int (*pre)(int, TreeNode_t *, void *),
                          int (*post)(int, TreeNode_t *, void *));
@@ -308,6 +410,46 @@ void TreeNode_rmType(TreeNode_t *node, NodeType type);
  */
 bool TreeNode_hasType(TreeNode_t *node, NodeType type);
 
+/*
+ * TreeNode_getTypes:
+ *  Get all the types of a node at once.
+ *
+ * Arguments:
+ *  node: The node to get the types of.
+ *
+ * Returns:
+ *  The node's types, a mask of NODETYPE_BIT values. 0 if node is NULL.
+ */
+NodeType TreeNode_getTypes(TreeNode_t *node);
+
+/*
+ * TreeNode_resolveKind:
+ *  Derive the canonical kind of a node from its types, and store it
+ *  with the node. Should be called once the node's types are final;
+ *  adding or removing types afterwards does not change its kind.
+ *
+ * Arguments:
+ *  node: The node to resolve the kind of.
+ *
+ * Returns:
+ *  The kind of the node. NODEKIND_NONE if the node is NULL, or
+ *  none of its types has a kind.
+ */
+NodeKind TreeNode_resolveKind(TreeNode_t *node);
+
+/*
+ * TreeNode_getKind:
+ *  Get the canonical kind of a node, as stored by TreeNode_resolveKind.
+ *
+ * Arguments:
+ *  node: The node to get the kind of.
+ *
+ * Returns:
+ *  The kind of the node. NODEKIND_NONE if the node is NULL, or its
+ *  kind has not been resolved.
+ */
+NodeKind TreeNode_getKind(TreeNode_t *node);
+
 /*
  * TreeNode_getChild:
  *  Get a specific child node from a parent node.
@@ -323,6 +465,31 @@ bool TreeNode_hasType(TreeNode_t *node, NodeType type);
  */
 TreeNode_t *TreeNode_getChild(TreeNode_t *parent, int childNum);
 
+/*
+ * TreeNode_getSibling:
+ *  Get the sibling following a node.
+ *
+ * Arguments:
+ *  node: The node to get the sibling of.
+ *
+ * Returns:
+ *  TreeNode_t pointer to the sibling. NULL if the node
+ *  is the last of its siblings.
+ */
+TreeNode_t *TreeNode_getSibling(TreeNode_t *node);
+
+/*
+ * TreeNode_getToken:
+ *  Get the lexer token stored with a node.
+ *
+ * Arguments:
+ *  node: The node to get the token of.
+ *
+ * Returns:
+ *  Pointer to the token. NULL if the node has no token.
+ */
+LexToken_t *TreeNode_getToken(TreeNode_t *node);
+
 /*
  * TreeNode_getSymTable:
  *  Get the symbol table a node is referencing.
@@ -346,6 +513,28 @@ SymTable_t *TreeNode_getSymTable(TreeNode_t *node);
  */
 void TreeNode_setSymTable(TreeNode_t *node, SymTable_t *table);
 
+/*
+ * TreeNode_getCaseLabels:
+ *  Get the sorted labels of a case statement node.
+ *
+ * Arguments:
+ *  node: The case statement node.
+ *
+ * Returns:
+ *  The node's labels, NULL if they haven't been checked yet.
+ */
+CaseLabels_t *TreeNode_getCaseLabels(TreeNode_t *node);
+
+/*
+ * TreeNode_setCaseLabels:
+ *  Attach the sorted labels of a case statement to its node.
+ *
+ * Arguments:
+ *  node: The case statement node.
+ *  labels: The labels of its cases.
+ */
+void TreeNode_setCaseLabels(TreeNode_t *node, CaseLabels_t *labels);
+
 /*
  * TreeNode_setReturnType:
  *  Set the calculated return type of a node. This is used